@@ -0,0 +1,102 @@
+#include "pch.h"
+#include "BorderHandling.h"
+#include <algorithm>
+#include <cstring>
+
+namespace ImaGyNative
+{
+    static BorderPolicy borderPolicy = { BorderMode::Reflect, 0 };
+
+    void SetBorderPolicy(BorderMode mode, unsigned char constantValue)
+    {
+        borderPolicy = { mode, constantValue };
+    }
+
+    BorderPolicy GetBorderPolicy()
+    {
+        return borderPolicy;
+    }
+
+    int BorderIndex(int index, int length, BorderMode mode)
+    {
+        if (index >= 0 && index < length) return index;
+        if (length <= 0) return -1;
+
+        switch (mode) {
+        case BorderMode::Replicate:
+            return index < 0 ? 0 : length - 1;
+        case BorderMode::Reflect:
+            if (length == 1) return 0;
+            // period of the mirrored sequence is 2 * (length - 1), so any kernel radius works
+            while (index < 0 || index >= length) {
+                if (index < 0) index = -index;
+                if (index >= length) index = 2 * (length - 1) - index;
+            }
+            return index;
+        default:
+            return -1;
+        }
+    }
+
+    PaddedImage::PaddedImage(const unsigned char* pixels, int width, int height, int stride, int pixelBytes, int border,
+        BorderPolicy policy)
+        : width(width), height(height), pixelBytes(pixelBytes), border(border)
+    {
+        paddedStride = (width + 2 * border) * pixelBytes;
+        buffer.resize((size_t)(height + 1) * paddedStride);
+        rows.resize(height + 2 * border);
+
+        unsigned char* constantRow = &buffer[(size_t)height * paddedStride];
+        memset(constantRow, policy.constantValue, paddedStride);
+
+        // left/right padding is copied once per row
+        #pragma omp parallel for
+        for (int y = 0; y < height; ++y) {
+            unsigned char* paddedRow = &buffer[(size_t)y * paddedStride] + border * pixelBytes;
+            const unsigned char* sourceRow = pixels + (size_t)y * stride;
+            memcpy(paddedRow, sourceRow, width * pixelBytes);
+            for (int i = 1; i <= border; ++i) {
+                int left = BorderIndex(-i, width, policy.mode);
+                int right = BorderIndex(width - 1 + i, width, policy.mode);
+                if (left < 0) memset(paddedRow - i * pixelBytes, policy.constantValue, pixelBytes);
+                else memcpy(paddedRow - i * pixelBytes, sourceRow + left * pixelBytes, pixelBytes);
+                if (right < 0) memset(paddedRow + (width - 1 + i) * pixelBytes, policy.constantValue, pixelBytes);
+                else memcpy(paddedRow + (width - 1 + i) * pixelBytes, sourceRow + right * pixelBytes, pixelBytes);
+            }
+        }
+
+        // rows above and below point at existing padded rows
+        for (int y = -border; y < height + border; ++y) {
+            int sourceY = BorderIndex(y, height, policy.mode);
+            const unsigned char* row = (sourceY < 0) ? constantRow : &buffer[(size_t)sourceY * paddedStride];
+            rows[y + border] = row + border * pixelBytes;
+        }
+    }
+
+    PaddedImage::PaddedImage()
+        : width(0), height(0), pixelBytes(1), border(0), paddedStride(0)
+    {
+    }
+
+    void PaddedImage::Expand(int amount)
+    {
+        for (const unsigned char*& row : rows) row -= amount * pixelBytes;
+        width += 2 * amount;
+        height += 2 * amount;
+        border -= amount;
+    }
+
+    void PaddedImage::Resize(int width, int height, int pixelBytes, int border)
+    {
+        this->width = width;
+        this->height = height;
+        this->pixelBytes = pixelBytes;
+        this->border = border;
+        paddedStride = (width + 2 * border) * pixelBytes;
+        buffer.resize((size_t)(height + 2 * border) * paddedStride);
+        rows.resize(height + 2 * border);
+        for (int y = -border; y < height + border; ++y) {
+            rows[y + border] = &buffer[(size_t)(y + border) * paddedStride] + border * pixelBytes;
+        }
+    }
+}
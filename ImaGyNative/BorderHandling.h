@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+
+namespace ImaGyNative
+{
+    // How neighborhood operators read pixels outside the image
+    enum class BorderMode {
+        Replicate,  // aaa|abcd|ddd
+        Reflect,    // cb|abcd|cb  (edge pixel not repeated)
+        Constant    // kk|abcd|kk
+    };
+
+    struct BorderPolicy {
+        BorderMode mode;
+        unsigned char constantValue;
+    };
+
+    // Process-wide policy used by every CPU/SSE neighborhood operator
+    void SetBorderPolicy(BorderMode mode, unsigned char constantValue);
+    BorderPolicy GetBorderPolicy();
+
+    // Maps an out-of-range index into [0, length), or -1 for BorderMode::Constant
+    int BorderIndex(int index, int length, BorderMode mode);
+
+    // Read-only copy of an image with `border` extra pixels on every side.
+    // Rows are padded left/right once, the rows above and below are views onto
+    // existing rows, so operators index Row(y + ky)[x + kx] without any branches.
+    class PaddedImage
+    {
+    public:
+        PaddedImage(const unsigned char* pixels, int width, int height, int stride, int pixelBytes, int border,
+            BorderPolicy policy = GetBorderPolicy());
+
+        // Empty image for the tile scheduler: Resize gives every padded row (halo rows included)
+        // its own storage, the caller fills them through MutableRow. The buffer is kept across
+        // Resize calls so one object per thread serves all of its tiles
+        PaddedImage();
+        void Resize(int width, int height, int pixelBytes, int border);
+        unsigned char* MutableRow(int y) { return &buffer[(size_t)(y + border) * paddedStride] + border * pixelBytes; }
+        int PaddedStride() const { return paddedStride; }
+
+        // Trades `amount` pixels of border on every side for a larger image: Width() and Height()
+        // grow by 2 * amount and Row(y) becomes the old Row(y - amount) - amount. Nothing is copied
+        void Expand(int amount);
+
+        // Pointer to pixel x = 0 of row y
+        // valid for -border <= y < height + border and -border <= x < width + border
+        const unsigned char* Row(int y) const { return rows[y + border]; }
+
+        int Width() const { return width; }
+        int Height() const { return height; }
+        int Border() const { return border; }
+        int PixelBytes() const { return pixelBytes; }
+
+    private:
+        int width;
+        int height;
+        int pixelBytes;
+        int border;
+        int paddedStride;
+        std::vector<unsigned char> buffer; // height padded rows + one constant row, or all rows when resized
+        std::vector<const unsigned char*> rows;
+    };
+}
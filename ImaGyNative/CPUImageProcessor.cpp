@@ -2,6 +2,14 @@
 #include "NativeCore.h"
 #include "ImageProcessingUtils.h"
 #include "CPUImageProcessor.h"
+#include "BorderHandling.h"
+#include "SimdDispatch.h"
+#include "TileScheduler.h"
+#include "TemplateMatching.h"
+#include "SpectrumCache.h"
+#include "FrequencyMask.h"
+#include "KMeans.h"
+#include "GaussianMixture.h"
 #include <cmath>
 #include <iostream>
 #include <vector>
@@ -16,77 +24,360 @@
 
 namespace ImaGyNative
 {
-    // Convolution Helper Method
-    void ApplyConvolution(const unsigned char* sourcePixels, unsigned char* destPixels,
-        int width, int height, int stride, const std::vector<double>& kernel, int kernelSize)
+    // Separable Convolution Helper
+    // One output row: vertical pass of K padded rows into columnBuffer ((width + 2 * center) * channels),
+    // then horizontal pass over columnBuffer. rowOut[x * channels + c] is written for 0 <= x < width
+    static void SeparableConvolveRow(const PaddedImage& padded, int y, int channels,
+        const std::vector<double>& rowKernel, const std::vector<double>& columnKernel, double* columnBuffer, double* rowOut)
     {
+        int kernelSize = static_cast<int>(rowKernel.size());
         int center = kernelSize / 2;
-        double kernelSum = std::accumulate(kernel.begin(), kernel.end(), 0.0);
-        if (kernelSum == 0) kernelSum = 1.0;
-        #pragma omp parallel for
-        for (int y = center; y < height - center; ++y) {
-            for (int x = center; x < width - center; ++x) {
+        int width = padded.Width();
+        int pixelBytes = padded.PixelBytes();
+        int paddedWidth = width + 2 * center;
+        int rowLength = paddedWidth * channels;
+
+        std::fill(columnBuffer, columnBuffer + rowLength, 0.0);
+        for (int ky = 0; ky < kernelSize; ++ky) {
+            double weight = columnKernel[ky];
+            if (weight == 0) continue;
+            const unsigned char* sourceRow = padded.Row(y + ky - center) - center * pixelBytes;
+            if (channels == pixelBytes) {
+                for (int i = 0; i < rowLength; ++i) {
+                    columnBuffer[i] += weight * sourceRow[i];
+                }
+            }
+            else {
+                for (int x = 0; x < paddedWidth; ++x) {
+                    for (int c = 0; c < channels; ++c) {
+                        columnBuffer[x * channels + c] += weight * sourceRow[x * pixelBytes + c];
+                    }
+                }
+            }
+        }
+
+        for (int x = 0; x < width; ++x) {
+            for (int c = 0; c < channels; ++c) {
+                const double* window = columnBuffer + x * channels + c;
                 double sum = 0.0;
-                for (int ky = -center; ky <= center; ++ky) {
-                    for (int kx = -center; kx <= center; ++kx) {
-                        int kernelIndex = (ky + center) * kernelSize + (kx + center);
-                        if (kernel[kernelIndex] == 0) continue; 
+                for (int kx = 0; kx < kernelSize; ++kx) {
+                    sum += rowKernel[kx] * window[kx * channels];
+                }
+                rowOut[x * channels + c] = sum;
+            }
+        }
+    }
 
-                        int sourceIndex = (y + ky) * stride + (x + kx);
-                        sum += kernel[kernelIndex] * sourcePixels[sourceIndex];
+    // Rank-1 kernel fast path: 2K MACs per pixel instead of K*K
+    static void ApplySeparableConvolution(const PaddedImage& padded, unsigned char* destPixels, int stride,
+        const std::vector<double>& rowKernel, const std::vector<double>& columnKernel, double kernelSum, bool isColor)
+    {
+        int width = padded.Width();
+        int height = padded.Height();
+        int center = static_cast<int>(rowKernel.size()) / 2;
+        int channels = isColor ? 3 : 1;
+        int pixelBytes = isColor ? 4 : 1;
+        #pragma omp parallel
+        {
+            // per-thread row buffers stay resident in cache
+            std::vector<double> columnBuffer((width + 2 * center) * channels);
+            std::vector<double> rowOut(width * channels);
+            #pragma omp for
+            for (int y = 0; y < height; ++y) {
+                SeparableConvolveRow(padded, y, channels, rowKernel, columnKernel, columnBuffer.data(), rowOut.data());
+
+                const unsigned char* sourceRow = padded.Row(y);
+                for (int x = 0; x < width; ++x) {
+                    unsigned char* destP = destPixels + y * stride + x * pixelBytes;
+                    for (int c = 0; c < channels; ++c) {
+                        double sum = rowOut[x * channels + c];
+                        double finalValue = (kernelSum == 1.0) ? sum : sum / kernelSum;
+                        destP[c] = static_cast<unsigned char>(std::max(0.0, std::min(255.0, finalValue)));
                     }
+                    if (isColor) destP[3] = sourceRow[x * 4 + 3];
                 }
+            }
+        }
+    }
 
-                double finalValue = (kernelSum == 1.0) ? sum : sum / kernelSum;
+    // Fixed-point Convolution Helper
+    // Integer path for kernels that are not rank-1: int16 weights x uint8 pixels into int32,
+    // then an arithmetic shift. Within 1 gray level of the double path for the kernels measured in
+    // MakeConvolutionFilter.
+    // The row sums come from the widest SIMD backend the CPU supports
+    static void ApplyQuantizedConvolution(const PaddedImage& padded, unsigned char* destPixels, int stride,
+        const QuantizedKernel& kernel, bool isColor)
+    {
+        int width = padded.Width();
+        int height = padded.Height();
+        int pixelBytes = padded.PixelBytes();
+        int rowBytes = width * pixelBytes;
+        int fractionBits = kernel.fractionBits;
+        std::vector<QuantizedTapPair> pairs = BuildTapPairs(kernel, pixelBytes);
+        const SimdKernelTable& simd = ActiveSimdKernels();
+
+        #pragma omp parallel
+        {
+            std::vector<int> rowSums(rowBytes);
+            #pragma omp for
+            for (int y = 0; y < height; ++y) {
+                simd.ConvolveRow(padded, y, pairs.data(), static_cast<int>(pairs.size()), rowSums.data());
 
-                if (finalValue > 255) finalValue = 255;
-                if (finalValue < 0) finalValue = 0;
-                destPixels[y * stride + x] = static_cast<unsigned char>(finalValue);
+                unsigned char* destRow = destPixels + y * stride;
+                simd.PackRow(rowSums.data(), fractionBits, rowBytes, destRow);
+                if (isColor) {
+                    const unsigned char* sourceRow = padded.Row(y);
+                    for (int x = 0; x < width; ++x) destRow[x * 4 + 3] = sourceRow[x * 4 + 3];
+                }
             }
         }
     }
 
+    // Runs a tile filter over the whole image through the tile scheduler
+    static void ApplyTiled(const unsigned char* sourcePixels, unsigned char* destPixels, int width, int height, int stride,
+        int pixelBytes, int border, const TileFilter& filter)
+    {
+        ForEachTile(sourcePixels, destPixels, width, height, stride, pixelBytes, border,
+            [&](const PaddedImage& padded, unsigned char* tileDest) { filter(padded, tileDest, stride); });
+    }
 
-    void ApplyConvolutionColor(const unsigned char* sourcePixels, unsigned char* destPixels,
-        int width, int height, int stride, const std::vector<double>& kernel, int kernelSize)
+    // Convolution Helper Method
+    // Every pixel is written, neighbors outside the tile come from the padded halo.
+    // Rank-1 kernels take the separable double path. Other kernels run in fixed point
+    // (QuantizeKernel): the weights are rounded to Q15 (or coarser for large integer kernels)
+    // with largest-remainder correction and the result is floored, where the double path
+    // truncates a sum that may carry rounding noise. Measured against the double path on random
+    // and flat images: at most 1 gray level for square and circular Gaussians with K = 3..51 and
+    // sigma = 0.8..100; integer kernels (Sobel, Laplacian) quantize exactly.
+    // The double loop below is kept for kernels that do not fit in int16 weights
+    static TileFilter MakeConvolutionFilter(const std::vector<double>& kernel, int kernelSize, bool isColor)
     {
         int center = kernelSize / 2;
         double kernelSum = std::accumulate(kernel.begin(), kernel.end(), 0.0); // normalization for bright
         if (kernelSum == 0) kernelSum = 1.0;
-        #pragma omp parallel for
-        for (int y = center; y < height - center; ++y) {
-            for (int x = center; x < width - center; ++x) {
-                double sumB = 0.0, sumG = 0.0, sumR = 0.0;
-
-                for (int ky = -center; ky <= center; ++ky) {
-                    for (int kx = -center; kx <= center; ++kx) {
-                        int kernelIndex = (ky + center) * kernelSize + (kx + center);
-                        if (kernel[kernelIndex] == 0) continue;
-
-                        int sourcePixelX = x + kx;
-                        int sourcePixelY = y + ky;
-                        const unsigned char* p = sourcePixels + sourcePixelY * stride + sourcePixelX * 4;
-
-                        sumB += kernel[kernelIndex] * p[0]; // B
-                        sumG += kernel[kernelIndex] * p[1]; // G
-                        sumR += kernel[kernelIndex] * p[2]; // R
+
+        std::vector<double> rowKernel, columnKernel;
+        bool isSeparable = SeparateKernel(kernel, kernelSize, rowKernel, columnKernel);
+        QuantizedKernel quantized;
+        bool isQuantized = !isSeparable && QuantizeKernel(kernel, kernelSize, 1.0 / kernelSum, quantized);
+
+        return [=](const PaddedImage& padded, unsigned char* destPixels, int stride) {
+            if (isSeparable) {
+                ApplySeparableConvolution(padded, destPixels, stride, rowKernel, columnKernel, kernelSum, isColor);
+                return;
+            }
+            if (isQuantized) {
+                ApplyQuantizedConvolution(padded, destPixels, stride, quantized, isColor);
+                return;
+            }
+            int width = padded.Width();
+            int height = padded.Height();
+            if (!isColor) {
+                #pragma omp parallel for
+                for (int y = 0; y < height; ++y) {
+                    for (int x = 0; x < width; ++x) {
+                        double sum = 0.0;
+                        for (int ky = -center; ky <= center; ++ky) {
+                            const unsigned char* sourceRow = padded.Row(y + ky);
+                            for (int kx = -center; kx <= center; ++kx) {
+                                int kernelIndex = (ky + center) * kernelSize + (kx + center);
+                                if (kernel[kernelIndex] == 0) continue; 
+
+                                sum += kernel[kernelIndex] * sourceRow[x + kx];
+                            }
+                        }
+
+                        double finalValue = (kernelSum == 1.0) ? sum : sum / kernelSum;
+
+                        if (finalValue > 255) finalValue = 255;
+                        if (finalValue < 0) finalValue = 0;
+                        destPixels[y * stride + x] = static_cast<unsigned char>(finalValue);
+                    }
+                }
+                return;
+            }
+            #pragma omp parallel for
+            for (int y = 0; y < height; ++y) {
+                for (int x = 0; x < width; ++x) {
+                    double sumB = 0.0, sumG = 0.0, sumR = 0.0;
+
+                    for (int ky = -center; ky <= center; ++ky) {
+                        const unsigned char* sourceRow = padded.Row(y + ky);
+                        for (int kx = -center; kx <= center; ++kx) {
+                            int kernelIndex = (ky + center) * kernelSize + (kx + center);
+                            if (kernel[kernelIndex] == 0) continue;
+
+                            const unsigned char* p = sourceRow + (x + kx) * 4;
+
+                            sumB += kernel[kernelIndex] * p[0]; // B
+                            sumG += kernel[kernelIndex] * p[1]; // G
+                            sumR += kernel[kernelIndex] * p[2]; // R
+                        }
                     }
+
+                    double finalB = (kernelSum == 1.0) ? sumB : sumB / kernelSum;
+                    double finalG = (kernelSum == 1.0) ? sumG : sumG / kernelSum;
+                    double finalR = (kernelSum == 1.0) ? sumR : sumR / kernelSum;
+
+                    unsigned char* destP = destPixels + y * stride + x * 4;
+                    destP[0] = static_cast<unsigned char>(std::max(0.0, std::min(255.0, finalB)));
+                    destP[1] = static_cast<unsigned char>(std::max(0.0, std::min(255.0, finalG)));
+                    destP[2] = static_cast<unsigned char>(std::max(0.0, std::min(255.0, finalR)));
+                    destP[3] = padded.Row(y)[x * 4 + 3];
+                }
+            }
+        };
+    }
+
+    // destPixels may be the same buffer as sourcePixels, the image is processed in cache-sized
+    // tiles (ForEachTile) so an in-place call only copies the halos along tile boundaries
+    void ApplyConvolution(const unsigned char* sourcePixels, unsigned char* destPixels,
+        int width, int height, int stride, const std::vector<double>& kernel, int kernelSize)
+    {
+        ApplyTiled(sourcePixels, destPixels, width, height, stride, 1, kernelSize / 2,
+            MakeConvolutionFilter(kernel, kernelSize, false));
+    }
+
+
+    void ApplyConvolutionColor(const unsigned char* sourcePixels, unsigned char* destPixels,
+        int width, int height, int stride, const std::vector<double>& kernel, int kernelSize)
+    {
+        ApplyTiled(sourcePixels, destPixels, width, height, stride, 4, kernelSize / 2,
+            MakeConvolutionFilter(kernel, kernelSize, true));
+    }
+
+
+    // Box Filter Helper
+    // Sliding-window running sums: one add and one subtract per direction, independent of kernelSize
+    static void ApplyBoxFilter(const PaddedImage& padded, unsigned char* destPixels, int stride, int kernelSize, bool isColor)
+    {
+        int width = padded.Width();
+        int height = padded.Height();
+        int center = kernelSize / 2;
+        int channels = isColor ? 3 : 1;
+        int pixelBytes = isColor ? 4 : 1;
+        int count = kernelSize * kernelSize;
+        int paddedWidth = width + 2 * center;
+
+        #pragma omp parallel
+        {
+            // each thread slides down its own contiguous band of rows
+            int threadCount = omp_get_num_threads();
+            int threadId = omp_get_thread_num();
+            int yBegin = (int)((long long)height * threadId / threadCount);
+            int yEnd = (int)((long long)height * (threadId + 1) / threadCount);
+
+            std::vector<int> columnSums(paddedWidth * channels, 0);
+            std::vector<int> windowSums(channels);
+            for (int ky = yBegin - center; ky <= yBegin + center && yBegin < yEnd; ++ky) {
+                const unsigned char* sourceRow = padded.Row(ky) - center * pixelBytes;
+                for (int x = 0; x < paddedWidth; ++x) {
+                    for (int c = 0; c < channels; ++c) columnSums[x * channels + c] += sourceRow[x * pixelBytes + c];
                 }
+            }
 
-                double finalB = (kernelSum == 1.0) ? sumB : sumB / kernelSum;
-                double finalG = (kernelSum == 1.0) ? sumG : sumG / kernelSum;
-                double finalR = (kernelSum == 1.0) ? sumR : sumR / kernelSum;
+            for (int y = yBegin; y < yEnd; ++y) {
+                for (int c = 0; c < channels; ++c) {
+                    windowSums[c] = 0;
+                    for (int kx = 0; kx < kernelSize; ++kx) windowSums[c] += columnSums[kx * channels + c];
+                }
+                const unsigned char* centerRow = padded.Row(y);
+                for (int x = 0; x < width; ++x) {
+                    unsigned char* destP = destPixels + y * stride + x * pixelBytes;
+                    for (int c = 0; c < channels; ++c) {
+                        destP[c] = static_cast<unsigned char>(windowSums[c] / count);
+                    }
+                    if (isColor) destP[3] = centerRow[x * 4 + 3];
+                    if (x + kernelSize < paddedWidth) {
+                        for (int c = 0; c < channels; ++c) {
+                            windowSums[c] += columnSums[(x + kernelSize) * channels + c] - columnSums[x * channels + c];
+                        }
+                    }
+                }
 
-                unsigned char* destP = destPixels + y * stride + x * 4;
-                destP[0] = static_cast<unsigned char>(std::max(0.0, std::min(255.0, finalB)));
-                destP[1] = static_cast<unsigned char>(std::max(0.0, std::min(255.0, finalG)));
-                destP[2] = static_cast<unsigned char>(std::max(0.0, std::min(255.0, finalR)));
-                const unsigned char* srcP = sourcePixels + y * stride + x * 4;
-                destP[3] = srcP[3];
+                if (y + 1 < yEnd) {
+                    const unsigned char* leavingRow = padded.Row(y - center) - center * pixelBytes;
+                    const unsigned char* enteringRow = padded.Row(y + center + 1) - center * pixelBytes;
+                    for (int x = 0; x < paddedWidth; ++x) {
+                        for (int c = 0; c < channels; ++c) {
+                            columnSums[x * channels + c] += enteringRow[x * pixelBytes + c] - leavingRow[x * pixelBytes + c];
+                        }
+                    }
+                }
             }
         }
     }
 
+    // Circular Average Helper
+    // The disk is split into horizontal bands of equal chord width, each band is one
+    // integral-image rectangle lookup. unsigned int wraps around, but every rectangle sum
+    // is far below 2^32 so the modular difference is exact
+    static void ApplyCircularAverageFilter(const PaddedImage& padded, unsigned char* destPixels, int stride, int kernelSize, bool isColor)
+    {
+        int width = padded.Width();
+        int height = padded.Height();
+        int center = kernelSize / 2;
+        int channels = isColor ? 3 : 1;
+        int pixelBytes = isColor ? 4 : 1;
+
+        struct ChordBand { int dyBegin; int dyEnd; int halfWidth; };
+        std::vector<ChordBand> bands;
+        int count = 0;
+        int radiusSq = center * center;
+        for (int dy = -center; dy <= center; ++dy) {
+            int halfWidth = 0;
+            while ((halfWidth + 1) * (halfWidth + 1) + dy * dy <= radiusSq) ++halfWidth;
+            if (!bands.empty() && bands.back().halfWidth == halfWidth) bands.back().dyEnd = dy;
+            else bands.push_back({ dy, dy, halfWidth });
+            count += 2 * halfWidth + 1;
+        }
+
+        // integral image of the padded image, pixel (x, y) sits at (x + center, y + center)
+        int paddedWidth = width + 2 * center;
+        int paddedHeight = height + 2 * center;
+        int integralStride = (paddedWidth + 1) * channels;
+        std::vector<unsigned int> integral((size_t)(paddedHeight + 1) * integralStride, 0);
+        #pragma omp parallel for
+        for (int y = 0; y < paddedHeight; ++y) {
+            unsigned int* integralRow = &integral[(size_t)(y + 1) * integralStride];
+            const unsigned char* sourceRow = padded.Row(y - center) - center * pixelBytes;
+            for (int x = 0; x < paddedWidth; ++x) {
+                for (int c = 0; c < channels; ++c) {
+                    integralRow[(x + 1) * channels + c] = integralRow[x * channels + c] + sourceRow[x * pixelBytes + c];
+                }
+            }
+        }
+        // vertical prefix pass, split into column strips so threads don't share rows
+        const int stripWidth = 256;
+        #pragma omp parallel for
+        for (int stripBegin = 0; stripBegin < integralStride; stripBegin += stripWidth) {
+            int stripEnd = std::min(stripBegin + stripWidth, integralStride);
+            for (int y = 1; y <= paddedHeight; ++y) {
+                unsigned int* integralRow = &integral[(size_t)y * integralStride];
+                const unsigned int* previousRow = integralRow - integralStride;
+                for (int i = stripBegin; i < stripEnd; ++i) integralRow[i] += previousRow[i];
+            }
+        }
+
+        #pragma omp parallel for
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                unsigned char* destP = destPixels + y * stride + x * pixelBytes;
+                for (int c = 0; c < channels; ++c) {
+                    unsigned int sum = 0;
+                    for (const ChordBand& band : bands) {
+                        const unsigned int* top = &integral[(size_t)(y + center + band.dyBegin) * integralStride];
+                        const unsigned int* bottom = &integral[(size_t)(y + center + band.dyEnd + 1) * integralStride];
+                        int left = (x + center - band.halfWidth) * channels + c;
+                        int right = (x + center + band.halfWidth + 1) * channels + c;
+                        sum += bottom[right] - bottom[left] - top[right] + top[left];
+                    }
+                    destP[c] = static_cast<unsigned char>(sum / count);
+                }
+                if (isColor) destP[3] = padded.Row(y)[x * 4 + 3];
+            }
+        }
+    }
 
     // Binarization - Complete
     void ApplyBinarization_CPU(void* pixels, int width, int height, int stride, int threshold)
@@ -165,371 +456,394 @@ namespace ImaGyNative
 
 
     // Differential - Complete
-    void ApplyDifferential_CPU(void* pixels, int width, int height, int stride, unsigned char threshold)
+    TileFilter MakeDifferentialFilter()
     {
-        // origin data 
-        unsigned char* pixelData = static_cast<unsigned char*>(pixels);
-        // newbuffer for return 
-        unsigned char* resultBuffer = new unsigned char[height * stride];
-
-        for (int y = 0; y < height - 1; ++y)
-        {
-            for (int x = 0; x < width - 1; ++x)
+        // right column and bottom row read their neighbor from the padding
+        return [](const PaddedImage& padded, unsigned char* destPixels, int stride) {
+            int width = padded.Width();
+            int height = padded.Height();
+            #pragma omp parallel for
+            for (int y = 0; y < height; ++y)
             {
-                int centerIndex = y * stride + x;
-                int indexPx = y * stride + (x + 1);
-                int indexPy = (y + 1) * stride + x;
-
-                // Calculate Diff each axis
-                int gradX = pixelData[indexPx] - pixelData[centerIndex];
-                int gradY = pixelData[indexPy] - pixelData[centerIndex];
+                const unsigned char* row = padded.Row(y);
+                const unsigned char* nextRow = padded.Row(y + 1);
+                for (int x = 0; x < width; ++x)
+                {
+                    // Calculate Diff each axis
+                    int gradX = row[x + 1] - row[x];
+                    int gradY = nextRow[x] - row[x];
 
-                // absolute value for velocity
-                int val = abs(gradX) + abs(gradY); // val never under 0
+                    // absolute value for velocity
+                    int val = abs(gradX) + abs(gradY); // val never under 0
 
-                // value validation
-                if (val > 255) val = 255;
-                unsigned char finalValue = val;
+                    // value validation
+                    if (val > 255) val = 255;
+                    unsigned char finalValue = val;
 
-                resultBuffer[centerIndex] = finalValue;
+                    destPixels[y * stride + x] = finalValue;
+                }
             }
-        }
-
-        // copy the result To holding memory address
-        memcpy(pixelData, resultBuffer, height * stride); // memcpy(hold memory address, change content address, size) 
+        };
+    }
 
-        // free the resultBuffer memory
-        delete[] resultBuffer;
+    void ApplyDifferential_CPU(void* pixels, int width, int height, int stride, unsigned char threshold)
+    {
+        // origin data 
+        unsigned char* pixelData = static_cast<unsigned char*>(pixels);
+        ApplyTiled(pixelData, pixelData, width, height, stride, 1, 1, MakeDifferentialFilter());
     }
 
     // Sobel - Complete
-    void ApplySobel_CPU(void* pixels, int width, int height, int stride, int kernelSize)
+    TileFilter MakeSobelFilter(int kernelSize)
     {
         // 
         if (kernelSize % 2 == 0) kernelSize++;
 
         std::vector<double> kernelX = createSobelKernelX(kernelSize);
         std::vector<double> kernelY = createSobelKernelY(kernelSize);
+        int center = kernelSize / 2;
 
-        unsigned char* pixelData = static_cast<unsigned char*>(pixels);
-        unsigned char* sourceBuffer = new unsigned char[height * stride];
-        memcpy(sourceBuffer, pixelData, height * stride);
+        // 3x3 Sobel is rank-1, larger kernels from createSobelKernelX are not
+        std::vector<double> rowKernelX, columnKernelX, rowKernelY, columnKernelY;
+        bool isSeparable = SeparateKernel(kernelX, kernelSize, rowKernelX, columnKernelX)
+            && SeparateKernel(kernelY, kernelSize, rowKernelY, columnKernelY);
+
+        QuantizedKernel quantizedX, quantizedY;
+        bool isQuantized = !isSeparable
+            && QuantizeKernel(kernelX, kernelSize, 1.0, quantizedX)
+            && QuantizeKernel(kernelY, kernelSize, 1.0, quantizedY);
+        std::vector<QuantizedTapPair> pairsX, pairsY;
+        double scaleX = 1.0, scaleY = 1.0;
+        if (isQuantized) {
+            pairsX = BuildTapPairs(quantizedX, 1);
+            pairsY = BuildTapPairs(quantizedY, 1);
+            scaleX = std::ldexp(1.0, -quantizedX.fractionBits);
+            scaleY = std::ldexp(1.0, -quantizedY.fractionBits);
+        }
+        const SimdKernelTable& simd = ActiveSimdKernels();
 
-        // Gx Gy 
-        double* bufferX = new double[height * stride]();
-        double* bufferY = new double[height * stride]();
+        // Gx Gy one row at a time, the magnitude goes straight to the destination
+        return [=, &simd](const PaddedImage& padded, unsigned char* destPixels, int stride) {
+            int tileWidth = padded.Width();
+            int tileHeight = padded.Height();
+            #pragma omp parallel
+            {
+                std::vector<double> gradientX(tileWidth), gradientY(tileWidth);
+                std::vector<double> columnBuffer(tileWidth + 2 * center);
+                std::vector<int> sumsX(tileWidth), sumsY(tileWidth);
+                #pragma omp for
+                for (int y = 0; y < tileHeight; ++y) {
+                    if (isSeparable) {
+                        SeparableConvolveRow(padded, y, 1, rowKernelX, columnKernelX, columnBuffer.data(), gradientX.data());
+                        SeparableConvolveRow(padded, y, 1, rowKernelY, columnKernelY, columnBuffer.data(), gradientY.data());
+                    }
+                    else if (isQuantized) {
+                        simd.ConvolveRow(padded, y, pairsX.data(), static_cast<int>(pairsX.size()), sumsX.data());
+                        simd.ConvolveRow(padded, y, pairsY.data(), static_cast<int>(pairsY.size()), sumsY.data());
+                        for (int x = 0; x < tileWidth; ++x) {
+                            gradientX[x] = sumsX[x] * scaleX;
+                            gradientY[x] = sumsY[x] * scaleY;
+                        }
+                    }
+                    else {
+                        for (int x = 0; x < tileWidth; ++x) {
+                            double sumX = 0.0;
+                            double sumY = 0.0;
+                            for (int ky = -center; ky <= center; ++ky) {
+                                const unsigned char* sourceRow = padded.Row(y + ky);
+                                for (int kx = -center; kx <= center; ++kx) {
+                                    int kernelIndex = (ky + center) * kernelSize + (kx + center);
+                                    sumX += kernelX[kernelIndex] * sourceRow[x + kx];
+                                    sumY += kernelY[kernelIndex] * sourceRow[x + kx];
+                                }
+                            }
+                            gradientX[x] = sumX;
+                            gradientY[x] = sumY;
+                        }
+                    }
 
-        int center = kernelSize / 2;
-    
-        // Gx Gy
-        #pragma omp parallel for
-        for (int y = center; y < height - center; ++y) {
-            for (int x = center; x < width - center; ++x) {
-                double sumX = 0.0;
-                double sumY = 0.0;
-                for (int ky = -center; ky <= center; ++ky) {
-                    for (int kx = -center; kx <= center; ++kx) {
-                        int sourceIndex = (y + ky) * stride + (x + kx);
-                        int kernelIndex = (ky + center) * kernelSize + (kx + center);
-                        sumX += kernelX[kernelIndex] * sourceBuffer[sourceIndex];
-                        sumY += kernelY[kernelIndex] * sourceBuffer[sourceIndex];
+                    unsigned char* destRow = destPixels + y * stride;
+                    for (int x = 0; x < tileWidth; ++x) {
+                        double finalValue = sqrt(gradientX[x] * gradientX[x] + gradientY[x] * gradientY[x]);
+                        if (finalValue > 255) finalValue = 255;
+                        destRow[x] = static_cast<unsigned char>(finalValue);
                     }
                 }
-                int destIndex = y * stride + x;
-                bufferX[destIndex] = sumX;
-                bufferY[destIndex] = sumY;
             }
-        }
-        #pragma omp parallel for
-
-        for (int i = 0; i < height * stride; ++i) {
-            double finalValue = sqrt(bufferX[i] * bufferX[i] + bufferY[i] * bufferY[i]);
-            if (finalValue > 255) finalValue = 255;
-            pixelData[i] = static_cast<unsigned char>(finalValue);
-        }
-
-        delete[] sourceBuffer;
-        delete[] bufferX;
-        delete[] bufferY;
+        };
     }
 
-    // Laplacian - Complete
-    void ApplyLaplacian_CPU(void* pixels, int width, int height, int stride, int kernelSize)
+    void ApplySobel_CPU(void* pixels, int width, int height, int stride, int kernelSize)
     {
-  
         if (kernelSize % 2 == 0) kernelSize++;
-
-        std::vector<double> kernel = createLaplacianKernel(kernelSize);
-
         unsigned char* pixelData = static_cast<unsigned char*>(pixels);
-        unsigned char* resultBuffer = new unsigned char[height * stride];
-        memcpy(resultBuffer, pixelData, height * stride);
+        ApplyTiled(pixelData, pixelData, width, height, stride, 1, kernelSize / 2, MakeSobelFilter(kernelSize));
+    }
 
+    // Laplacian - Complete
+    TileFilter MakeLaplacianFilter(int kernelSize)
+    {
+        if (kernelSize % 2 == 0) kernelSize++;
         // �Ϲ�ȭ�� ������� �Լ� ȣ�� (kernelSum = 0���� �Ͽ� ���� ����)
-        ApplyConvolution(pixelData, resultBuffer, width, height, stride, kernel, kernelSize);
+        return MakeConvolutionFilter(createLaplacianKernel(kernelSize), kernelSize, false);
+    }
 
-        memcpy(pixelData, resultBuffer, height * stride);
-        delete[] resultBuffer;
+    void ApplyLaplacian_CPU(void* pixels, int width, int height, int stride, int kernelSize)
+    {
+        if (kernelSize % 2 == 0) kernelSize++;
+        unsigned char* pixelData = static_cast<unsigned char*>(pixels);
+        ApplyTiled(pixelData, pixelData, width, height, stride, 1, kernelSize / 2, MakeLaplacianFilter(kernelSize));
     }
 
     // // Blurring
     // Gaussian - Complete
+    TileFilter MakeGaussianBlurFilter(double sigma, int kernelSize, bool useCircularKernel)
+    {
+        return MakeConvolutionFilter(createGaussianKernel(kernelSize, sigma, useCircularKernel), kernelSize, false);
+    }
+
     void ApplyGaussianBlur_CPU(void* pixels, int width, int height, int stride, double sigma, int kernelSize, bool useCircularKernel)
     {
-        std::vector<double> kernel = createGaussianKernel(kernelSize, sigma, useCircularKernel);
         unsigned char* pixelData = static_cast<unsigned char*>(pixels);
-        unsigned char* resultBuffer = new unsigned char[height * stride];
-        memcpy(resultBuffer, pixelData, height * stride);
-
-        ApplyConvolution(pixelData, resultBuffer, width, height, stride, kernel, kernelSize);
-
-        memcpy(pixelData, resultBuffer, height * stride);
-        delete[] resultBuffer;
+        ApplyTiled(pixelData, pixelData, width, height, stride, 1, kernelSize / 2,
+            MakeGaussianBlurFilter(sigma, kernelSize, useCircularKernel));
     }
 
 
     // Average Blur
+    TileFilter MakeAverageBlurFilter(int kernelSize, bool useCircularKernel)
+    {
+        if (kernelSize % 2 == 0) kernelSize++;
+        return [=](const PaddedImage& padded, unsigned char* destPixels, int stride) {
+            if (useCircularKernel) {
+                ApplyCircularAverageFilter(padded, destPixels, stride, kernelSize, false);
+            }
+            else {
+                ApplyBoxFilter(padded, destPixels, stride, kernelSize, false);
+            }
+        };
+    }
+
     void ApplyAverageBlur_CPU(void* pixels, int width, int height, int stride, int kernelSize, bool useCircularKernel)
     {
-        std::vector<double> kernel = createAverageKernel(kernelSize, useCircularKernel);
+        if (kernelSize % 2 == 0) kernelSize++;
         unsigned char* pixelData = static_cast<unsigned char*>(pixels);
-        unsigned char* resultBuffer = new unsigned char[height * stride];
-        memcpy(resultBuffer, pixelData, height * stride);
-
-        ApplyConvolution(pixelData, resultBuffer, width, height, stride, kernel, kernelSize);
-
-        memcpy(pixelData, resultBuffer, height * stride);
-        delete[] resultBuffer;
+        ApplyTiled(pixelData, pixelData, width, height, stride, 1, kernelSize / 2,
+            MakeAverageBlurFilter(kernelSize, useCircularKernel));
     }
 
 
     // Morphorogy
-    // Dilation
-    void ApplyDilation_CPU(void* pixels, int width, int height, int stride, int kernelSize, bool useCircularKernel)
+    // Running max/min engine (van Herk/Gil-Werman)
+    template <bool isMax>
+    static inline unsigned char MorphologyOp(unsigned char a, unsigned char b)
     {
-        if (kernelSize % 2 == 0) kernelSize++;
-        int center = kernelSize / 2;
-        double radiusSq = center * center;
-
-        unsigned char* pixelData = static_cast<unsigned char*>(pixels);
-        unsigned char* sourceBuffer = new unsigned char[height * stride];
-        memcpy(sourceBuffer, pixelData, height * stride);
+        return isMax ? (a > b ? a : b) : (a < b ? a : b);
+    }
 
-        #pragma omp parallel for
-        for (int y = center; y < height - center; ++y) {
-            for (int x = center; x < width - center; ++x) {
-                unsigned char maxValue = 0;
-                for (int ky = -center; ky <= center; ++ky) {
-                    for (int kx = -center; kx <= center; ++kx) {
-                        if (useCircularKernel && (kx * kx + ky * ky) > radiusSq) {
-                            continue;
-                        }
-                        unsigned char currentVal = sourceBuffer[(y + ky) * stride + (x + kx)];
-                        if (currentVal > maxValue) {
-                            maxValue = currentVal;
-                        }
-                    }
-                }
-                pixelData[y * stride + x] = maxValue;
-            }
+    // out[i] = op(row[i] .. row[i + length - 1]) for 0 <= i <= count - length (pixel units)
+    // Block prefix/suffix extrema make it ~3 comparisons per byte whatever the length
+    template <bool isMax>
+    static void RunningExtremumRow(const unsigned char* row, int count, int pixelBytes, int length,
+        unsigned char* out, unsigned char* prefix, unsigned char* suffix)
+    {
+        int byteCount = count * pixelBytes;
+        int blockBytes = length * pixelBytes;
+        for (int blockBegin = 0; blockBegin < byteCount; blockBegin += blockBytes) {
+            int blockEnd = std::min(blockBegin + blockBytes, byteCount);
+            for (int i = blockBegin; i < blockBegin + pixelBytes; ++i) prefix[i] = row[i];
+            for (int i = blockBegin + pixelBytes; i < blockEnd; ++i) prefix[i] = MorphologyOp<isMax>(prefix[i - pixelBytes], row[i]);
+            for (int i = blockEnd - 1; i >= blockEnd - pixelBytes; --i) suffix[i] = row[i];
+            for (int i = blockEnd - pixelBytes - 1; i >= blockBegin; --i) suffix[i] = MorphologyOp<isMax>(suffix[i + pixelBytes], row[i]);
+        }
+        int outBytes = (count - length + 1) * pixelBytes;
+        for (int i = 0; i < outBytes; ++i) {
+            out[i] = MorphologyOp<isMax>(suffix[i], prefix[i + blockBytes - pixelBytes]);
         }
-        delete[] sourceBuffer;
     }
 
-    // Erosion
-    void ApplyErosion_CPU(void* pixels, int width, int height, int stride, int kernelSize, bool useCircularKernel)
+    // Same recurrence down the columns, whole rows at a time so the inner loops stay contiguous
+    // out row i = op(in rows i .. i + length - 1) for 0 <= i <= rows - length
+    template <bool isMax>
+    static void RunningExtremumColumns(const unsigned char* in, int inStride, int rows, int bytes, int length,
+        unsigned char* out, int outStride, unsigned char* prefix, unsigned char* suffix)
     {
-        if (kernelSize % 2 == 0) kernelSize++;
-        int center = kernelSize / 2;
-        double radiusSq = center * center;
-
-        unsigned char* pixelData = static_cast<unsigned char*>(pixels);
-        unsigned char* sourceBuffer = new unsigned char[height * stride];
-        memcpy(sourceBuffer, pixelData, height * stride);
-        #pragma omp parallel for
-        for (int y = center; y < height - center; ++y) {
-            for (int x = center; x < width - center; ++x) {
-                unsigned char minValue = 255;
-                for (int ky = -center; ky <= center; ++ky) {
-                    for (int kx = -center; kx <= center; ++kx) {
-                        if (useCircularKernel && (kx * kx + ky * ky) > radiusSq) {
-                            continue;
-                        }
-                        unsigned char currentVal = sourceBuffer[(y + ky) * stride + (x + kx)];
-                        if (currentVal < minValue) {
-                            minValue = currentVal;
-                        }
-                    }
-                }
-                pixelData[y * stride + x] = minValue;
+        for (int blockBegin = 0; blockBegin < rows; blockBegin += length) {
+            int blockEnd = std::min(blockBegin + length, rows);
+            memcpy(prefix + blockBegin * bytes, in + blockBegin * inStride, bytes);
+            for (int r = blockBegin + 1; r < blockEnd; ++r) {
+                const unsigned char* inRow = in + r * inStride;
+                const unsigned char* previous = prefix + (r - 1) * bytes;
+                unsigned char* current = prefix + r * bytes;
+                for (int i = 0; i < bytes; ++i) current[i] = MorphologyOp<isMax>(previous[i], inRow[i]);
             }
+            memcpy(suffix + (blockEnd - 1) * bytes, in + (blockEnd - 1) * inStride, bytes);
+            for (int r = blockEnd - 2; r >= blockBegin; --r) {
+                const unsigned char* inRow = in + r * inStride;
+                const unsigned char* next = suffix + (r + 1) * bytes;
+                unsigned char* current = suffix + r * bytes;
+                for (int i = 0; i < bytes; ++i) current[i] = MorphologyOp<isMax>(next[i], inRow[i]);
+            }
+        }
+        for (int r = 0; r + length <= rows; ++r) {
+            const unsigned char* suffixRow = suffix + r * bytes;
+            const unsigned char* prefixRow = prefix + (r + length - 1) * bytes;
+            unsigned char* outRow = out + r * outStride;
+            for (int i = 0; i < bytes; ++i) outRow[i] = MorphologyOp<isMax>(suffixRow[i], prefixRow[i]);
         }
-        delete[] sourceBuffer;
     }
 
-    // Image Matching 
-    // normailized cross correlation
-    void ApplyNCC_CPU(void* pixels, int width, int height, int stride, void* templatePixels, int templateWidth, int templateHeight,
-        int templateStride, int* outCoords)
+    // Dilation (isMax) / Erosion of one padded tile, neighbors outside the image come from the border policy.
+    // Square: horizontal line pass then vertical line pass.
+    // Circle: union of horizontal chords. Each distinct chord width gets one horizontal pass,
+    // then the rows that use that width are folded into the result.
+    template <bool isMax>
+    static void ApplyMorphology(const PaddedImage& padded, unsigned char* destPixels, int stride, int kernelSize, bool useCircularKernel)
     {
-        unsigned char* sourceBuffer = static_cast<unsigned char*>(pixels);
-        unsigned char* templateBuffer = static_cast<unsigned char*>(templatePixels);
-
-        double maxNccValue = -2.0;
-        int bestX = 0;
-        int bestY = 0;
+        int width = padded.Width();
+        int height = padded.Height();
+        int pixelBytes = padded.PixelBytes();
+        int center = kernelSize / 2;
+        int rowBytes = width * pixelBytes;
 
-        long long templatePixelCount = (long long)templateWidth * templateHeight;
+        // line results for rows -center .. height + center - 1
+        std::vector<unsigned char> lineBuffer((size_t)(height + 2 * center) * rowBytes);
+        auto lineRow = [&](int y) { return &lineBuffer[(size_t)(y + center) * rowBytes]; };
 
-        // Calculate the mean of the template
-        double templateSum = 0.0;
-        #pragma omp parallel for
-        for (int ty = 0; ty < templateHeight; ++ty)
-        {
-            for (int tx = 0; tx < templateWidth; ++tx)
-            {
-                templateSum += templateBuffer[ty * templateStride + tx];
-            }
-        }
-        double meanT = templateSum / templatePixelCount;
-            
-        // Calculate sum of squared differences from the mean for the template
-        double templateSqDiffSum = 0.0;
-        #pragma omp parallel for
-        for (int ty = 0; ty < templateHeight; ++ty)
-        {
-            for (int tx = 0; tx < templateWidth; ++tx)
+        auto horizontalPass = [&](int halfWidth) {
+            #pragma omp parallel
             {
-                double diff = templateBuffer[ty * templateStride + tx] - meanT;
-                templateSqDiffSum += diff * diff;
+                std::vector<unsigned char> prefix((width + 2 * center) * pixelBytes), suffix((width + 2 * center) * pixelBytes);
+                #pragma omp for
+                for (int y = -center; y < height + center; ++y) {
+                    RunningExtremumRow<isMax>(padded.Row(y) - halfWidth * pixelBytes, width + 2 * halfWidth,
+                        pixelBytes, 2 * halfWidth + 1, lineRow(y), prefix.data(), suffix.data());
+                }
             }
-        }
+        };
 
-        #pragma omp parallel for
-        // Iterate over the source image
-        for (int y = 0; y <= height - templateHeight; ++y)
-        {
-            for (int x = 0; x <= width - templateWidth; ++x)
+        if (!useCircularKernel) {
+            horizontalPass(center);
+            const int stripBytes = 256;
+            int rows = height + 2 * center;
+            #pragma omp parallel
             {
-                double patchSum = 0.0;
-                for (int py = 0; py < templateHeight; ++py)
-                {
-                    for (int px = 0; px < templateWidth; ++px)
-                    {
-                        patchSum += sourceBuffer[(y + py) * stride + (x + px)];
-                    }
+                std::vector<unsigned char> prefix(rows * stripBytes), suffix(rows * stripBytes);
+                #pragma omp for
+                for (int stripBegin = 0; stripBegin < rowBytes; stripBegin += stripBytes) {
+                    int bytes = std::min(stripBytes, rowBytes - stripBegin);
+                    RunningExtremumColumns<isMax>(lineRow(-center) + stripBegin, rowBytes, rows, bytes, kernelSize,
+                        destPixels + stripBegin, stride, prefix.data(), suffix.data());
                 }
-                double meanI = patchSum / templatePixelCount;
-
-                double patchSqDiffSum = 0.0;
-                double crossCorrelationSum = 0.0;
-                for (int ty = 0; ty < templateHeight; ++ty)
-                {
-                    for (int tx = 0; tx < templateWidth; ++tx)
-                    {
-                        double imagePixel = sourceBuffer[(y + ty) * stride + (x + tx)];
-                        double templatePixel = templateBuffer[ty * templateStride + tx];
+            }
+        }
+        else {
+            // chord half width for each row offset, same (x*x + y*y) <= center*center test as before
+            std::vector<int> halfWidths(kernelSize);
+            int radiusSq = center * center;
+            for (int dy = -center; dy <= center; ++dy) {
+                int halfWidth = 0;
+                while ((halfWidth + 1) * (halfWidth + 1) + dy * dy <= radiusSq) ++halfWidth;
+                halfWidths[dy + center] = halfWidth;
+            }
 
-                        double imageDiff = imagePixel - meanI;
-                        double templateDiff = templatePixel - meanT;
+            unsigned char identity = isMax ? 0 : 255;
+            #pragma omp parallel for
+            for (int y = 0; y < height; ++y) {
+                memset(destPixels + y * stride, identity, rowBytes);
+            }
 
-                        patchSqDiffSum += imageDiff * imageDiff;
-                        crossCorrelationSum += imageDiff * templateDiff;
-                    }
+            for (int halfWidth = 0; halfWidth <= center; ++halfWidth) {
+                std::vector<int> rowOffsets;
+                for (int dy = -center; dy <= center; ++dy) {
+                    if (halfWidths[dy + center] == halfWidth) rowOffsets.push_back(dy);
                 }
+                if (rowOffsets.empty()) continue;
 
-                double denominator = sqrt(patchSqDiffSum * templateSqDiffSum);
-
-                double nccValue = 0.0;
-                if (denominator > 0)
-                {
-                    nccValue = crossCorrelationSum / denominator;
+                horizontalPass(halfWidth);
+                #pragma omp parallel for
+                for (int y = 0; y < height; ++y) {
+                    unsigned char* destRow = destPixels + y * stride;
+                    for (int dy : rowOffsets) {
+                        const unsigned char* line = lineRow(y + dy);
+                        for (int i = 0; i < rowBytes; ++i) destRow[i] = MorphologyOp<isMax>(destRow[i], line[i]);
+                    }
                 }
+            }
+        }
 
-                if (nccValue > maxNccValue)
-                {
-                    maxNccValue = nccValue;
-                    bestX = x;
-                    bestY = y;
+        if (pixelBytes == 4) {
+            // Alpha
+            #pragma omp parallel for
+            for (int y = 0; y < height; ++y) {
+                const unsigned char* sourceRow = padded.Row(y);
+                for (int x = 0; x < width; ++x) {
+                    destPixels[y * stride + x * 4 + 3] = sourceRow[x * 4 + 3];
                 }
             }
         }
-        outCoords[0] = bestX;
-        outCoords[1] = bestY;
     }
 
-    void ApplySAD_CPU(void* pixels, int width, int height, int stride, void* templatePixels, int templateWidth, int templateHeight, int templateStride, int* outCoords)
+    // Dilation
+    TileFilter MakeDilationFilter(int kernelSize, bool useCircularKernel)
     {
-        unsigned char* sourceData = static_cast<unsigned char*>(pixels);
-        unsigned char* templateData = static_cast<unsigned char*>(templatePixels);
+        if (kernelSize % 2 == 0) kernelSize++;
+        return [=](const PaddedImage& padded, unsigned char* destPixels, int stride) {
+            ApplyMorphology<true>(padded, destPixels, stride, kernelSize, useCircularKernel);
+        };
+    }
 
-        double minSadValue = -1.0;
-        int bestX = 0;
-        int bestY = 0;
-        #pragma omp parallel for
-        for (int y = 0; y <= height - templateHeight; ++y)
-        {
-            for (int x = 0; x <= width - templateWidth; ++x)
-            {
-                double currentSAD = 0.0;
-                for (int ty = 0; ty < templateHeight; ++ty)
-                {
-                    for (int tx = 0; tx < templateWidth; ++tx)
-                    {
-                        double imagePixel = sourceData[(y + ty) * stride + (x + tx)];
-                        double templatePixel = templateData[ty * templateStride + tx];
-                        currentSAD += abs(imagePixel - templatePixel);
-                    }
-                }
+    void ApplyDilation_CPU(void* pixels, int width, int height, int stride, int kernelSize, bool useCircularKernel)
+    {
+        if (kernelSize % 2 == 0) kernelSize++;
 
-                if (minSadValue == -1.0 || currentSAD < minSadValue)
-                {
-                    minSadValue = currentSAD;
-                    bestX = x;
-                    bestY = y;
-                }
-            }
-        }
-        outCoords[0] = bestX;
-        outCoords[1] = bestY;
+        unsigned char* pixelData = static_cast<unsigned char*>(pixels);
+        ApplyTiled(pixelData, pixelData, width, height, stride, 1, kernelSize / 2, MakeDilationFilter(kernelSize, useCircularKernel));
+    }
 
+    // Erosion
+    TileFilter MakeErosionFilter(int kernelSize, bool useCircularKernel)
+    {
+        if (kernelSize % 2 == 0) kernelSize++;
+        return [=](const PaddedImage& padded, unsigned char* destPixels, int stride) {
+            ApplyMorphology<false>(padded, destPixels, stride, kernelSize, useCircularKernel);
+        };
     }
 
-    void ApplySSD_CPU(void* pixels, int width, int height, int stride, void* templatePixels, int templateWidth, int templateHeight, int templateStride, int* outCoords)
+    void ApplyErosion_CPU(void* pixels, int width, int height, int stride, int kernelSize, bool useCircularKernel)
     {
-        unsigned char* sourceData = static_cast<unsigned char*>(pixels);
-        unsigned char* templateData = static_cast<unsigned char*>(templatePixels);
+        if (kernelSize % 2 == 0) kernelSize++;
 
-        double minSsdValue = -1.0;
-        int bestX = 0;
-        int bestY = 0;
-        #pragma omp parallel for
-        for (int y = 0; y <= height - templateHeight; ++y)
-        {
-            for (int x = 0; x <= width - templateWidth; ++x)
-            {
-                double currentSSD = 0.0;
-                for (int ty = 0; ty < templateHeight; ++ty)
-                {
-                    for (int tx = 0; tx < templateWidth; ++tx)
-                    {
-                        double imagePixel = sourceData[(y + ty) * stride + (x + tx)];
-                        double templatePixel = templateData[ty * templateStride + tx];
-                        double diff = imagePixel - templatePixel;
-                        currentSSD += diff * diff;
-                    }
-                }
+        unsigned char* pixelData = static_cast<unsigned char*>(pixels);
+        ApplyTiled(pixelData, pixelData, width, height, stride, 1, kernelSize / 2, MakeErosionFilter(kernelSize, useCircularKernel));
+    }
 
-                if (minSsdValue == -1.0 || currentSSD < minSsdValue)
-                {
-                    minSsdValue = currentSSD;
-                    bestX = x;
-                    bestY = y;
-                }
-            }
-        }
-        outCoords[0] = bestX;
-        outCoords[1] = bestY;
+    // Image Matching 
+    // normailized cross correlation
+    // Window mean and variance come from the integral tables of NccEngine, the cross term is one
+    // SIMD dot product per template row, or the FFT for large templates
+    void ApplyNCC_CPU(void* pixels, int width, int height, int stride, void* templatePixels, int templateWidth, int templateHeight,
+        int templateStride, int* outCoords)
+    {
+        GrayImage source = { static_cast<const unsigned char*>(pixels), width, height, stride };
+        GrayImage templ = { static_cast<const unsigned char*>(templatePixels), templateWidth, templateHeight, templateStride };
+        MatchTemplate_CPU(source, templ, MatchMethod::NCC, outCoords);
+    }
+
+    // Rows are searched in parallel, each keeps its own best (MatchTemplate_CPU)
+    void ApplySAD_CPU(void* pixels, int width, int height, int stride, void* templatePixels, int templateWidth, int templateHeight, int templateStride, int* outCoords)
+    {
+        GrayImage source = { static_cast<const unsigned char*>(pixels), width, height, stride };
+        GrayImage templ = { static_cast<const unsigned char*>(templatePixels), templateWidth, templateHeight, templateStride };
+        MatchTemplate_CPU(source, templ, MatchMethod::SAD, outCoords);
+    }
+
+    // Large templates: sum I^2 - 2 sum I T + sum T^2 with the cross term from the FFT
+    void ApplySSD_CPU(void* pixels, int width, int height, int stride, void* templatePixels, int templateWidth, int templateHeight, int templateStride, int* outCoords)
+    {
+        GrayImage source = { static_cast<const unsigned char*>(pixels), width, height, stride };
+        GrayImage templ = { static_cast<const unsigned char*>(templatePixels), templateWidth, templateHeight, templateStride };
+        MatchTemplate_CPU(source, templ, MatchMethod::SSD, outCoords);
     }
 
     // Color ONly!!! 
@@ -537,453 +851,365 @@ namespace ImaGyNative
     {
         std::vector<double> kernel = createGaussianKernel(kernelSize, sigma, useCircularKernel);
         unsigned char* pixelData = static_cast<unsigned char*>(pixels);
-        unsigned char* resultBuffer = new unsigned char[height * stride];
-        memcpy(resultBuffer, pixelData, height * stride);
 
-        ApplyConvolutionColor(pixelData, resultBuffer, width, height, stride, kernel, kernelSize);
-
-        memcpy(pixelData, resultBuffer, height * stride);
-        delete[] resultBuffer;
+        ApplyConvolutionColor(pixelData, pixelData, width, height, stride, kernel, kernelSize);
     }
 
     void ApplyAverageBlurColor_CPU(void* pixels, int width, int height, int stride, int kernelSize, bool useCircularKernel)
     {
-        std::vector<double> kernel = createAverageKernel(kernelSize, useCircularKernel);
+        if (kernelSize % 2 == 0) kernelSize++;
         unsigned char* pixelData = static_cast<unsigned char*>(pixels);
-        unsigned char* resultBuffer = new unsigned char[height * stride];
-        memcpy(resultBuffer, pixelData, height * stride);
 
-        ApplyConvolutionColor(pixelData, resultBuffer, width, height, stride, kernel, kernelSize);
-
-        memcpy(pixelData, resultBuffer, height * stride);
-        delete[] resultBuffer;
+        ForEachTile(pixelData, pixelData, width, height, stride, 4, kernelSize / 2, [&](const PaddedImage& padded, unsigned char* tileDest) {
+            if (useCircularKernel) {
+                ApplyCircularAverageFilter(padded, tileDest, stride, kernelSize, true);
+            }
+            else {
+                ApplyBoxFilter(padded, tileDest, stride, kernelSize, true);
+            }
+        });
     }
 
     void ApplyDilationColor_CPU(void* pixels, int width, int height, int stride, int kernelSize, bool useCircularKernel)
     {
         if (kernelSize % 2 == 0) kernelSize++;
-        int center = kernelSize / 2;
-        double radiusSq = center * center;
 
         unsigned char* pixelData = static_cast<unsigned char*>(pixels);
-        unsigned char* sourceBuffer = new unsigned char[height * stride];
-        memcpy(sourceBuffer, pixelData, height * stride);
-        #pragma omp parallel for
-        for (int y = center; y < height - center; ++y) {
-            for (int x = center; x < width - center; ++x) {
-                unsigned char maxB = 0, maxG = 0, maxR = 0;
-                for (int ky = -center; ky <= center; ++ky) {
-                    for (int kx = -center; kx <= center; ++kx) {
-                        if (useCircularKernel && (kx * kx + ky * ky) > radiusSq) {
-                            continue;
-                        }
-                        const unsigned char* p = sourceBuffer + (y + ky) * stride + (x + kx) * 4;
-                        if (p[0] > maxB) maxB = p[0];
-                        if (p[1] > maxG) maxG = p[1];
-                        if (p[2] > maxR) maxR = p[2];
-                    }
-                }
-                unsigned char* destP = pixelData + y * stride + x * 4;
-                destP[0] = maxB;
-                destP[1] = maxG;
-                destP[2] = maxR;
-                destP[3] = sourceBuffer[y * stride + x * 4 + 3]; // Alpha
-            }
-        }
-        delete[] sourceBuffer;
+        ForEachTile(pixelData, pixelData, width, height, stride, 4, kernelSize / 2, [&](const PaddedImage& padded, unsigned char* tileDest) {
+            ApplyMorphology<true>(padded, tileDest, stride, kernelSize, useCircularKernel);
+        });
     }
 
     void ApplyErosionColor_CPU(void* pixels, int width, int height, int stride, int kernelSize, bool useCircularKernel)
     {
         if (kernelSize % 2 == 0) kernelSize++;
-        int center = kernelSize / 2;
-        double radiusSq = center * center;
 
         unsigned char* pixelData = static_cast<unsigned char*>(pixels);
-        unsigned char* sourceBuffer = new unsigned char[height * stride];
-        memcpy(sourceBuffer, pixelData, height * stride);
-        #pragma omp parallel for
-        for (int y = center; y < height - center; ++y) {
-            for (int x = center; x < width - center; ++x) {
-                unsigned char minB = 255, minG = 255, minR = 255;
-                for (int ky = -center; ky <= center; ++ky) {
-                    for (int kx = -center; kx <= center; ++kx) {
-                        if (useCircularKernel && (kx * kx + ky * ky) > radiusSq) {
-                            continue;
-                        }
-                        const unsigned char* p = sourceBuffer + (y + ky) * stride + (x + kx) * 4;
-                        if (p[0] < minB) minB = p[0];
-                        if (p[1] < minG) minG = p[1];
-                        if (p[2] < minR) minR = p[2];
-                    }
-                }
-                unsigned char* destP = pixelData + y * stride + x * 4;
-                destP[0] = minB;
-                destP[1] = minG;
-                destP[2] = minR;
-                destP[3] = sourceBuffer[y * stride + x * 4 + 3]; // Alpha
-            }
-        }
-        delete[] sourceBuffer;
+        ForEachTile(pixelData, pixelData, width, height, stride, 4, kernelSize / 2, [&](const PaddedImage& padded, unsigned char* tileDest) {
+            ApplyMorphology<false>(padded, tileDest, stride, kernelSize, useCircularKernel);
+        });
     }
 
     const double PI = acos(-1);
-    /// <summary>
-    /// FFT Spectrum
-    /// </summary>
-    void ApplyFFT2DSpectrum_CPU(void* pixels, Complex* outputSpectrum, int width, int height, int stride, bool isInverse) {
-        const void* readOnlyPixels = static_cast<const void*>(pixels);
-
-        // FFT 
-        ApplyFFT2D_CPU(readOnlyPixels, outputSpectrum, width, height, stride, isInverse);
-
-        // DC 
-        FFT_Shift2D(outputSpectrum, width, height);
-
-        // 
-        float* magnitudes = new float[width * height];
-        float maxMagnitude = 0.0;
-        #pragma omp parallel for 
-        for (int i = 0; i < width * height; ++i) {
-            float mag = std::sqrt(outputSpectrum[i].real * outputSpectrum[i].real + outputSpectrum[i].imag * outputSpectrum[i].imag);
-            magnitudes[i] = std::log10(1.0 + mag);
-            if (magnitudes[i] > maxMagnitude) {
-                maxMagnitude = magnitudes[i];
-            }
-        }
-
-        unsigned char* resultBuffer = new unsigned char[height * stride];
-  
-        if (maxMagnitude > 0) {
-            #pragma omp parallel for
-            for (int y = 0; y < height; ++y) {
-                for (int x = 0; x < width; ++x) {
-                    int index = y * width + x;
-                    resultBuffer[y * stride + x] = static_cast<unsigned char>((magnitudes[index] / maxMagnitude) * 255.0);
-                }
-            }
-        }
-        else {
-            memset(resultBuffer, 0, height * stride);
-        }
 
-        memcpy(pixels, resultBuffer, height * stride);
-
-        delete[] magnitudes;
-        delete[] resultBuffer;
+    // F(u, v) of the full spectrum from a SpectrumLayout::Transposed half spectrum
+    static Complex FullSpectrumValue(const Complex* halfSpectrum, int width, int height, int u, int v)
+    {
+        if (u < HalfSpectrumWidth(width)) return halfSpectrum[(size_t)u * height + v];
+        Complex mirror = halfSpectrum[(size_t)(width - u) * height + (height - v) % height];
+        return { mirror.real, -mirror.imag };
     }
 
-    /// <summary>
-    /// FFT Phase 
-    /// </summary>
-    void ApplyFFT2DPhase_CPU(void* pixels, Complex* outputSpectrum, int width, int height, int stride, bool isInverse) {
-        ApplyFFT2D_CPU(pixels, outputSpectrum, width, height, stride, false);
-        // 
-        unsigned char* destPixels = static_cast<unsigned char*>(pixels);
-        #pragma omp parallel for
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                int index = y * width + x;
-                double phase = std::atan2(outputSpectrum[index].imag, outputSpectrum[index].real);
-
-                unsigned char phaseValue = static_cast<unsigned char>(((phase + PI) / (2.0 * PI)) * 255.0);
-                destPixels[y * stride + x] = phaseValue;
-            }
+    static Complex FullSpectrumValue(const SplitHalfSpectrum& spectrum, int width, int height, int u, int v)
+    {
+        if (u < HalfSpectrumWidth(width)) {
+            size_t index = (size_t)v * spectrum.stride + u;
+            return { spectrum.real[index], spectrum.imag[index] };
         }
+        size_t mirror = (size_t)((height - v) % height) * spectrum.stride + (width - u);
+        return { spectrum.real[mirror], -spectrum.imag[mirror] };
     }
 
-    void ApplyFrequencyFilter_CPU(void* pixels, int width, int height, int stride, FilterType filterType, double radiusRatio) {
-
-        auto spectrum = std::make_unique<Complex[]>(width * height);
-        const unsigned char* inputPixels = static_cast<const unsigned char*>(pixels);
-        double maxRadius = std::min(width, height) / 2.0;
-        double radius = maxRadius * radiusRatio;
-#pragma omp parallel for
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                spectrum[y * width + x] = { static_cast<double>(inputPixels[y * stride + x]), 0.0 };
-            }
-        }
-
-#pragma omp parallel for
-        for (int y = 0; y < height; ++y) {
-            FFT_1D_Iterative(&spectrum[y * width], width, false);
-        }
-
-        
+    // Shifted log-magnitude image, normalised to the brightest frequency.
+    // |F(u, v)| == |F(-u, -v)|, so the logarithms are taken over the half spectrum only
+    template <class Spectrum>
+    static void StoreLogMagnitudes(const Spectrum& spectrum, unsigned char* destPixels, int width, int height, int stride, double scale)
+    {
+        int halfWidth = HalfSpectrumWidth(width);
+        std::vector<float> magnitudes((size_t)halfWidth * height);
+        float maxMagnitude = 0.0f;
 #pragma omp parallel
         {
-            auto column_buffer = std::make_unique<Complex[]>(height);
-            #pragma omp for
-            for (int x = 0; x < width; ++x) {
-                for (int y = 0; y < height; ++y) {
-                    column_buffer[y] = spectrum[y * width + x];
-                }
-                FFT_1D_Iterative(column_buffer.get(), height, false);
-                for (int y = 0; y < height; ++y) {
-                    spectrum[y * width + x] = column_buffer[y];
+            float localMax = 0.0f;
+#pragma omp for
+            for (int v = 0; v < height; ++v) {
+                for (int u = 0; u < halfWidth; ++u) {
+                    Complex value = FullSpectrumValue(spectrum, width, height, u, v);
+                    double mag = scale * std::sqrt(value.real * value.real + value.imag * value.imag);
+                    float logMagnitude = static_cast<float>(std::log10(1.0 + mag));
+                    magnitudes[(size_t)v * halfWidth + u] = logMagnitude;
+                    localMax = std::max(localMax, logMagnitude);
                 }
             }
+#pragma omp critical
+            maxMagnitude = std::max(maxMagnitude, localMax);
         }
 
-        FFT_Shift2D(spectrum.get(), width, height);
-
-        double centerX = width / 2.0;
-        double centerY = height / 2.0;
 #pragma omp parallel for
         for (int y = 0; y < height; ++y) {
+            // DC lands at (width / 2, height / 2) as after FFT_Shift2D
+            int v = (y + height - height / 2) % height;
             for (int x = 0; x < width; ++x) {
-                int index = y * width + x;
-                double distance = std::sqrt(std::pow(x - centerX, 2) + std::pow(y - centerY, 2));
-                double mask = (filterType == FilterType::LowPass)
-                    ? ((distance <= radius) ? 1.0 : 0.0)
-                    : ((distance > radius) ? 1.0 : 0.0);
-                spectrum[index] = spectrum[index] * mask;
+                int u = (x + width - width / 2) % width;
+                float magnitude = (u < halfWidth)
+                    ? magnitudes[(size_t)v * halfWidth + u]
+                    : magnitudes[(size_t)((height - v) % height) * halfWidth + (width - u)];
+                destPixels[(size_t)y * stride + x] = (maxMagnitude > 0)
+                    ? static_cast<unsigned char>((magnitude / maxMagnitude) * 255.0)
+                    : 0;
             }
         }
+    }
 
-        FFT_Shift2D(spectrum.get(), width, height);
-
+    template <class Spectrum>
+    static void StorePhases(const Spectrum& spectrum, unsigned char* destPixels, int width, int height, int stride)
+    {
 #pragma omp parallel for
         for (int y = 0; y < height; ++y) {
-            FFT_1D_Iterative(&spectrum[y * width], width, true);
-        }
-
-#pragma omp parallel
-        {
-            auto column_buffer = std::make_unique<Complex[]>(height);
-            #pragma omp for
             for (int x = 0; x < width; ++x) {
-                for (int y = 0; y < height; ++y) {
-                    column_buffer[y] = spectrum[y * width + x];
-                }
-                FFT_1D_Iterative(column_buffer.get(), height, true);
-                for (int y = 0; y < height; ++y) {
-                    spectrum[y * width + x] = column_buffer[y];
-                }
+                Complex value = FullSpectrumValue(spectrum, width, height, x, y);
+                double phase = std::atan2(value.imag, value.real);
+
+                unsigned char phaseValue = static_cast<unsigned char>(((phase + PI) / (2.0 * PI)) * 255.0);
+                destPixels[(size_t)y * stride + x] = phaseValue;
             }
         }
+    }
 
-        unsigned char* outputPixels = static_cast<unsigned char*>(pixels);
+    // Real filter output back to 8 bits, clamped and truncated
+    static void StoreFilteredPixels(const std::vector<double>& values, unsigned char* outputPixels, int width, int height, int stride)
+    {
 #pragma omp parallel for
         for (int y = 0; y < height; ++y) {
             for (int x = 0; x < width; ++x) {
-                double val = spectrum[y * width + x].real;
+                double val = values[(size_t)y * width + x];
                 if (val < 0) val = 0;
                 if (val > 255) val = 255;
-                outputPixels[y * stride + x] = static_cast<unsigned char>(val);
+                outputPixels[(size_t)y * stride + x] = static_cast<unsigned char>(val);
             }
         }
     }
 
+    /// <summary>
+    /// FFT Spectrum
+    /// The shifted log-magnitude image, read from the half spectrum through the Hermitian symmetry.
+    /// The transform runs in single precision (FFT2D_RealForwardSplit), plenty for 8 bits out.
+    /// outputSpectrum (HalfSpectrumWidth(width) x height) is only written for sizes without a batch plan,
+    /// which take the double transform in the transposed layout
+    /// </summary>
+    void ApplyFFT2DSpectrum_CPU(void* pixels, Complex* outputSpectrum, int width, int height, int stride, bool isInverse) {
+        const unsigned char* sourcePixels = static_cast<const unsigned char*>(pixels);
+        unsigned char* destPixels = static_cast<unsigned char*>(pixels);
+        // the inverse transform of real input is conj(F) / (width * height): same magnitudes, scaled
+        double scale = isInverse ? 1.0 / ((double)width * height) : 1.0;
 
-    void ApplyAxialBandStopFilter_CPU(void* pixels, int width, int height, int stride,
-        double lowFreqRadius, double magnitudeThreshold)
-    {
-        auto spectrum = std::make_unique<Complex[]>(width * height);
-        const unsigned char* inputPixels = static_cast<const unsigned char*>(pixels);
-#pragma omp parallel for
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                spectrum[y * width + x] = { static_cast<double>(inputPixels[y * stride + x]), 0.0 };
-            }
+        SplitHalfSpectrum spectrum;
+        if (FFT2D_RealForwardSplit(sourcePixels, width, height, stride, spectrum)) {
+            StoreLogMagnitudes(spectrum, destPixels, width, height, stride, scale);
+            return;
         }
+        FFT2D_RealForward(sourcePixels, width, height, stride, outputSpectrum, SpectrumLayout::Transposed);
+        StoreLogMagnitudes(static_cast<const Complex*>(outputSpectrum), destPixels, width, height, stride, scale);
+    }
 
-#pragma omp parallel for
-        for (int y = 0; y < height; ++y) {
-            FFT_1D_Iterative(&spectrum[y * width], width, false);
-        }
+    /// <summary>
+    /// FFT Phase
+    /// Single precision like ApplyFFT2DSpectrum_CPU, outputSpectrum is the double fallback's buffer
+    /// </summary>
+    void ApplyFFT2DPhase_CPU(void* pixels, Complex* outputSpectrum, int width, int height, int stride, bool isInverse) {
+        const unsigned char* sourcePixels = static_cast<const unsigned char*>(pixels);
+        unsigned char* destPixels = static_cast<unsigned char*>(pixels);
 
-#pragma omp parallel
-        {
-            auto column_buffer = std::make_unique<Complex[]>(height);
-#pragma omp for
-            for (int x = 0; x < width; ++x) {
-                for (int y = 0; y < height; ++y) column_buffer[y] = spectrum[y * width + x];
-                FFT_1D_Iterative(column_buffer.get(), height, false);
-                for (int y = 0; y < height; ++y) spectrum[y * width + x] = column_buffer[y];
-            }
+        SplitHalfSpectrum spectrum;
+        if (FFT2D_RealForwardSplit(sourcePixels, width, height, stride, spectrum)) {
+            StorePhases(spectrum, destPixels, width, height, stride);
+            return;
         }
+        FFT2D_RealForward(sourcePixels, width, height, stride, outputSpectrum, SpectrumLayout::Transposed);
+        StorePhases(static_cast<const Complex*>(outputSpectrum), destPixels, width, height, stride);
+    }
 
-        // 대칭 이미지 생성
-        FFT_Shift2D(spectrum.get(), width, height);
+    // The filters work on the half spectrum in the transposed layout, spectrum[u * height + v].
+    // The forward transform comes from the spectrum cache and the masks from the mask cache
+    // (FrequencyMask.h), so re-running a filter on an unchanged image, or with parameters used before,
+    // is one multiply pass, the inverse transform and the quantisation
+    void ApplyFrequencyMask_CPU(void* pixels, int width, int height, int stride, const FrequencyMaskParams& params) {
+        int count = HalfSpectrumWidth(width) * height;
+        std::shared_ptr<const std::vector<Complex>> cached = GetCachedHalfSpectrum(static_cast<const unsigned char*>(pixels), width, height, stride);
+        std::shared_ptr<const std::vector<float>> mask = GetFrequencyMask(width, height, params);
+
+        std::vector<Complex> spectrum(count);
+        MultiplyFrequencyMask(cached->data(), mask->data(), count, spectrum.data());
+
+        std::vector<double> filtered((size_t)width * height);
+        FFT2D_RealInverse(spectrum.data(), width, height, filtered.data(), SpectrumLayout::Transposed);
+        StoreFilteredPixels(filtered, static_cast<unsigned char*>(pixels), width, height, stride);
+    }
 
-        // 밴드 스톱 필터 마스크 생성 및 적용
-        double centerX = width / 2.0;
-        double centerY = height / 2.0;
-        //double halfThickness = magnitudeThreshold / 2.0;
+    // Ideal disc of radiusRatio * min(width, height) / 2
+    void ApplyFrequencyFilter_CPU(void* pixels, int width, int height, int stride, FilterType filterType, double radiusRatio) {
+        double maxRadius = std::min(width, height) / 2.0;
+        FrequencyMaskParams params = {};
+        params.type = (filterType == FilterType::LowPass) ? FrequencyMaskType::IdealLowPass : FrequencyMaskType::IdealHighPass;
+        params.cutoff = maxRadius * radiusRatio;
+        ApplyFrequencyMask_CPU(pixels, width, height, stride, params);
+    }
 
+    // Outside lowFreqRadius (a cached ideal high-pass mask), frequencies with log |F| above the threshold
+    // are removed. The test runs on |F|^2 against e^(2 threshold), no sqrt or log per frequency
+    void ApplyAxialBandStopFilter_CPU(void* pixels, int width, int height, int stride,
+        double lowFreqRadius, double magnitudeThreshold)
+    {
+        int count = HalfSpectrumWidth(width) * height;
+        std::shared_ptr<const std::vector<Complex>> cached = GetCachedHalfSpectrum(static_cast<const unsigned char*>(pixels), width, height, stride);
+        FrequencyMaskParams outerParams = {};
+        outerParams.type = FrequencyMaskType::IdealHighPass;
+        outerParams.cutoff = lowFreqRadius;
+        std::shared_ptr<const std::vector<float>> outer = GetFrequencyMask(width, height, outerParams);
+
+        const Complex* source = cached->data();
+        const float* isOuter = outer->data();
+        double thresholdSquared = std::exp(2.0 * magnitudeThreshold);
+        std::vector<Complex> spectrum(count);
 #pragma omp parallel for
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                int index = y * width + x;
-                double distFromCenter = std::sqrt(std::pow(x - centerX, 2) + std::pow(y - centerY, 2));
-
-                double mask = 1.0; // 기본적으로 모든 주파수를 통과
-                
-                if (distFromCenter > lowFreqRadius) {
-                    
-                    double magnitude = std::sqrt(spectrum[index].real * spectrum[index].real + spectrum[index].imag * spectrum[index].imag);
-                    if (log(magnitude) > magnitudeThreshold) {
-                        mask = 0.0; 
-                    }
-                }
-
-                spectrum[index] = spectrum[index] * mask;
-            }
+        for (int i = 0; i < count; ++i) {
+            Complex value = source[i];
+            bool isStopped = isOuter[i] > 0.0f && value.real * value.real + value.imag * value.imag > thresholdSquared;
+            spectrum[i] = isStopped ? Complex{ 0.0, 0.0 } : value;
         }
 
         // 역변환 
-        FFT_Shift2D(spectrum.get(), width, height);
+        std::vector<double> filtered((size_t)width * height);
+        FFT2D_RealInverse(spectrum.data(), width, height, filtered.data(), SpectrumLayout::Transposed);
+        StoreFilteredPixels(filtered, static_cast<unsigned char*>(pixels), width, height, stride);
+    }
+
+    // Colour k-means through RunKMeans (KMeans.h): R, G, B as three byte planes, 3 bytes per pixel
+    // plus the engine's two float bounds and byte label
+    void ApplyKMeansClustering_CPU(void* pixels, int width, int height, int stride, int k, int iteration) {
+        if (k <= 0) return;
 
+        unsigned char* pixelData = static_cast<unsigned char*>(pixels);
+        int numPixels = width * height;
+
+        std::vector<unsigned char> planes((size_t)numPixels * 3);
+        unsigned char* red = planes.data();
+        unsigned char* green = red + numPixels;
+        unsigned char* blue = green + numPixels;
 #pragma omp parallel for
         for (int y = 0; y < height; ++y) {
-            FFT_1D_Iterative(&spectrum[y * width], width, true);
-        }
-
-#pragma omp parallel
-        {
-            auto column_buffer = std::make_unique<Complex[]>(height);
-#pragma omp for
+            const unsigned char* p = pixelData + (size_t)y * stride;
+            size_t row = (size_t)y * width;
             for (int x = 0; x < width; ++x) {
-                for (int y = 0; y < height; ++y) column_buffer[y] = spectrum[y * width + x];
-                FFT_1D_Iterative(column_buffer.get(), height, true);
-                for (int y = 0; y < height; ++y) spectrum[y * width + x] = column_buffer[y];
+                red[row + x] = p[x * 4 + 2];
+                green[row + x] = p[x * 4 + 1];
+                blue[row + x] = p[x * 4];
             }
         }
 
-        unsigned char* outputPixels = static_cast<unsigned char*>(pixels);
+        KMeansPoints points = { 3, numPixels, { red, green, blue }, nullptr };
+        std::vector<float> centroids;
+        std::vector<unsigned char> labels;
+        RunKMeans(points, k, iteration, std::random_device{}(), centroids, labels);
+
 #pragma omp parallel for
         for (int y = 0; y < height; ++y) {
             for (int x = 0; x < width; ++x) {
-                double val = spectrum[y * width + x].real;
-                if (val < 0) val = 0;
-                if (val > 255) val = 255;
-                outputPixels[y * stride + x] = static_cast<unsigned char>(val);
+                const float* centroid = &centroids[(size_t)labels[(size_t)y * width + x] * 3];
+                unsigned char* p = pixelData + (size_t)y * stride + x * 4;
+                p[2] = static_cast<unsigned char>(centroid[0]); // R
+                p[1] = static_cast<unsigned char>(centroid[1]); // G
+                p[0] = static_cast<unsigned char>(centroid[2]); // B
+                // p[3] is the alpha value so pass it
             }
         }
     }
 
-    // RGB 
-    struct ColorPoint {
-        double r, g, b;
-    };
+    // Bin of a BGRA pixel in a histogram of `bits` bits per channel, red in the high bits
+    static int ColorBin(const unsigned char* p, int bits)
+    {
+        int shift = 8 - bits;
+        return ((p[2] >> shift) << (2 * bits)) | ((p[1] >> shift) << bits) | (p[0] >> shift);
+    }
 
-    void ApplyKMeansClustering_CPU(void* pixels, int width, int height, int stride, int k, int iteration) {
+    void ApplyKMeansClusteringHistogram_CPU(void* pixels, int width, int height, int stride, int k, int iteration, int bitsPerChannel) {
         if (k <= 0) return;
 
         unsigned char* pixelData = static_cast<unsigned char*>(pixels);
-        int numPixels = width * height;
-
-        std::vector<ColorPoint> allPixels(numPixels); // 3차원 벡터 생성
-#pragma omp parallel for
-        for (int i = 0; i < numPixels; ++i) {
-            int y = i / width;
-            int x = i % width;
-            unsigned char* p = pixelData + y * stride + x * 4;
-            allPixels[i] = { (double)p[2], (double)p[1], (double)p[0] }; // R, G, B
-        }
-        // k-means++ 초기화 
-        std::vector<ColorPoint> centroids(k);
-        std::mt19937 rng(std::random_device{}());
+        int bits = std::max(4, std::min(bitsPerChannel, 7));
+        int binCount = 1 << (3 * bits);
 
-        // 첫 번째 중심점은 무작위로 선택
-        std::uniform_int_distribution<int> dist(0, numPixels - 1);
-        centroids[0] = allPixels[dist(rng)];
-
-        std::vector<double> minDistSq(numPixels);
-
-        // 나머지 k-1개의 중심점을 선택
-        for (int i = 1; i < k; ++i) {
-            double totalDistSq = 0.0;
-
-            // 각 픽셀에 대해, 이미 선택된 중심점들과의 가장 짧은 거리(의 제곱)를 계산
-#pragma omp parallel for reduction(+:totalDistSq)
-            for (int p_idx = 0; p_idx < numPixels; ++p_idx) {
-                double currentMinDistSq = std::numeric_limits<double>::max();
-                for (int c_idx = 0; c_idx < i; ++c_idx) {
-                    double dr = allPixels[p_idx].r - centroids[c_idx].r;
-                    double dg = allPixels[p_idx].g - centroids[c_idx].g;
-                    double db = allPixels[p_idx].b - centroids[c_idx].b;
-                    double distSq = dr * dr + dg * dg + db * db;
-                    if (distSq < currentMinDistSq) {
-                        currentMinDistSq = distSq;
-                    }
-                }
-                minDistSq[p_idx] = currentMinDistSq;
-                totalDistSq += currentMinDistSq;
+        // per-thread histograms merged once, as in ApplyHistogram
+        std::vector<unsigned int> histogram(binCount, 0);
+#pragma omp parallel
+        {
+            std::vector<unsigned int> localHistogram(binCount, 0);
+#pragma omp for nowait
+            for (int y = 0; y < height; ++y) {
+                const unsigned char* p = pixelData + (size_t)y * stride;
+                for (int x = 0; x < width; ++x) localHistogram[ColorBin(p + x * 4, bits)]++;
             }
+#pragma omp critical
+            for (int i = 0; i < binCount; ++i) histogram[i] += localHistogram[i];
+        }
 
-            // 거리 제곱에 비례하는 확률로 다음 중심점을 선택 (룰렛 휠 선택 방식)
-            std::uniform_real_distribution<double> dist_real(0.0, totalDistSq);
-            double randVal = dist_real(rng);
-            double cumulativeDist = 0.0;
-            for (int p_idx = 0; p_idx < numPixels; ++p_idx) {
-                cumulativeDist += minDistSq[p_idx];
-                if (cumulativeDist >= randVal) {
-                    centroids[i] = allPixels[p_idx];
-                    break;
-                }
-            }
+        // occupied bins as points at their bin centres, weighted by their pixel counts
+        std::vector<int> occupied;
+        for (int i = 0; i < binCount; ++i) {
+            if (histogram[i] > 0) occupied.push_back(i);
+        }
+        int pointCount = static_cast<int>(occupied.size());
+        if (pointCount == 0) return;
+
+        int shift = 8 - bits;
+        int mask = (1 << bits) - 1;
+        std::vector<unsigned char> planes((size_t)pointCount * 3);
+        std::vector<float> weights(pointCount);
+        for (int j = 0; j < pointCount; ++j) {
+            int bin = occupied[j];
+            planes[j] = static_cast<unsigned char>((((bin >> (2 * bits)) & mask) << shift) | (1 << (shift - 1)));
+            planes[pointCount + j] = static_cast<unsigned char>((((bin >> bits) & mask) << shift) | (1 << (shift - 1)));
+            planes[2 * pointCount + j] = static_cast<unsigned char>(((bin & mask) << shift) | (1 << (shift - 1)));
+            weights[j] = static_cast<float>(histogram[bin]);
         }
-        // k-means++ 
 
-        std::vector<int> assignments(numPixels);
-        int maxIterations = iteration;
+        KMeansPoints points = { 3, pointCount, { planes.data(), planes.data() + pointCount, planes.data() + 2 * pointCount }, weights.data() };
+        std::vector<float> centroids;
+        std::vector<unsigned char> labels;
+        RunKMeans(points, k, iteration, std::random_device{}(), centroids, labels);
 
-        for (int iter = 0; iter < maxIterations; ++iter) { // repeat til max iteration 
-#pragma omp parallel for
-            for (int y = 0; y < height; ++y) {
-                for (int x = 0; x < width; ++x) {                    
-                    unsigned char* p = pixelData + y * stride + x * 4;
-                    double minDistSq = std::numeric_limits<double>::max();
-                    int bestCluster = 0;
-
-                    for (int c = 0; c < k; ++c) {
-                        // p[2]=R, p[1]=G, p[0]=B
-                        double dr = p[2] - centroids[c].r;
-                        double dg = p[1] - centroids[c].g;
-                        double db = p[0] - centroids[c].b;
-                        double distSq = dr * dr + dg * dg + db * db;
-
-                        if (distSq < minDistSq) {
-                            minDistSq = distSq;
-                            bestCluster = c;
-                        }
-                    }
-                    assignments[y * width + x] = bestCluster;
-                }
-            }
-            std::vector<ColorPoint> newCentroids(k, { 0.0, 0.0, 0.0 });
-            std::vector<int> counts(k, 0);
+        std::vector<unsigned char> binLabels(binCount, 0);
+        for (int j = 0; j < pointCount; ++j) binLabels[occupied[j]] = labels[j];
 
+        // The centroids are means of bin centres; the colours written are the exact means of each
+        // cluster's pixels, one more pass with per-thread B, G, R, count sums
+        int clusterCount = static_cast<int>(centroids.size() / 3);
+        std::vector<unsigned long long> sums((size_t)clusterCount * 4, 0);
+#pragma omp parallel
+        {
+            std::vector<unsigned long long> localSums((size_t)clusterCount * 4, 0);
+#pragma omp for nowait
             for (int y = 0; y < height; ++y) {
-                for (int x = 0; x < width; ++x) {
-                    int clusterId = assignments[y * width + x];                    
-                    unsigned char* p = pixelData + y * stride + x * 4;
-                    newCentroids[clusterId].r += p[2]; // R
-                    newCentroids[clusterId].g += p[1]; // G
-                    newCentroids[clusterId].b += p[0]; // B
-                    counts[clusterId]++;
+                const unsigned char* p = pixelData + (size_t)y * stride;
+                for (int x = 0; x < width; ++x, p += 4) {
+                    unsigned long long* clusterSums = &localSums[(size_t)binLabels[ColorBin(p, bits)] * 4];
+                    clusterSums[0] += p[0];
+                    clusterSums[1] += p[1];
+                    clusterSums[2] += p[2];
+                    clusterSums[3]++;
                 }
             }
-            for (int c = 0; c < k; ++c) {
-                if (counts[c] > 0) {
-                    centroids[c].r = newCentroids[c].r / counts[c];
-                    centroids[c].g = newCentroids[c].g / counts[c];
-                    centroids[c].b = newCentroids[c].b / counts[c];
-                }
+#pragma omp critical
+            for (size_t i = 0; i < sums.size(); ++i) sums[i] += localSums[i];
+        }
+
+        std::vector<unsigned char> palette((size_t)clusterCount * 3, 0);
+        for (int c = 0; c < clusterCount; ++c) {
+            const unsigned long long* clusterSums = &sums[(size_t)c * 4];
+            if (clusterSums[3] == 0) continue;
+            for (int channel = 0; channel < 3; ++channel) {
+                palette[(size_t)c * 3 + channel] = static_cast<unsigned char>(clusterSums[channel] / clusterSums[3]);
             }
         }
+
 #pragma omp parallel for
         for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                int clusterId = assignments[y * width + x];
-                unsigned char* p = pixelData + y * stride + x * 4;
-                p[2] = static_cast<unsigned char>(centroids[clusterId].r); // R
-                p[1] = static_cast<unsigned char>(centroids[clusterId].g); // G
-                p[0] = static_cast<unsigned char>(centroids[clusterId].b); // B
-                // p[3] is the alpha value so pass it
+            unsigned char* p = pixelData + (size_t)y * stride;
+            for (int x = 0; x < width; ++x, p += 4) {
+                const unsigned char* color = &palette[(size_t)binLabels[ColorBin(p, bits)] * 3];
+                p[0] = color[0];
+                p[1] = color[1];
+                p[2] = color[2];
             }
         }
     }
@@ -1079,98 +1305,213 @@ namespace ImaGyNative
 //
 
 
-    struct Point5D {
-        double r, g, b, x, y;
-    };
+    // Spatial k-means works on R, G, B and the position, each min-max scaled to 0..255 and
+    // quantised to a byte: the [0, 1] normalisation times 255, so the clustering is the same
+    static const int SpatialDimensions = 5;
+    static const int MiniBatchSize = 1 << 16;
+    static const int SpatialTileWidth = 256;
 
+    static unsigned char ScaledPosition(int index, int size)
+    {
+        if (size <= 1) return 0;
+        return static_cast<unsigned char>(((long long)index * 255 + (size - 1) / 2) / (size - 1));
+    }
+
+    static void StoreSpatialFeature(const unsigned char* p, unsigned char column, unsigned char row, unsigned char* const* planes, int j)
+    {
+        planes[0][j] = p[2]; // R
+        planes[1][j] = p[1]; // G
+        planes[2][j] = p[0]; // B
+        planes[3][j] = column;
+        planes[4][j] = row;
+    }
+
+    // Features of `count` pixels into planes: all of them in order when count covers the image,
+    // otherwise drawn uniformly at random
+    static void DrawSpatialSample(const unsigned char* pixelData, int width, int height, int stride, const unsigned char* columns,
+        int count, std::mt19937& rng, unsigned char* const* planes)
+    {
+        long long numPixels = (long long)width * height;
+        std::uniform_int_distribution<long long> dist(0, numPixels - 1);
+        for (int j = 0; j < count; ++j) {
+            long long index = (count >= numPixels) ? j : dist(rng);
+            int y = static_cast<int>(index / width);
+            int x = static_cast<int>(index % width);
+            StoreSpatialFeature(pixelData + (size_t)y * stride + x * 4, columns[x], ScaledPosition(y, height), planes, j);
+        }
+    }
+
+    // Mini-batch k-means: k-means++ and Lloyd on one MiniBatchSize sample (every pixel of an image
+    // that small, which is then the exact result), then `iteration` fresh batches, each moving every
+    // centroid to the running mean of all sampled points assigned to it. The final labels are found
+    // tile by tile with the features built on the fly, so beyond the pixels only a few hundred KB are
+    // held whatever the image size
     void ApplyKMeansClusteringXY_Normalized_CPU(void* pixels, int width, int height, int stride, int k, int iteration) {
-        if (k <= 0) return;
+        if (k <= 0 || width <= 0 || height <= 0) return;
 
         unsigned char* pixelData = static_cast<unsigned char*>(pixels);
-        int numPixels = width * height;
+        long long numPixels = (long long)width * height;
+        std::vector<unsigned char> columns(width);
+        for (int x = 0; x < width; ++x) columns[x] = ScaledPosition(x, width);
 
-        // Scaling by Min-Max 
-        std::vector<Point5D> normalizedPixels(numPixels);
-        double w_minus_1 = width > 1 ? (double)(width - 1) : 1.0;
-        double h_minus_1 = height > 1 ? (double)(height - 1) : 1.0;
+        std::mt19937 rng(std::random_device{}());
+        int sampleCount = static_cast<int>(std::min<long long>(numPixels, MiniBatchSize));
+        std::vector<unsigned char> sample((size_t)sampleCount * SpatialDimensions);
+        unsigned char* planes[SpatialDimensions];
+        for (int d = 0; d < SpatialDimensions; ++d) planes[d] = sample.data() + (size_t)d * sampleCount;
+        KMeansPoints points = { SpatialDimensions, sampleCount, { planes[0], planes[1], planes[2], planes[3], planes[4] }, nullptr };
+
+        DrawSpatialSample(pixelData, width, height, stride, columns.data(), sampleCount, rng, planes);
+        std::vector<float> centroids;
+        std::vector<unsigned char> labels;
+        RunKMeans(points, k, iteration, rng(), centroids, labels);
+        int clusterCount = static_cast<int>(centroids.size() / SpatialDimensions);
+
+        if (numPixels > sampleCount) {
+            std::vector<double> means(centroids.begin(), centroids.end());
+            std::vector<double> counts(clusterCount, 0.0);
+            for (int j = 0; j < sampleCount; ++j) counts[labels[j]] += 1.0;
+
+            std::vector<double> batchSums((size_t)clusterCount * SpatialDimensions);
+            std::vector<double> batchCounts(clusterCount);
+            for (int batch = 0; batch < iteration; ++batch) {
+                DrawSpatialSample(pixelData, width, height, stride, columns.data(), sampleCount, rng, planes);
+                AssignNearestCentroids(points, centroids.data(), clusterCount, labels.data());
+
+                std::fill(batchSums.begin(), batchSums.end(), 0.0);
+                std::fill(batchCounts.begin(), batchCounts.end(), 0.0);
+                for (int j = 0; j < sampleCount; ++j) {
+                    int c = labels[j];
+                    for (int d = 0; d < SpatialDimensions; ++d) batchSums[(size_t)c * SpatialDimensions + d] += planes[d][j];
+                    batchCounts[c] += 1.0;
+                }
+                for (int c = 0; c < clusterCount; ++c) {
+                    if (batchCounts[c] == 0.0) continue;
+                    double total = counts[c] + batchCounts[c];
+                    for (int d = 0; d < SpatialDimensions; ++d) {
+                        size_t i = (size_t)c * SpatialDimensions + d;
+                        means[i] = (means[i] * counts[c] + batchSums[i]) / total;
+                        centroids[i] = static_cast<float>(means[i]);
+                    }
+                    counts[c] = total;
+                }
+            }
+        }
 
 #pragma omp parallel for
         for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                unsigned char* p = pixelData + y * stride + x * 4;
-                normalizedPixels[y * width + x] = {
-                    p[2] / 255.0,       // R
-                    p[1] / 255.0,       // G
-                    p[0] / 255.0,       // B
-                    x / w_minus_1,      // X
-                    y / h_minus_1       // Y
-                };
+            unsigned char* row = pixelData + (size_t)y * stride;
+            unsigned char tile[SpatialDimensions][SpatialTileWidth];
+            unsigned char* tilePlanes[SpatialDimensions] = { tile[0], tile[1], tile[2], tile[3], tile[4] };
+            unsigned char tileLabels[SpatialTileWidth];
+            unsigned char rowPosition = ScaledPosition(y, height);
+            for (int begin = 0; begin < width; begin += SpatialTileWidth) {
+                int count = std::min(SpatialTileWidth, width - begin);
+                for (int j = 0; j < count; ++j) {
+                    StoreSpatialFeature(row + (size_t)(begin + j) * 4, columns[begin + j], rowPosition, tilePlanes, j);
+                }
+                KMeansPoints tilePoints = { SpatialDimensions, count, { tile[0], tile[1], tile[2], tile[3], tile[4] }, nullptr };
+                AssignNearestCentroids(tilePoints, centroids.data(), clusterCount, tileLabels);
+                for (int j = 0; j < count; ++j) {
+                    const float* centroid = &centroids[(size_t)tileLabels[j] * SpatialDimensions];
+                    unsigned char* p = row + (size_t)(begin + j) * 4;
+                    p[2] = static_cast<unsigned char>(centroid[0]); // R
+                    p[1] = static_cast<unsigned char>(centroid[1]); // G
+                    p[0] = static_cast<unsigned char>(centroid[2]); // B
+                }
             }
         }
+    }
 
-        // K-Means 
-        std::vector<Point5D> centroids(k);
-        std::mt19937 rng(std::random_device{}());
-        std::uniform_int_distribution<int> dist(0, numPixels - 1);
+    static const int GmmMaxIterations = 100;
+    static const int GmmSampleSize = 1 << 16;
+
+    // Every pixel takes the mean of its most probable component. EM runs on the intensity
+    // histogram, so only the histogram and the final LUT pass touch the pixels
+    void ApplyGmmSegmentation_CPU(void* pixels, int width, int height, int stride, int numClusters) {
+        if (numClusters <= 0) return;
 
-        for (int i = 0; i < k; ++i) {
-            centroids[i] = normalizedPixels[dist(rng)];
+        unsigned char* pixelData = static_cast<unsigned char*>(pixels);
+        unsigned int histogram[256] = { 0 };
+#pragma omp parallel
+        {
+            unsigned int localHistogram[256] = { 0 };
+#pragma omp for nowait
+            for (int y = 0; y < height; ++y) {
+                const unsigned char* row = pixelData + (size_t)y * stride;
+                for (int x = 0; x < width; ++x) localHistogram[row[x]]++;
+            }
+#pragma omp critical
+            for (int i = 0; i < 256; ++i) histogram[i] += localHistogram[i];
         }
 
-        std::vector<int> assignments(numPixels);
-        int maxIterations = iteration;
+        std::vector<IntensityGaussian> components;
+        FitIntensityGmm(histogram, numClusters, GmmMaxIterations, components);
+        if (components.empty()) return;
+
+        unsigned char labels[256];
+        IntensityGmmLabels(components, labels);
+        unsigned char lut[256];
+        for (int v = 0; v < 256; ++v) {
+            lut[v] = static_cast<unsigned char>(std::min(std::max(components[labels[v]].mean + 0.5, 0.0), 255.0));
+        }
 
-        for (int iter = 0; iter < maxIterations; ++iter) {
 #pragma omp parallel for
-            for (int i = 0; i < numPixels; ++i) {
-                double minDistSq = std::numeric_limits<double>::max();
-                int bestCluster = 0;
-                for (int c = 0; c < k; ++c) {
-                    double dr = normalizedPixels[i].r - centroids[c].r;
-                    double dg = normalizedPixels[i].g - centroids[c].g;
-                    double db = normalizedPixels[i].b - centroids[c].b;
-                    double dx = normalizedPixels[i].x - centroids[c].x;
-                    double dy = normalizedPixels[i].y - centroids[c].y;
-                    double distSq = dr * dr + dg * dg + db * db + dx * dx + dy * dy;
-
-                    if (distSq < minDistSq) {
-                        minDistSq = distSq;
-                        bestCluster = c;
-                    }
-                }
-                assignments[i] = bestCluster;
-            }
+        for (int y = 0; y < height; ++y) {
+            unsigned char* row = pixelData + (size_t)y * stride;
+            for (int x = 0; x < width; ++x) row[x] = lut[row[x]];
+        }
+    }
 
-            std::vector<Point5D> newCentroids(k, { 0.0, 0.0, 0.0, 0.0, 0.0 });
-            std::vector<int> counts(k, 0);
-            for (int i = 0; i < numPixels; ++i) {
-                int clusterId = assignments[i];
-                newCentroids[clusterId].r += normalizedPixels[i].r;
-                newCentroids[clusterId].g += normalizedPixels[i].g;
-                newCentroids[clusterId].b += normalizedPixels[i].b;
-                newCentroids[clusterId].x += normalizedPixels[i].x;
-                newCentroids[clusterId].y += normalizedPixels[i].y;
-                counts[clusterId]++;
-            }
-            for (int c = 0; c < k; ++c) {
-                if (counts[c] > 0) {
-                    centroids[c] = {
-                        newCentroids[c].r / counts[c], newCentroids[c].g / counts[c],
-                        newCentroids[c].b / counts[c], newCentroids[c].x / counts[c],
-                        newCentroids[c].y / counts[c]
-                    };
-                }
+    // R, G, B of `count` pixels into planes: all of them in order when count covers the image,
+    // otherwise drawn uniformly at random
+    static void DrawColorSample(const unsigned char* pixelData, int width, int height, int stride, int count,
+        std::mt19937& rng, unsigned char* const* planes)
+    {
+        long long numPixels = (long long)width * height;
+        std::uniform_int_distribution<long long> dist(0, numPixels - 1);
+        for (int j = 0; j < count; ++j) {
+            long long index = (count >= numPixels) ? j : dist(rng);
+            const unsigned char* p = pixelData + (size_t)(index / width) * stride + (index % width) * 4;
+            planes[0][j] = p[2]; // R
+            planes[1][j] = p[1]; // G
+            planes[2][j] = p[0]; // B
+        }
+    }
+
+    // EM with full-covariance components on a GmmSampleSize sample; every pixel then takes the mean
+    // colour of its most probable component
+    void ApplyGmmSegmentationColor_CPU(void* pixels, int width, int height, int stride, int numClusters) {
+        if (numClusters <= 0 || width <= 0 || height <= 0) return;
+
+        unsigned char* pixelData = static_cast<unsigned char*>(pixels);
+        std::mt19937 rng(std::random_device{}());
+        int sampleCount = static_cast<int>(std::min<long long>((long long)width * height, GmmSampleSize));
+        std::vector<unsigned char> sample((size_t)sampleCount * 3);
+        unsigned char* planes[3] = { sample.data(), sample.data() + sampleCount, sample.data() + 2 * (size_t)sampleCount };
+        DrawColorSample(pixelData, width, height, stride, sampleCount, rng, planes);
+
+        KMeansPoints points = { 3, sampleCount, { planes[0], planes[1], planes[2] }, nullptr };
+        std::vector<ColorGaussian> components;
+        FitColorGmm(points, numClusters, GmmMaxIterations, rng(), components);
+        if (components.empty()) return;
+
+        std::vector<unsigned char> palette(components.size() * 3);
+        for (size_t c = 0; c < components.size(); ++c) {
+            for (int i = 0; i < 3; ++i) {
+                palette[c * 3 + i] = static_cast<unsigned char>(std::min(std::max(components[c].mean[i] + 0.5, 0.0), 255.0));
             }
         }
 
 #pragma omp parallel for
         for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                int clusterId = assignments[y * width + x];
-                unsigned char* p = pixelData + y * stride + x * 4;
-                p[2] = static_cast<unsigned char>(centroids[clusterId].r * 255.0); // R
-                p[1] = static_cast<unsigned char>(centroids[clusterId].g * 255.0); // G
-                p[0] = static_cast<unsigned char>(centroids[clusterId].b * 255.0); // B
+            unsigned char* p = pixelData + (size_t)y * stride;
+            for (int x = 0; x < width; ++x, p += 4) {
+                double color[3] = { (double)p[2], (double)p[1], (double)p[0] };
+                const unsigned char* mean = &palette[(size_t)MostLikelyColorComponent(components, color) * 3];
+                p[2] = mean[0]; // R
+                p[1] = mean[1]; // G
+                p[0] = mean[2]; // B
             }
         }
     }
@@ -1,7 +1,10 @@
 #pragma once
 
+#include "BorderHandling.h"
+#include "FrequencyMask.h"
 #include <vector>
 #include <complex>
+#include <functional>
 
 namespace ImaGyNative
 {
@@ -31,6 +34,18 @@ namespace ImaGyNative
 	void ApplyDilation_CPU(void* pixels, int width, int height, int stride, int kernelSize, bool useCircularKernel);
 	void ApplyErosion_CPU(void* pixels, int width, int height, int stride, int kernelSize, bool useCircularKernel);
 
+	// Tile-level form of the grayscale neighborhood filters, shared by the *_CPU functions and Pipeline.
+	// Kernel setup happens once in Make*Filter. The returned function filters one padded tile
+	// (border >= kernelSize / 2) into padded.Width() x padded.Height() pixels at dest
+	using TileFilter = std::function<void(const PaddedImage& padded, unsigned char* dest, int destStride)>;
+	TileFilter MakeDifferentialFilter();
+	TileFilter MakeSobelFilter(int kernelSize);
+	TileFilter MakeLaplacianFilter(int kernelSize);
+	TileFilter MakeGaussianBlurFilter(double sigma, int kernelSize, bool useCircularKernel);
+	TileFilter MakeAverageBlurFilter(int kernelSize, bool useCircularKernel);
+	TileFilter MakeDilationFilter(int kernelSize, bool useCircularKernel);
+	TileFilter MakeErosionFilter(int kernelSize, bool useCircularKernel);
+
 	void ApplyNCC_CPU(void* pixels, int width, int height, int stride, void* templatePixels, int templateWidth, int templateHeight,
 		int templateStride, int* outCoords);
 	void ApplySAD_CPU(void* pixels, int width, int height, int stride, void* templatePixels, int templateWidth, int templateHeight, int templateStride, int* outCoords);
@@ -49,15 +64,24 @@ namespace ImaGyNative
 	void ApplyErosionColor_CPU(void* pixels, int width, int height, int stride, int kernelSize, bool useCircularKernel);
 
 	// Gray sclae 로 
+	// outputSpectrum: HalfSpectrumWidth(width) * height values, the double transform's buffer (SpectrumLayout::Transposed)
+	// for sizes FFT2D_RealForwardSplit can't take
 	void ApplyFFT2DSpectrum_CPU(void* inputPixels, Complex* outputSpectrum, int width, int height, int stride, bool isInverse);
 	void ApplyFFT2DPhase_CPU(void* pixels, Complex* outputSpectrum, int width, int height, int stride, bool isInverse);
 
+	// Any mask of FrequencyMask.h over the cached forward spectrum
+	void ApplyFrequencyMask_CPU(void* pixels, int width, int height, int stride, const FrequencyMaskParams& params);
 	void ApplyFrequencyFilter_CPU(void* pixels, int width, int height, int stride, FilterType filterType, double radius);
 	void ApplyAxialBandStopFilter_CPU(void* pixels, int width, int height, int stride, double lowFreqRadius, double bandThickness);
 
 	// Clustering 
 	void ApplyKMeansClustering_CPU(void* pixels, int width, int height, int stride, int k, int iteration);
+	// Colour k-means on a 3-D histogram of bitsPerChannel (4..7) bits per channel: the iterations run over the
+	// occupied bins weighted by their counts, so their cost doesn't grow with the image
+	void ApplyKMeansClusteringHistogram_CPU(void* pixels, int width, int height, int stride, int k, int iteration, int bitsPerChannel);
 	void ApplyKMeansClusteringXY_Normalized_CPU(void* pixels, int width, int height, int stride, int k, int iteration);
+	// Gaussian mixture segmentation: grayscale by EM on the histogram, colour by EM on a pixel sample
 	void ApplyGmmSegmentation_CPU(void* pixels, int width, int height, int stride, int numClusters);
+	void ApplyGmmSegmentationColor_CPU(void* pixels, int width, int height, int stride, int numClusters);
 
 }
\ No newline at end of file
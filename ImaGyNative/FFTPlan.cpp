@@ -0,0 +1,369 @@
+#include "pch.h"
+#include "FFTPlan.h"
+#include "SimdDispatch.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace ImaGyNative
+{
+    static bool IsPowerOfTwo(int length)
+    {
+        return length > 0 && (length & (length - 1)) == 0;
+    }
+
+    // 4s first (fewest stages), then 2, 3, 5, 7 and whatever primes are left
+    static std::vector<int> FactorLength(int length)
+    {
+        std::vector<int> radices;
+        while (length % 4 == 0) {
+            radices.push_back(4);
+            length /= 4;
+        }
+        for (int factor = 2; factor * factor <= length; ++factor) {
+            while (length % factor == 0) {
+                radices.push_back(factor);
+                length /= factor;
+            }
+        }
+        if (length > 1) radices.push_back(length);
+        return radices;
+    }
+
+    // unit: one complex multiply-add per point. A radix-R stage costs about R per point,
+    // a radix-4 stage does the work of two radix-2 stages
+    static double MixedRadixCost(int length)
+    {
+        double perPoint = 0;
+        for (int radix : FactorLength(length)) perPoint += radix;
+        return length * perPoint;
+    }
+
+    static int BluesteinLength(int length)
+    {
+        return NextPowerOfTwo(2 * length - 1);
+    }
+
+    // two transforms of the padded length plus the chirp multiplies
+    static double BluesteinCost(int length)
+    {
+        double padded = BluesteinLength(length);
+        return 2.0 * MixedRadixCost(static_cast<int>(padded)) + 2.0 * padded + 2.0 * length;
+    }
+
+    FFTPlan::FFTPlan(int length, bool isInverse)
+        : length(length), isInverse(isInverse), algorithm(Algorithm::Radix4), hasRadix2Stage(false), maxRadix(0)
+    {
+        const double PI = acos(-1);
+        double angleSign = isInverse ? 1.0 : -1.0;
+
+        if (IsPowerOfTwo(length)) {
+            int bits = 0;
+            while ((1 << bits) < length) bits++;
+            hasRadix2Stage = (bits % 2) == 1;
+
+            for (int i = 1, j = 0; i < length; ++i) {
+                int bit = length >> 1;
+                for (; j & bit; bit >>= 1) j ^= bit;
+                j ^= bit;
+                if (i < j) {
+                    swaps.push_back(i);
+                    swaps.push_back(j);
+                }
+            }
+            for (int m = hasRadix2Stage ? 2 : 1; m < length; m *= 4) {
+                for (int j = 0; j < m; ++j) {
+                    double angle = angleSign * 2.0 * PI * j / (4.0 * m);
+                    twiddles.push_back({ cos(2.0 * angle), sin(2.0 * angle) });
+                    twiddles.push_back({ cos(angle), sin(angle) });
+                }
+            }
+            return;
+        }
+
+        if (MixedRadixCost(length) <= BluesteinCost(length)) {
+            algorithm = Algorithm::MixedRadix;
+            int span = 1;
+            for (int radix : FactorLength(length)) {
+                Stage stage = { radix, span, twiddles.size(), roots.size() };
+                for (int k = 0; k < span; ++k) {
+                    for (int r = 1; r < radix; ++r) {
+                        double angle = angleSign * 2.0 * PI * k * r / ((double)span * radix);
+                        twiddles.push_back({ cos(angle), sin(angle) });
+                    }
+                }
+                for (int r = 0; r < radix; ++r) {
+                    double angle = angleSign * 2.0 * PI * r / radix;
+                    roots.push_back({ cos(angle), sin(angle) });
+                }
+                stages.push_back(stage);
+                maxRadix = std::max(maxRadix, radix);
+                span *= radix;
+            }
+            return;
+        }
+
+        // n^2 is reduced modulo 2 * length before the angle is formed, so large n keep full precision
+        algorithm = Algorithm::Bluestein;
+        int padded = BluesteinLength(length);
+        chirp.resize(length);
+        for (int n = 0; n < length; ++n) {
+            long long phase = (long long)n * n % (2LL * length);
+            double angle = angleSign * PI * phase / length;
+            chirp[n] = { cos(angle), sin(angle) };
+        }
+        chirpSpectrum.assign(padded, Complex{ 0.0, 0.0 });
+        for (int n = 0; n < length; ++n) {
+            Complex conjugate = { chirp[n].real, -chirp[n].imag };
+            chirpSpectrum[n] = conjugate;
+            if (n > 0) chirpSpectrum[padded - n] = conjugate;
+        }
+        convolutionPlan.reset(new FFTPlan(padded, false));
+        convolutionPlan->Execute(chirpSpectrum.data());
+        for (Complex& value : chirpSpectrum) value = value * (1.0 / padded);
+    }
+
+    int FFTPlan::ScratchLength() const
+    {
+        switch (algorithm) {
+        case Algorithm::MixedRadix:
+            return length + 2 * maxRadix;
+        case Algorithm::Bluestein:
+            return static_cast<int>(chirpSpectrum.size());
+        default:
+            return 0;
+        }
+    }
+
+    void FFTPlan::Execute(Complex* data, Complex* scratch) const
+    {
+        switch (algorithm) {
+        case Algorithm::MixedRadix:
+            ExecuteMixedRadix(data, scratch);
+            break;
+        case Algorithm::Bluestein:
+            ExecuteBluestein(data, scratch);
+            break;
+        default:
+            ExecuteRadix4(data);
+            break;
+        }
+        if (isInverse) {
+            double scale = 1.0 / length;
+            for (int i = 0; i < length; ++i) data[i] = data[i] * scale;
+        }
+    }
+
+    void FFTPlan::Execute(Complex* data) const
+    {
+        std::vector<Complex> scratch(ScratchLength());
+        Execute(data, scratch.data());
+    }
+
+    void FFTPlan::ExecuteRadix4(Complex* data) const
+    {
+        for (size_t i = 0; i < swaps.size(); i += 2) std::swap(data[swaps[i]], data[swaps[i + 1]]);
+
+        int m = 1;
+        if (hasRadix2Stage) {
+            for (int i = 0; i < length; i += 2) {
+                Complex u = data[i];
+                Complex v = data[i + 1];
+                data[i] = u + v;
+                data[i + 1] = u - v;
+            }
+            m = 2;
+        }
+
+        // Two radix-2 stages at once: the pairs (a0, a1), (a2, a3) are merged with w^2j, then
+        // (b0, b2), (b1, b3) with w^j and w^(j + m) = w^j * (-+i)
+        const Complex* stageTwiddles = twiddles.data();
+        for (; m < length; m *= 4) {
+            for (int base = 0; base < length; base += 4 * m) {
+                Complex* x = data + base;
+                for (int j = 0; j < m; ++j) {
+                    Complex w2 = stageTwiddles[2 * j];
+                    Complex w1 = stageTwiddles[2 * j + 1];
+                    Complex v1 = w2 * x[j + m];
+                    Complex v3 = w2 * x[j + 3 * m];
+                    Complex b0 = x[j] + v1;
+                    Complex b1 = x[j] - v1;
+                    Complex c2 = w1 * (x[j + 2 * m] + v3);
+                    Complex c3 = w1 * (x[j + 2 * m] - v3);
+                    Complex rotated = isInverse ? Complex{ -c3.imag, c3.real } : Complex{ c3.imag, -c3.real };
+                    x[j] = b0 + c2;
+                    x[j + m] = b1 + rotated;
+                    x[j + 2 * m] = b0 - c2;
+                    x[j + 3 * m] = b1 - rotated;
+                }
+            }
+            stageTwiddles += 2 * m;
+        }
+    }
+
+    // Stockham autosort, decimation in time: input j + r * (length / radix) goes, twiddled, into
+    // the butterfly whose outputs land at (j / span) * span * radix + j % span + r * span.
+    // No bit reversal, the output of the last stage is in natural order
+    void FFTPlan::ExecuteMixedRadix(Complex* data, Complex* scratch) const
+    {
+        const Complex* in = data;
+        Complex* out = scratch;
+        Complex* v = scratch + length;
+        Complex* sums = v + maxRadix;
+        // -+i and the radix-3 constant -+i sqrt(3) / 2 for the specialised butterflies
+        double rotation = isInverse ? 1.0 : -1.0;
+        double sin60 = rotation * sqrt(3.0) / 2.0;
+
+        for (const Stage& stage : stages) {
+            int radix = stage.radix;
+            int span = stage.span;
+            int groups = length / radix;
+            const Complex* stageRoots = roots.data() + stage.rootOffset;
+            for (int j = 0; j < groups; ++j) {
+                int k = j % span;
+                const Complex* w = twiddles.data() + stage.twiddleOffset + (size_t)k * (radix - 1);
+                v[0] = in[j];
+                for (int r = 1; r < radix; ++r) v[r] = in[j + r * groups] * w[r - 1];
+
+                Complex* y = out + (j / span) * span * radix + k;
+                if (radix == 2) {
+                    y[0] = v[0] + v[1];
+                    y[span] = v[0] - v[1];
+                }
+                else if (radix == 3) {
+                    Complex t1 = v[1] + v[2];
+                    Complex t2 = v[0] - t1 * 0.5;
+                    Complex d = v[1] - v[2];
+                    Complex t3 = { -sin60 * d.imag, sin60 * d.real };
+                    y[0] = v[0] + t1;
+                    y[span] = t2 + t3;
+                    y[2 * span] = t2 - t3;
+                }
+                else if (radix == 4) {
+                    Complex t0 = v[0] + v[2];
+                    Complex t1 = v[0] - v[2];
+                    Complex t2 = v[1] + v[3];
+                    Complex d = v[1] - v[3];
+                    Complex t3 = { -rotation * d.imag, rotation * d.real };
+                    y[0] = t0 + t2;
+                    y[span] = t1 + t3;
+                    y[2 * span] = t0 - t2;
+                    y[3 * span] = t1 - t3;
+                }
+                else {
+                    for (int s = 0; s < radix; ++s) {
+                        Complex sum = v[0];
+                        for (int r = 1; r < radix; ++r) sum = sum + v[r] * stageRoots[(r * s) % radix];
+                        sums[s] = sum;
+                    }
+                    for (int s = 0; s < radix; ++s) y[s * span] = sums[s];
+                }
+            }
+            in = out;
+            out = (out == scratch) ? data : scratch;
+        }
+        if (in != data) std::copy(in, in + length, data);
+    }
+
+    // X[k] = c[k] * sum_n (x[n] c[n]) conj(c[k - n]) with c[n] = e^(-+pi i n^2 / N), since
+    // nk = (n^2 + k^2 - (k - n)^2) / 2. The convolution is circular over the padded length.
+    // The inverse convolution transform is the forward one on conjugates: IFFT(z) = conj(FFT(conj z)) / M,
+    // the 1 / M is folded into chirpSpectrum
+    void FFTPlan::ExecuteBluestein(Complex* data, Complex* scratch) const
+    {
+        int padded = static_cast<int>(chirpSpectrum.size());
+        for (int n = 0; n < length; ++n) scratch[n] = data[n] * chirp[n];
+        std::fill(scratch + length, scratch + padded, Complex{ 0.0, 0.0 });
+
+        convolutionPlan->ExecuteRadix4(scratch);
+        for (int k = 0; k < padded; ++k) {
+            Complex product = scratch[k] * chirpSpectrum[k];
+            scratch[k] = { product.real, -product.imag };
+        }
+        convolutionPlan->ExecuteRadix4(scratch);
+
+        for (int k = 0; k < length; ++k) data[k] = Complex{ scratch[k].real, -scratch[k].imag } * chirp[k];
+    }
+
+    const FFTPlan& GetFFTPlan(int length, bool isInverse)
+    {
+        // plans are never evicted: one per (length, direction) the application has seen, a few KB each
+        static std::mutex cacheMutex;
+        static std::map<std::pair<int, bool>, std::unique_ptr<FFTPlan>> cache;
+
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        std::unique_ptr<FFTPlan>& plan = cache[std::make_pair(length, isInverse)];
+        if (!plan) plan.reset(new FFTPlan(length, isInverse));
+        return *plan;
+    }
+
+    FFTBatchPlan::FFTBatchPlan(const FFTPlan& plan)
+        : length(plan.length), isInverse(plan.isInverse), isRadix4(plan.algorithm == FFTPlan::Algorithm::Radix4),
+        hasRadix2Stage(plan.hasRadix2Stage), swaps(plan.swaps), maxRadix(plan.maxRadix)
+    {
+        for (const Complex& twiddle : plan.twiddles) {
+            twiddleReal.push_back(static_cast<float>(twiddle.real));
+            twiddleImag.push_back(static_cast<float>(twiddle.imag));
+        }
+        for (const FFTPlan::Stage& stage : plan.stages) {
+            stages.push_back({ stage.radix, stage.span, stage.twiddleOffset, stage.rootOffset });
+        }
+        for (const Complex& root : plan.roots) {
+            rootReal.push_back(static_cast<float>(root.real));
+            rootImag.push_back(static_cast<float>(root.imag));
+        }
+    }
+
+    // real and imaginary ping-pong arrays, then the twiddled butterfly inputs
+    int FFTBatchPlan::ScratchLength() const
+    {
+        return isRadix4 ? 0 : 2 * FFTBatchLanes * (length + maxRadix);
+    }
+
+    void FFTBatchPlan::Execute(float* real, float* imag, float* scratch) const
+    {
+        ActiveSimdKernels().FFTBatch(*this, real, imag, scratch);
+    }
+
+    const FFTBatchPlan* GetFFTBatchPlan(int length, bool isInverse)
+    {
+        static std::mutex cacheMutex;
+        static std::map<std::pair<int, bool>, std::unique_ptr<FFTBatchPlan>> cache;
+
+        const FFTPlan& plan = GetFFTPlan(length, isInverse);
+        if (plan.UsesBluestein()) return nullptr;
+
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        std::unique_ptr<FFTBatchPlan>& batchPlan = cache[std::make_pair(length, isInverse)];
+        if (!batchPlan) batchPlan.reset(new FFTBatchPlan(plan));
+        return batchPlan.get();
+    }
+
+    double EstimateFFTCost(int length)
+    {
+        if (length <= 1) return 0.0;
+        if (IsPowerOfTwo(length)) return MixedRadixCost(length);
+        return std::min(MixedRadixCost(length), BluesteinCost(length));
+    }
+
+    int ChooseFFTLength(int minimumLength)
+    {
+        if (minimumLength <= 1) return 1;
+        int smooth = minimumLength;
+        for (;; ++smooth) {
+            int rest = smooth;
+            for (int factor : { 2, 3, 5, 7 }) {
+                while (rest % factor == 0) rest /= factor;
+            }
+            if (rest == 1) break;
+        }
+
+        int best = minimumLength;
+        for (int candidate : { smooth, NextPowerOfTwo(minimumLength) }) {
+            if (EstimateFFTCost(candidate) < EstimateFFTCost(best)) best = candidate;
+        }
+        return best;
+    }
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "ImageProcessingUtils.h"
+#include <memory>
+#include <vector>
+
+namespace ImaGyNative
+{
+    // In-place 1-D transform of any length in one direction, everything that depends only on those is
+    // computed once. The inverse scales by 1 / length. Three algorithms, chosen by length:
+    //  - powers of two: bit-reversal swaps, then radix-4 stages (radix-2^2: 3 complex multiplies per
+    //    4 points), plus one radix-2 stage when log2(length) is odd
+    //  - other lengths: mixed-radix Stockham stages over the factors (4, 2, 3 specialised, 5, 7 and any
+    //    other prime through a small DFT), ping-ponging with the scratch buffer
+    //  - lengths whose prime factors make that slow: Bluestein, a circular convolution with a chirp
+    //    through a power-of-two transform of at least 2 * length - 1 points
+    // Twiddles are stored contiguously in the order the butterflies read them.
+    // Execute is const and may run on many rows from many threads at once, each with its own scratch
+    class FFTPlan
+    {
+    public:
+        FFTPlan(int length, bool isInverse);
+
+        int Length() const { return length; }
+        bool IsInverse() const { return isInverse; }
+        bool UsesBluestein() const { return algorithm == Algorithm::Bluestein; }
+
+        // Complex elements Execute needs as scratch, 0 for powers of two
+        int ScratchLength() const;
+
+        void Execute(Complex* data, Complex* scratch) const;
+        // Allocates the scratch itself: prefer the overload above in loops
+        void Execute(Complex* data) const;
+
+    private:
+        friend class FFTBatchPlan;
+
+        enum class Algorithm { Radix4, MixedRadix, Bluestein };
+        struct Stage {
+            int radix;
+            int span;              // product of the radices of the earlier stages
+            size_t twiddleOffset;  // span * (radix - 1) twiddles: e^(-+2 pi i k r / (span * radix)), k < span, 1 <= r < radix
+            size_t rootOffset;     // radix roots of unity for the generic butterfly
+        };
+
+        void ExecuteRadix4(Complex* data) const;
+        void ExecuteMixedRadix(Complex* data, Complex* scratch) const;
+        void ExecuteBluestein(Complex* data, Complex* scratch) const;
+
+        int length;
+        bool isInverse;
+        Algorithm algorithm;
+
+        bool hasRadix2Stage;
+        std::vector<int> swaps;         // index pairs (i, j), i < j
+        std::vector<Complex> twiddles;  // radix-4: (w^2j, w^j) for j < m per stage of quarter size m, w = e^(-+2 pi i / 4m)
+
+        std::vector<Stage> stages;
+        std::vector<Complex> roots;
+        int maxRadix;
+
+        std::vector<Complex> chirp;          // e^(-+pi i n^2 / length)
+        std::vector<Complex> chirpSpectrum;  // forward transform of the conjugate chirp, divided by its length
+        std::unique_ptr<FFTPlan> convolutionPlan;
+    };
+
+    // Shared plan, built on first use and kept for the process lifetime
+    const FFTPlan& GetFFTPlan(int length, bool isInverse);
+
+    // Sequences one FFTBatchPlan transforms at once: one AVX2 register of floats
+    const int FFTBatchLanes = 8;
+
+    // Single precision FFTPlan for FFTBatchLanes sequences at once, for outputs where double buys
+    // nothing (8-bit visualisations). Split real / imaginary arrays, element n of sequence s at
+    // [n * FFTBatchLanes + s], so every butterfly operand is one vector and each twiddle one broadcast:
+    // the same stages and twiddles as the FFTPlan, rounded to float, run by SimdKernelTable::FFTBatch.
+    // Radix-4 and mixed-radix lengths only, Bluestein lengths stay on the double plan
+    class FFTBatchPlan
+    {
+    public:
+        explicit FFTBatchPlan(const FFTPlan& plan);
+
+        int Length() const { return length; }
+        bool IsInverse() const { return isInverse; }
+
+        // Floats Execute needs as scratch, 0 for powers of two
+        int ScratchLength() const;
+
+        void Execute(float* real, float* imag, float* scratch) const;
+
+        // Read by the SIMD kernels, same meaning as in FFTPlan
+        struct Stage {
+            int radix;
+            int span;
+            size_t twiddleOffset;
+            size_t rootOffset;
+        };
+
+        int length;
+        bool isInverse;
+        bool isRadix4;
+        bool hasRadix2Stage;
+        std::vector<int> swaps;
+        std::vector<float> twiddleReal;
+        std::vector<float> twiddleImag;
+        std::vector<Stage> stages;
+        std::vector<float> rootReal;
+        std::vector<float> rootImag;
+        int maxRadix;
+    };
+
+    // Shared batch plan like GetFFTPlan, nullptr for lengths the double plan runs through Bluestein
+    const FFTBatchPlan* GetFFTBatchPlan(int length, bool isInverse);
+
+    // Relative cost of one transform of `length` points by the algorithm FFTPlan picks for it
+    double EstimateFFTCost(int length);
+
+    // Cheapest length >= minimumLength by EstimateFFTCost, for transforms that may be zero padded
+    // (convolution, correlation). Candidates are minimumLength itself, the next 2-3-5-7 smooth length
+    // and the next power of two, so padding is only used when it is actually cheaper
+    int ChooseFFTLength(int minimumLength);
+}
@@ -0,0 +1,153 @@
+#include "pch.h"
+#include "FrequencyMask.h"
+#include <algorithm>
+#include <cmath>
+#include <list>
+#include <mutex>
+
+namespace ImaGyNative
+{
+    static const size_t FrequencyMaskCacheBytes = 128u << 20;
+
+    // Offset of frequency index `index` from DC as FFT_Shift2D lays it out (DC at size / 2)
+    static int CenteredFrequency(int index, int size)
+    {
+        return (index + size / 2) % size - size / 2;
+    }
+
+    // 1 / (1 + x^n), the Butterworth response for x = (D / D0)^2 or its inverse
+    static double ButterworthResponse(double ratioSquared, int order)
+    {
+        return 1.0 / (1.0 + std::pow(ratioSquared, order));
+    }
+
+    // Notch reject at every centre and its mirror: the product of Butterworth high-passes
+    // around each of them
+    static double NotchResponse(double dx, double dy, const FrequencyMaskParams& params, int order)
+    {
+        double cutoffSquared = params.cutoff * params.cutoff;
+        double response = 1.0;
+        for (size_t i = 0; i + 1 < params.notches.size(); i += 2) {
+            for (double side : { 1.0, -1.0 }) {
+                double ex = dx - side * params.notches[i];
+                double ey = dy - side * params.notches[i + 1];
+                double distanceSquared = ex * ex + ey * ey;
+                response *= (distanceSquared > 0) ? ButterworthResponse(cutoffSquared / distanceSquared, order) : 0.0;
+            }
+        }
+        return response;
+    }
+
+    static double MaskValue(double dx, double dy, const FrequencyMaskParams& params)
+    {
+        int order = std::max(params.order, 1);
+        double distanceSquared = dx * dx + dy * dy;
+        double cutoffSquared = params.cutoff * params.cutoff;
+        switch (params.type) {
+        case FrequencyMaskType::IdealLowPass:
+            return distanceSquared <= cutoffSquared ? 1.0 : 0.0;
+        case FrequencyMaskType::IdealHighPass:
+            return distanceSquared > cutoffSquared ? 1.0 : 0.0;
+        case FrequencyMaskType::ButterworthLowPass:
+            if (cutoffSquared <= 0) return distanceSquared > 0 ? 0.0 : 1.0;
+            return ButterworthResponse(distanceSquared / cutoffSquared, order);
+        case FrequencyMaskType::ButterworthHighPass:
+            if (distanceSquared <= 0) return 0.0;
+            return ButterworthResponse(cutoffSquared / distanceSquared, order);
+        case FrequencyMaskType::GaussianLowPass:
+            if (cutoffSquared <= 0) return distanceSquared > 0 ? 0.0 : 1.0;
+            return std::exp(-distanceSquared / (2.0 * cutoffSquared));
+        case FrequencyMaskType::GaussianHighPass:
+            if (cutoffSquared <= 0) return distanceSquared > 0 ? 1.0 : 0.0;
+            return 1.0 - std::exp(-distanceSquared / (2.0 * cutoffSquared));
+        case FrequencyMaskType::BandPass:
+        case FrequencyMaskType::BandStop: {
+            // Butterworth band reject 1 / (1 + (D W / (D^2 - D0^2))^2n), exactly 0 on the ring
+            double offRing = distanceSquared - cutoffSquared;
+            double stop = (offRing == 0.0) ? 0.0
+                : ButterworthResponse(distanceSquared * params.bandwidth * params.bandwidth / (offRing * offRing), order);
+            return params.type == FrequencyMaskType::BandStop ? stop : 1.0 - stop;
+        }
+        case FrequencyMaskType::Notch:
+            return NotchResponse(dx, dy, params, order);
+        default:
+            return 1.0;
+        }
+    }
+
+    static void BuildFrequencyMask(int width, int height, const FrequencyMaskParams& params, std::vector<float>& mask)
+    {
+        int halfWidth = HalfSpectrumWidth(width);
+        mask.resize((size_t)halfWidth * height);
+#pragma omp parallel for
+        for (int u = 0; u < halfWidth; ++u) {
+            int dx = CenteredFrequency(u, width);
+            float* column = &mask[(size_t)u * height];
+            for (int v = 0; v < height; ++v) {
+                column[v] = static_cast<float>(MaskValue(dx, CenteredFrequency(v, height), params));
+            }
+        }
+    }
+
+    // Everything the mask depends on, compared by value
+    static std::vector<double> MaskKey(int width, int height, const FrequencyMaskParams& params)
+    {
+        std::vector<double> key = { (double)width, (double)height, (double)static_cast<int>(params.type),
+            params.cutoff, params.bandwidth, (double)std::max(params.order, 1) };
+        if (params.type == FrequencyMaskType::Notch) key.insert(key.end(), params.notches.begin(), params.notches.end());
+        return key;
+    }
+
+    struct FrequencyMaskEntry {
+        std::vector<double> key;
+        std::shared_ptr<const std::vector<float>> mask;
+    };
+
+    static std::mutex cacheMutex;
+    static std::list<FrequencyMaskEntry> cacheEntries; // most recently used first
+
+    std::shared_ptr<const std::vector<float>> GetFrequencyMask(int width, int height, const FrequencyMaskParams& params)
+    {
+        std::vector<double> key = MaskKey(width, height, params);
+        {
+            std::lock_guard<std::mutex> lock(cacheMutex);
+            for (auto entry = cacheEntries.begin(); entry != cacheEntries.end(); ++entry) {
+                if (entry->key == key) {
+                    cacheEntries.splice(cacheEntries.begin(), cacheEntries, entry);
+                    return entry->mask;
+                }
+            }
+        }
+
+        std::shared_ptr<std::vector<float>> mask = std::make_shared<std::vector<float>>();
+        BuildFrequencyMask(width, height, params, *mask);
+
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        cacheEntries.push_front({ key, mask });
+        size_t totalBytes = 0;
+        for (const FrequencyMaskEntry& entry : cacheEntries) totalBytes += entry.mask->size() * sizeof(float);
+        while (cacheEntries.size() > 1 && totalBytes > FrequencyMaskCacheBytes) {
+            totalBytes -= cacheEntries.back().mask->size() * sizeof(float);
+            cacheEntries.pop_back();
+        }
+        return mask;
+    }
+
+    void MultiplyFrequencyMask(const Complex* source, const float* mask, int count, Complex* dest)
+    {
+        const double* sourceValues = reinterpret_cast<const double*>(source);
+        double* destValues = reinterpret_cast<double*>(dest);
+#pragma omp parallel for
+        for (int i = 0; i < count; ++i) {
+            double weight = mask[i];
+            destValues[2 * (size_t)i] = sourceValues[2 * (size_t)i] * weight;
+            destValues[2 * (size_t)i + 1] = sourceValues[2 * (size_t)i + 1] * weight;
+        }
+    }
+
+    void ClearFrequencyMaskCache()
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        cacheEntries.clear();
+    }
+}
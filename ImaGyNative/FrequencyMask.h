@@ -0,0 +1,42 @@
+#pragma once
+
+#include "ImageProcessingUtils.h"
+#include <memory>
+#include <vector>
+
+namespace ImaGyNative
+{
+    // Codes used by NativeCore::ApplyFrequencyMaskFilter
+    enum class FrequencyMaskType {
+        IdealLowPass = 0,
+        IdealHighPass = 1,
+        ButterworthLowPass = 2,
+        ButterworthHighPass = 3,
+        GaussianLowPass = 4,
+        GaussianHighPass = 5,
+        BandPass = 6,   // Butterworth ring
+        BandStop = 7,
+        Notch = 8       // Butterworth notch reject at each centre and its mirror
+    };
+
+    // Distances are in frequency units, i.e. pixels of the shifted spectrum image (DC at width / 2, height / 2)
+    struct FrequencyMaskParams {
+        FrequencyMaskType type;
+        double cutoff;               // D0: radius of the pass / stop types, ring radius of the bands, radius of each notch
+        double bandwidth;            // W: ring width of BandPass / BandStop
+        int order;                   // n of the Butterworth forms, values below 1 are taken as 1
+        std::vector<double> notches; // Notch: (du, dv) offsets of the centres from DC
+    };
+
+    // Mask of a width x height image in the half-spectrum transposed layout, mask[u * height + v]
+    // (SpectrumLayout::Transposed). Every mask depends on the distance from DC or is symmetric about it,
+    // so mask(u, v) == mask(-u, -v) and a masked real spectrum stays Hermitian.
+    // Built once per (size, parameters) and shared; least recently used masks are dropped beyond 128 MB
+    std::shared_ptr<const std::vector<float>> GetFrequencyMask(int width, int height, const FrequencyMaskParams& params);
+
+    // dest[i] = source[i] * mask[i] for i < count, the masking pass of the frequency filters
+    void MultiplyFrequencyMask(const Complex* source, const float* mask, int count, Complex* dest);
+
+    // Releases every cached mask
+    void ClearFrequencyMaskCache();
+}
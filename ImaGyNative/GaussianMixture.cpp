@@ -0,0 +1,326 @@
+#include "pch.h"
+#include "GaussianMixture.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <omp.h>
+
+namespace ImaGyNative
+{
+    static const double GmmTolerance = 1e-7;
+    static const double VarianceFloor = 1.0;
+    static const double LogTwoPi = 1.8378770664093453;
+    // log of a zero weight, finite so that differences of it stay finite
+    static const double LogZero = -1e300;
+    // Lloyd iterations of the k-means starts, and the number of EM starts tried for a histogram
+    static const int IntensitySeedIterations = 20;
+    static const int IntensityRestarts = 8;
+    static const int ColorSeedIterations = 10;
+
+    static double LogWeight(double weight)
+    {
+        return weight > 0.0 ? std::log(weight) : LogZero;
+    }
+
+    // Turns log weighted densities into responsibilities in place; returns log sum of the densities
+    static double NormaliseResponsibilities(double* values, int k)
+    {
+        double largest = *std::max_element(values, values + k);
+        double sum = 0.0;
+        for (int c = 0; c < k; ++c) {
+            values[c] = std::exp(values[c] - largest);
+            sum += values[c];
+        }
+        for (int c = 0; c < k; ++c) values[c] /= sum;
+        return largest + std::log(sum);
+    }
+
+    static double IntensityLogDensity(const IntensityGaussian& component, double value)
+    {
+        double diff = value - component.mean;
+        return LogWeight(component.weight) - 0.5 * (LogTwoPi + std::log(component.variance) + diff * diff / component.variance);
+    }
+
+    // Start from weighted k-means on the occupied intensities: each cluster's mass, mean and variance
+    static void SeedIntensityGmm(const unsigned int* histogram, int k, unsigned int seed, std::vector<IntensityGaussian>& components)
+    {
+        std::vector<unsigned char> values;
+        std::vector<float> counts;
+        for (int v = 0; v < 256; ++v) {
+            if (histogram[v] == 0) continue;
+            values.push_back(static_cast<unsigned char>(v));
+            counts.push_back(static_cast<float>(histogram[v]));
+        }
+        KMeansPoints points = { 1, static_cast<int>(values.size()), { values.data() }, counts.data() };
+        std::vector<float> centroids;
+        std::vector<unsigned char> labels;
+        RunKMeans(points, k, IntensitySeedIterations, seed, centroids, labels);
+
+        std::vector<double> sums((size_t)k * 3, 0.0);
+        double total = 0.0;
+        for (int j = 0; j < points.count; ++j) {
+            double* clusterSums = &sums[(size_t)labels[j] * 3];
+            clusterSums[0] += counts[j];
+            clusterSums[1] += (double)counts[j] * values[j];
+            clusterSums[2] += (double)counts[j] * values[j] * values[j];
+            total += counts[j];
+        }
+        components.resize(k);
+        for (int c = 0; c < k; ++c) {
+            const double* clusterSums = &sums[(size_t)c * 3];
+            if (clusterSums[0] <= 0.0) {
+                components[c] = { 0.0, (double)centroids[c], VarianceFloor };
+                continue;
+            }
+            double mean = clusterSums[1] / clusterSums[0];
+            components[c] = { clusterSums[0] / total, mean, std::max(clusterSums[2] / clusterSums[0] - mean * mean, VarianceFloor) };
+        }
+    }
+
+    // EM from the given start; returns the mean log-likelihood per pixel of the last E-step
+    static double RunIntensityEm(const unsigned int* histogram, double total, int maxIterations, std::vector<IntensityGaussian>& components)
+    {
+        int k = static_cast<int>(components.size());
+        std::vector<double> responsibilities(k);
+        std::vector<double> sums((size_t)k * 3); // weight, sum v, sum v^2 per component
+        double previous = -DBL_MAX;
+        double logLikelihood = -DBL_MAX;
+        for (int iteration = 0; iteration < maxIterations; ++iteration) {
+            std::fill(sums.begin(), sums.end(), 0.0);
+            logLikelihood = 0.0;
+            for (int v = 0; v < 256; ++v) {
+                if (histogram[v] == 0) continue;
+                double count = histogram[v];
+                for (int c = 0; c < k; ++c) responsibilities[c] = IntensityLogDensity(components[c], v);
+                logLikelihood += count * NormaliseResponsibilities(responsibilities.data(), k);
+                for (int c = 0; c < k; ++c) {
+                    double share = count * responsibilities[c];
+                    sums[(size_t)c * 3] += share;
+                    sums[(size_t)c * 3 + 1] += share * v;
+                    sums[(size_t)c * 3 + 2] += share * v * v;
+                }
+            }
+
+            for (int c = 0; c < k; ++c) {
+                const double* componentSums = &sums[(size_t)c * 3];
+                components[c].weight = componentSums[0] / total;
+                if (componentSums[0] <= 0.0) continue;
+                double mean = componentSums[1] / componentSums[0];
+                components[c].mean = mean;
+                components[c].variance = std::max(componentSums[2] / componentSums[0] - mean * mean, VarianceFloor);
+            }
+
+            logLikelihood /= total;
+            if (std::fabs(logLikelihood - previous) < GmmTolerance) break;
+            previous = logLikelihood;
+        }
+        return logLikelihood;
+    }
+
+    void FitIntensityGmm(const unsigned int* histogram, int k, int maxIterations, std::vector<IntensityGaussian>& components)
+    {
+        components.clear();
+        double total = 0.0;
+        int occupiedCount = 0;
+        for (int v = 0; v < 256; ++v) {
+            total += histogram[v];
+            occupiedCount += histogram[v] > 0;
+        }
+        if (total <= 0.0) return;
+        k = std::max(1, std::min(k, occupiedCount));
+
+        // restarts are cheap at O(256 k) per iteration, keep the most likely fit
+        double bestLikelihood = -DBL_MAX;
+        std::vector<IntensityGaussian> candidate;
+        for (int restart = 0; restart < IntensityRestarts; ++restart) {
+            SeedIntensityGmm(histogram, k, restart, candidate);
+            double likelihood = RunIntensityEm(histogram, total, maxIterations, candidate);
+            if (likelihood > bestLikelihood) {
+                bestLikelihood = likelihood;
+                components = candidate;
+            }
+        }
+    }
+
+    void IntensityGmmLabels(const std::vector<IntensityGaussian>& components, unsigned char* lut)
+    {
+        for (int v = 0; v < 256; ++v) {
+            int best = 0;
+            double bestDensity = -DBL_MAX;
+            for (int c = 0; c < (int)components.size(); ++c) {
+                double density = IntensityLogDensity(components[c], v);
+                if (density > bestDensity) {
+                    bestDensity = density;
+                    best = c;
+                }
+            }
+            lut[v] = static_cast<unsigned char>(best);
+        }
+    }
+
+    // Inverse and log scale of a component from its covariance and weight
+    static void UpdateColorScale(ColorGaussian& component)
+    {
+        const double (*a)[3] = component.covariance;
+        double (*inverse)[3] = component.inverse;
+        inverse[0][0] = a[1][1] * a[2][2] - a[1][2] * a[2][1];
+        inverse[0][1] = a[0][2] * a[2][1] - a[0][1] * a[2][2];
+        inverse[0][2] = a[0][1] * a[1][2] - a[0][2] * a[1][1];
+        inverse[1][0] = a[1][2] * a[2][0] - a[1][0] * a[2][2];
+        inverse[1][1] = a[0][0] * a[2][2] - a[0][2] * a[2][0];
+        inverse[1][2] = a[0][2] * a[1][0] - a[0][0] * a[1][2];
+        inverse[2][0] = a[1][0] * a[2][1] - a[1][1] * a[2][0];
+        inverse[2][1] = a[0][1] * a[2][0] - a[0][0] * a[2][1];
+        inverse[2][2] = a[0][0] * a[1][1] - a[0][1] * a[1][0];
+        // positive definite: the diagonal is at least VarianceFloor
+        double determinant = a[0][0] * inverse[0][0] + a[0][1] * inverse[1][0] + a[0][2] * inverse[2][0];
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 3; ++j) inverse[i][j] /= determinant;
+        }
+        component.logScale = LogWeight(component.weight) - 0.5 * (3.0 * LogTwoPi + std::log(determinant));
+    }
+
+    static double ColorLogDensity(const ColorGaussian& component, const double* x)
+    {
+        double diff[3] = { x[0] - component.mean[0], x[1] - component.mean[1], x[2] - component.mean[2] };
+        double distance = 0.0;
+        for (int i = 0; i < 3; ++i) {
+            distance += diff[i] * (component.inverse[i][0] * diff[0] + component.inverse[i][1] * diff[1] + component.inverse[i][2] * diff[2]);
+        }
+        return component.logScale - 0.5 * distance;
+    }
+
+    int MostLikelyColorComponent(const std::vector<ColorGaussian>& components, const double* x)
+    {
+        int best = 0;
+        double bestDensity = -DBL_MAX;
+        for (int c = 0; c < (int)components.size(); ++c) {
+            double density = ColorLogDensity(components[c], x);
+            if (density > bestDensity) {
+                bestDensity = density;
+                best = c;
+            }
+        }
+        return best;
+    }
+
+    // Per component: weight, 3 weighted sums, 6 weighted products (upper triangle)
+    static const int ColorSumsLength = 10;
+
+    static void AddColorPoint(const double* x, double weight, double* sums)
+    {
+        sums[0] += weight;
+        for (int i = 0; i < 3; ++i) sums[1 + i] += weight * x[i];
+        int product = 4;
+        for (int i = 0; i < 3; ++i) {
+            for (int j = i; j < 3; ++j) sums[product++] += weight * x[i] * x[j];
+        }
+    }
+
+    static void LoadColorPoint(const KMeansPoints& points, int i, double* x)
+    {
+        for (int d = 0; d < 3; ++d) x[d] = points.planes[d][i];
+    }
+
+    static void MaximiseColorGmm(const std::vector<double>& sums, double total, std::vector<ColorGaussian>& components)
+    {
+        for (int c = 0; c < (int)components.size(); ++c) {
+            ColorGaussian& component = components[c];
+            const double* componentSums = &sums[(size_t)c * ColorSumsLength];
+            component.weight = componentSums[0] / total;
+            if (componentSums[0] > 0.0) {
+                for (int i = 0; i < 3; ++i) component.mean[i] = componentSums[1 + i] / componentSums[0];
+                int product = 4;
+                for (int i = 0; i < 3; ++i) {
+                    for (int j = i; j < 3; ++j) {
+                        double value = componentSums[product++] / componentSums[0] - component.mean[i] * component.mean[j];
+                        component.covariance[i][j] = component.covariance[j][i] = value;
+                    }
+                    component.covariance[i][i] = std::max(component.covariance[i][i], 0.0) + VarianceFloor;
+                }
+            }
+            UpdateColorScale(component);
+        }
+    }
+
+    static void MergeColorSums(std::vector<std::vector<double>>& threadSums, std::vector<double>& sums)
+    {
+        std::fill(sums.begin(), sums.end(), 0.0);
+        for (std::vector<double>& partial : threadSums) {
+            for (size_t j = 0; j < sums.size(); ++j) sums[j] += partial[j];
+            std::fill(partial.begin(), partial.end(), 0.0);
+        }
+    }
+
+    void FitColorGmm(const KMeansPoints& points, int k, int maxIterations, unsigned int seed, std::vector<ColorGaussian>& components)
+    {
+        components.clear();
+        int count = points.count;
+        if (count <= 0) return;
+
+        std::vector<float> centroids;
+        std::vector<unsigned char> labels;
+        RunKMeans(points, k, ColorSeedIterations, seed, centroids, labels);
+        k = static_cast<int>(centroids.size() / 3);
+        // a cluster k-means left empty keeps its centroid and the floor covariance
+        components.assign(k, ColorGaussian());
+        for (int c = 0; c < k; ++c) {
+            for (int i = 0; i < 3; ++i) {
+                components[c].mean[i] = centroids[(size_t)c * 3 + i];
+                for (int j = 0; j < 3; ++j) components[c].covariance[i][j] = (i == j) ? VarianceFloor : 0.0;
+            }
+        }
+
+        size_t sumsLength = (size_t)k * ColorSumsLength;
+        std::vector<double> sums(sumsLength);
+        std::vector<std::vector<double>> threadSums(omp_get_max_threads(), std::vector<double>(sumsLength, 0.0));
+        double total = 0.0;
+
+        // M-step from the hard k-means assignment
+#pragma omp parallel reduction(+:total)
+        {
+            double* partial = threadSums[omp_get_thread_num()].data();
+#pragma omp for
+            for (int i = 0; i < count; ++i) {
+                double x[3];
+                LoadColorPoint(points, i, x);
+                double weight = points.weights ? points.weights[i] : 1.0;
+                AddColorPoint(x, weight, partial + (size_t)labels[i] * ColorSumsLength);
+                total += weight;
+            }
+        }
+        MergeColorSums(threadSums, sums);
+        if (total <= 0.0) {
+            components.clear();
+            return;
+        }
+        MaximiseColorGmm(sums, total, components);
+
+        double previous = -DBL_MAX;
+        for (int iteration = 0; iteration < maxIterations; ++iteration) {
+            double logLikelihood = 0.0;
+#pragma omp parallel reduction(+:logLikelihood)
+            {
+                double* partial = threadSums[omp_get_thread_num()].data();
+                std::vector<double> responsibilities(k);
+#pragma omp for
+                for (int i = 0; i < count; ++i) {
+                    double x[3];
+                    LoadColorPoint(points, i, x);
+                    double weight = points.weights ? points.weights[i] : 1.0;
+                    for (int c = 0; c < k; ++c) responsibilities[c] = ColorLogDensity(components[c], x);
+                    logLikelihood += weight * NormaliseResponsibilities(responsibilities.data(), k);
+                    for (int c = 0; c < k; ++c) {
+                        if (responsibilities[c] > 0.0) AddColorPoint(x, weight * responsibilities[c], partial + (size_t)c * ColorSumsLength);
+                    }
+                }
+            }
+            MergeColorSums(threadSums, sums);
+            MaximiseColorGmm(sums, total, components);
+
+            logLikelihood /= total;
+            if (std::fabs(logLikelihood - previous) < GmmTolerance) break;
+            previous = logLikelihood;
+        }
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "KMeans.h"
+#include <vector>
+
+namespace ImaGyNative
+{
+    struct IntensityGaussian {
+        double weight;
+        double mean;
+        double variance;
+    };
+
+    // EM for a mixture of k 1-D Gaussians fitted to a 256-bin intensity histogram: each iteration is
+    // O(256 k) whatever the image size. Each run stops after maxIterations or when the mean
+    // log-likelihood per pixel changes by less than 1e-7; the best of several runs from fixed-seed
+    // weighted k-means starts is kept, so the result is deterministic.
+    // k is clamped to [1, number of occupied bins]
+    void FitIntensityGmm(const unsigned int* histogram, int k, int maxIterations, std::vector<IntensityGaussian>& components);
+
+    // Most probable component of every intensity, lut[v] for v in 0..255
+    void IntensityGmmLabels(const std::vector<IntensityGaussian>& components, unsigned char* lut);
+
+    struct ColorGaussian {
+        double weight;
+        double mean[3];
+        double covariance[3][3];
+        double inverse[3][3];
+        double logScale; // log(weight) - log((2 pi)^(3/2) sqrt(det covariance))
+    };
+
+    // EM for a mixture of k full-covariance Gaussians over 3-feature points (dimensions must be 3).
+    // Initialised from RunKMeans on the same points; E and M sums are accumulated per thread and
+    // merged after each pass. Covariances get 1 added to the diagonal, the variance floor of byte data.
+    // Stops as FitIntensityGmm does. k is clamped as RunKMeans clamps it
+    void FitColorGmm(const KMeansPoints& points, int k, int maxIterations, unsigned int seed, std::vector<ColorGaussian>& components);
+
+    // Index of the component with the largest weighted density at x
+    int MostLikelyColorComponent(const std::vector<ColorGaussian>& components, const double* x);
+}
@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "ImageProcessingUtils.h"
+#include "FFTPlan.h"
 #include <cmath>
 #include <iostream>
 #include <vector>
@@ -9,6 +10,7 @@
 #include <algorithm>
 #include <memory>    // std::unique_ptr 
 #include <omp.h>     // OpenMP to CPU Parallel
+#include <emmintrin.h>
 #include <stdexcept> // std::invalid_argument exception 
 
 const double PI = acos(-1); // math pi use
@@ -122,6 +124,132 @@ namespace ImaGyNative
         return kernel;
     }
 
+    // Rank-1 test for a square kernel: kernel[y][x] == columnKernel[y] * rowKernel[x]
+    // Square Gaussian/Average and 3x3 Sobel pass, circular kernels and Laplacian fail
+    bool SeparateKernel(const std::vector<double>& kernel, int kernelSize, std::vector<double>& rowKernel, std::vector<double>& columnKernel)
+    {
+        if (kernelSize <= 0 || kernel.size() != (size_t)kernelSize * kernelSize) return false;
+
+        // pivot on the largest element so the split is numerically stable
+        int pivotIndex = 0;
+        for (int i = 1; i < kernelSize * kernelSize; ++i) {
+            if (std::abs(kernel[i]) > std::abs(kernel[pivotIndex])) pivotIndex = i;
+        }
+        double pivot = kernel[pivotIndex];
+        if (pivot == 0.0) return false;
+
+        int pivotRow = pivotIndex / kernelSize;
+        int pivotCol = pivotIndex % kernelSize;
+        rowKernel.assign(kernelSize, 0.0);
+        columnKernel.assign(kernelSize, 0.0);
+        for (int i = 0; i < kernelSize; ++i) {
+            columnKernel[i] = kernel[i * kernelSize + pivotCol];
+            rowKernel[i] = kernel[pivotRow * kernelSize + i] / pivot;
+        }
+
+        const double tolerance = 1e-9 * std::abs(pivot);
+        for (int y = 0; y < kernelSize; ++y) {
+            for (int x = 0; x < kernelSize; ++x) {
+                if (std::abs(kernel[y * kernelSize + x] - columnKernel[y] * rowKernel[x]) > tolerance) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Picks the largest fractionBits <= 15 such that every weight fits a short and
+    // 255 * sum(|weight|) fits the int32 accumulator, then rounds the weights.
+    // The rounding error is spread one unit per tap over the taps that rounding moved furthest
+    // (largest remainder), so sum(weights) stays round(sum * 2^fractionBits), i.e. a flat image
+    // keeps its exact brightness, and no tap ends more than 1.5 units from its exact value.
+    // Fails (callers take the double path) if that would flip the sign of a tap or leave a short
+    bool QuantizeKernel(const std::vector<double>& kernel, int kernelSize, double scale, QuantizedKernel& quantized)
+    {
+        if (kernelSize <= 0 || kernel.size() != (size_t)kernelSize * kernelSize) return false;
+
+        double maxWeight = 0.0;
+        double absSum = 0.0;
+        double sum = 0.0;
+        for (int i = 0; i < kernelSize * kernelSize; ++i) {
+            double weight = kernel[i] * scale;
+            maxWeight = std::max(maxWeight, std::abs(weight));
+            absSum += std::abs(weight);
+            sum += weight;
+        }
+        if (maxWeight == 0.0) return false;
+
+        int fractionBits = 15;
+        while (fractionBits >= 0) {
+            double unit = std::ldexp(1.0, fractionBits);
+            if (maxWeight * unit <= 32767.0 && (absSum * unit + kernelSize * kernelSize) * 255.0 < 2147483647.0) break;
+            --fractionBits;
+        }
+        if (fractionBits < 0) return false;
+
+        double unit = std::ldexp(1.0, fractionBits);
+        quantized.kernelSize = kernelSize;
+        quantized.fractionBits = fractionBits;
+        quantized.weights.resize(kernel.size());
+        long long quantizedSum = 0;
+        std::vector<double> remainders(kernel.size());
+        std::vector<int> order;
+        for (int i = 0; i < kernelSize * kernelSize; ++i) {
+            double exact = kernel[i] * scale * unit;
+            quantized.weights[i] = static_cast<short>(std::lround(exact));
+            quantizedSum += quantized.weights[i];
+            remainders[i] = exact - quantized.weights[i];
+            // zero taps stay zero, the tap lists skip them
+            if (exact != 0.0) order.push_back(i);
+        }
+
+        long long correction = std::llround(sum * unit) - quantizedSum;
+        if (correction != 0) {
+            int step = correction > 0 ? 1 : -1;
+            // rounded down the most first when units are missing, rounded up the most when in excess
+            std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+                return step > 0 ? remainders[a] > remainders[b] : remainders[a] < remainders[b];
+            });
+            for (size_t j = 0; j < order.size() && correction != 0; ++j) {
+                int i = order[j];
+                int weight = quantized.weights[i] + step;
+                if (weight < -32768 || weight > 32767 || weight * kernel[i] * scale < 0) continue;
+                quantized.weights[i] = static_cast<short>(weight);
+                correction -= step;
+            }
+            if (correction != 0) return false;
+        }
+        for (int i = 0; i < kernelSize * kernelSize; ++i) {
+            if (quantized.weights[i] * kernel[i] * scale < 0) return false;
+        }
+        return true;
+    }
+
+    std::vector<QuantizedTapPair> BuildTapPairs(const QuantizedKernel& kernel, int pixelBytes)
+    {
+        int kernelSize = kernel.kernelSize;
+        int center = kernelSize / 2;
+        std::vector<QuantizedTapPair> pairs;
+        std::vector<int> columns;
+        for (int ky = 0; ky < kernelSize; ++ky) {
+            // zero taps (outside a circular kernel) are dropped here instead of tested per pixel
+            columns.clear();
+            for (int kx = 0; kx < kernelSize; ++kx) {
+                if (kernel.weights[ky * kernelSize + kx] != 0) columns.push_back(kx);
+            }
+            for (size_t i = 0; i < columns.size(); i += 2) {
+                bool hasSecond = i + 1 < columns.size();
+                int kx0 = columns[i];
+                int kx1 = hasSecond ? columns[i + 1] : kx0;
+                unsigned short weight0 = static_cast<unsigned short>(kernel.weights[ky * kernelSize + kx0]);
+                unsigned short weight1 = hasSecond ? static_cast<unsigned short>(kernel.weights[ky * kernelSize + kx1]) : 0;
+                pairs.push_back({ ky - center, (kx0 - center) * pixelBytes, (kx1 - center) * pixelBytes,
+                    static_cast<int>((static_cast<unsigned int>(weight1) << 16) | weight0) });
+            }
+        }
+        return pairs;
+    }
+
     int OtsuThreshold(const unsigned char* sourcePixels, int width, int height, int stride)
     {
         std::vector<int> hist(256, 0);
@@ -170,125 +298,300 @@ namespace ImaGyNative
         return threshold;
     }
 
+    // Kept for existing callers, both run the cached plan of FFTPlan.h
     void FFT_1D_Recursive(Complex* data, int N, bool isInverse) {
         if (N <= 1) return;
+        GetFFTPlan(N, isInverse).Execute(data);
+    }
+    void FFT_1D_Iterative(Complex* data, int N, bool isInverse) {
+        if (N <= 1) return;
+        GetFFTPlan(N, isInverse).Execute(data);
+    }
 
-        auto even = std::make_unique<Complex[]>(N / 2);
-        auto odd = std::make_unique<Complex[]>(N / 2);
-
-        for (int i = 0; i < N / 2; ++i) {
-            even[i] = data[2 * i];
-            odd[i] = data[2 * i + 1];
-        }
-
-        FFT_1D_Recursive(even.get(), N / 2, isInverse);
-        FFT_1D_Recursive(odd.get(), N / 2, isInverse);
-
-        double angleSign = isInverse ? 1.0 : -1.0;
 
-        for (int k = 0; k < N / 2; ++k) {
-            double angle = angleSign * 2.0 * PI * k / N;
-            Complex twiddle = { cos(angle), sin(angle) };
-            Complex product = twiddle * odd[k];
+    void ApplyFFT2D_CPU(const void* inputPixels, Complex* outputSpectrum, int width, int height, int stride, bool isInverse)
+    {
+        const unsigned char* pixels = static_cast<const unsigned char*>(inputPixels);
 
-            data[k] = even[k] + product;
-            data[k + N / 2] = even[k] - product;
+#pragma omp parallel for
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                outputSpectrum[(size_t)y * width + x] = { static_cast<double>(pixels[(size_t)y * stride + x]), 0.0 };
+            }
         }
+        FFT2D(outputSpectrum, width, height, isInverse);
     }
-    void FFT_1D_Iterative(Complex* data, int N, bool isInverse) {
-        // 비트 반전(bit-reversal) 순서로 재배열
-        int j = 0;
-        for (int i = 1; i < N; i++) {
-            int bit = N >> 1;
-            for (; j & bit; bit >>= 1) {
-                j ^= bit;
+
+    void TransposeComplex(const Complex* source, int columns, int rows, Complex* dest)
+    {
+        // 32 x 32 tiles: 16 KB read and 16 KB written per tile, both stay in L1 while the tile is
+        // turned. Each complex is one 16-byte SSE2 load and store
+        const int tileSize = 32;
+        int tileRows = (rows + tileSize - 1) / tileSize;
+        int tileColumns = (columns + tileSize - 1) / tileSize;
+        const double* sourceValues = reinterpret_cast<const double*>(source);
+        double* destValues = reinterpret_cast<double*>(dest);
+
+#pragma omp parallel for schedule(dynamic)
+        for (int tile = 0; tile < tileRows * tileColumns; ++tile) {
+            int yBegin = (tile / tileColumns) * tileSize;
+            int xBegin = (tile % tileColumns) * tileSize;
+            int yEnd = std::min(yBegin + tileSize, rows);
+            int xEnd = std::min(xBegin + tileSize, columns);
+            for (int x = xBegin; x < xEnd; ++x) {
+                double* destRow = destValues + 2 * ((size_t)x * rows);
+                for (int y = yBegin; y < yEnd; ++y) {
+                    _mm_storeu_pd(destRow + 2 * y, _mm_loadu_pd(sourceValues + 2 * ((size_t)y * columns + x)));
+                }
             }
-            j ^= bit;
-            if (i < j) {
-                Complex temp = data[i];
-                data[i] = data[j];
-                data[j] = temp;
+        }
+    }
+
+    // Every row of a row-major array through the same plan, rows in parallel
+    static void FFTRows(Complex* data, int length, int rows, bool isInverse)
+    {
+        const FFTPlan& plan = GetFFTPlan(length, isInverse);
+#pragma omp parallel
+        {
+            std::vector<Complex> scratch(plan.ScratchLength());
+#pragma omp for
+            for (int y = 0; y < rows; ++y) {
+                plan.Execute(&data[(size_t)y * length], scratch.data());
             }
         }
+    }
 
-        // iterative 단계 수행
-        double angleSign = isInverse ? 1.0 : -1.0;
-        for (int len = 2; len <= N; len <<= 1) {
-            double angle = angleSign * 2 * PI / len;
-            Complex wlen = { cos(angle), sin(angle) };
+    // Both passes run on contiguous rows: the column pass transposes, transforms rows and transposes
+    // back instead of gathering every column with a stride of width
+    void FFT2D(Complex* data, int width, int height, bool isInverse)
+    {
+        FFTRows(data, width, height, isInverse);
+        std::vector<Complex> transposed((size_t)width * height);
+        TransposeComplex(data, width, height, transposed.data());
+        FFTRows(transposed.data(), height, width, isInverse);
+        TransposeComplex(transposed.data(), height, width, data);
+    }
 
-            #pragma omp parallel for
-            for (int i = 0; i < N; i += len) {
-                Complex w = { 1.0, 0.0 };
-                for (int j = 0; j < len / 2; j++) {
-                    Complex u = data[i + j];
-                    Complex v = w * data[i + j + len / 2];
+    int HalfSpectrumWidth(int width)
+    {
+        return width / 2 + 1;
+    }
 
-                    data[i + j] = u + v;
-                    data[i + j + len / 2] = u - v;
+    // Rows go through the complex transform two at a time, z = a + i b, and are separated by
+    // Hermitian symmetry: A(k) = (Z(k) + conj Z(-k)) / 2, B(k) = (Z(k) - conj Z(-k)) / 2i.
+    // Only the half-width columns then need the column pass
+    void FFT2D_RealForward(const unsigned char* pixels, int width, int height, int stride, Complex* halfSpectrum, SpectrumLayout layout)
+    {
+        int halfWidth = HalfSpectrumWidth(width);
+        const FFTPlan& rowPlan = GetFFTPlan(width, false);
+        int pairCount = (height + 1) / 2;
+        std::vector<Complex> buffer((size_t)halfWidth * height);
+        // row-major half rows go where the column pass doesn't need them any more
+        Complex* rowSpectrum = (layout == SpectrumLayout::Transposed) ? buffer.data() : halfSpectrum;
 
-                    w = w * wlen;
+#pragma omp parallel
+        {
+            std::vector<Complex> row(width);
+            std::vector<Complex> scratch(rowPlan.ScratchLength());
+#pragma omp for
+            for (int pair = 0; pair < pairCount; ++pair) {
+                int y = 2 * pair;
+                bool hasSecond = y + 1 < height;
+                const unsigned char* rowA = pixels + (size_t)y * stride;
+                const unsigned char* rowB = hasSecond ? rowA + stride : nullptr;
+                for (int x = 0; x < width; ++x) row[x] = { static_cast<double>(rowA[x]), hasSecond ? static_cast<double>(rowB[x]) : 0.0 };
+                rowPlan.Execute(row.data(), scratch.data());
+
+                Complex* outA = rowSpectrum + (size_t)y * halfWidth;
+                for (int k = 0; k < halfWidth; ++k) {
+                    Complex z = row[k];
+                    Complex mirror = row[(width - k) % width];
+                    outA[k] = { 0.5 * (z.real + mirror.real), 0.5 * (z.imag - mirror.imag) };
+                    if (hasSecond) outA[halfWidth + k] = { 0.5 * (z.imag + mirror.imag), -0.5 * (z.real - mirror.real) };
                 }
             }
         }
-        // 역변환 파라미터 확인 후 1/N 스케일링
-        if (isInverse) {
-#pragma omp parallel for
-            for (int i = 0; i < N; i++) {
-                data[i] /= N;
-            }
+
+        if (layout == SpectrumLayout::Transposed) {
+            TransposeComplex(rowSpectrum, halfWidth, height, halfSpectrum);
+            FFTRows(halfSpectrum, height, halfWidth, false);
+            return;
         }
+        TransposeComplex(rowSpectrum, halfWidth, height, buffer.data());
+        FFTRows(buffer.data(), height, halfWidth, false);
+        TransposeComplex(buffer.data(), height, halfWidth, halfSpectrum);
     }
 
-
-    void ApplyFFT2D_CPU(const void* inputPixels, Complex* outputSpectrum, int width, int height, int stride, bool isInverse)
+    // Two half-spectrum rows are extended by F(-k) = conj F(k) and combined as Z = A + i B, so one
+    // inverse transform returns row a in the real part and row b in the imaginary part
+    void FFT2D_RealInverse(Complex* halfSpectrum, int width, int height, double* output, SpectrumLayout layout)
     {
-        const unsigned char* pixels = static_cast<const unsigned char*>(inputPixels);
-        auto tempComplexData = std::make_unique<Complex[]>(width * height);
+        int halfWidth = HalfSpectrumWidth(width);
+        std::vector<Complex> buffer((size_t)halfWidth * height);
+        Complex* rowSpectrum = buffer.data();
+        if (layout == SpectrumLayout::Transposed) {
+            FFTRows(halfSpectrum, height, halfWidth, true);
+            TransposeComplex(halfSpectrum, height, halfWidth, rowSpectrum);
+        }
+        else {
+            TransposeComplex(halfSpectrum, halfWidth, height, buffer.data());
+            FFTRows(buffer.data(), height, halfWidth, true);
+            TransposeComplex(buffer.data(), height, halfWidth, halfSpectrum);
+            rowSpectrum = halfSpectrum;
+        }
 
-#pragma omp parallel for
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                double grayValue = static_cast<double>(pixels[y * stride + x]);
-                tempComplexData.get()[y * width + x] = { grayValue, 0.0 };
+        const FFTPlan& rowPlan = GetFFTPlan(width, true);
+        int pairCount = (height + 1) / 2;
+#pragma omp parallel
+        {
+            std::vector<Complex> row(width);
+            std::vector<Complex> scratch(rowPlan.ScratchLength());
+#pragma omp for
+            for (int pair = 0; pair < pairCount; ++pair) {
+                int y = 2 * pair;
+                bool hasSecond = y + 1 < height;
+                const Complex* inA = rowSpectrum + (size_t)y * halfWidth;
+                const Complex* inB = hasSecond ? inA + halfWidth : nullptr;
+                for (int k = 0; k < width; ++k) {
+                    bool isMirrored = k >= halfWidth;
+                    int source = isMirrored ? width - k : k;
+                    Complex a = inA[source];
+                    Complex b = hasSecond ? inB[source] : Complex{ 0.0, 0.0 };
+                    if (isMirrored) {
+                        a.imag = -a.imag;
+                        b.imag = -b.imag;
+                    }
+                    row[k] = { a.real - b.imag, a.imag + b.real };
+                }
+                rowPlan.Execute(row.data(), scratch.data());
+
+                double* outA = output + (size_t)y * width;
+                for (int x = 0; x < width; ++x) outA[x] = row[x].real;
+                if (hasSecond) {
+                    for (int x = 0; x < width; ++x) outA[width + x] = row[x].imag;
+                }
             }
         }
+    }
 
-#pragma omp parallel for
-        for (int y = 0; y < height; ++y) {
-            FFT_1D_Iterative(&tempComplexData.get()[y * width], width, isInverse);
+    bool FFT2D_RealForwardSplit(const unsigned char* pixels, int width, int height, int stride, SplitHalfSpectrum& spectrum)
+    {
+        const FFTBatchPlan* rowPlan = GetFFTBatchPlan(width, false);
+        const FFTBatchPlan* columnPlan = GetFFTBatchPlan(height, false);
+        if (!rowPlan || !columnPlan) return false;
+
+        const int lanes = FFTBatchLanes;
+        int halfWidth = HalfSpectrumWidth(width);
+        spectrum.width = width;
+        spectrum.height = height;
+        spectrum.stride = (halfWidth + lanes - 1) / lanes * lanes;
+        spectrum.real.assign((size_t)spectrum.stride * height, 0.0f);
+        spectrum.imag.assign((size_t)spectrum.stride * height, 0.0f);
+        float* outReal = spectrum.real.data();
+        float* outImag = spectrum.imag.data();
+
+        // lane s of a row batch holds rows y0 + 2s (real part) and y0 + 2s + 1 (imaginary part),
+        // separated as in FFT2D_RealForward
+        int rowBatches = (height + 2 * lanes - 1) / (2 * lanes);
+#pragma omp parallel
+        {
+            std::vector<float> real((size_t)width * lanes);
+            std::vector<float> imag((size_t)width * lanes);
+            std::vector<float> scratch(rowPlan->ScratchLength());
+#pragma omp for
+            for (int batch = 0; batch < rowBatches; ++batch) {
+                int y0 = batch * 2 * lanes;
+                for (int s = 0; s < lanes; ++s) {
+                    int y = y0 + 2 * s;
+                    const unsigned char* rowA = (y < height) ? pixels + (size_t)y * stride : nullptr;
+                    const unsigned char* rowB = (y + 1 < height) ? pixels + (size_t)(y + 1) * stride : nullptr;
+                    for (int x = 0; x < width; ++x) {
+                        real[(size_t)x * lanes + s] = rowA ? static_cast<float>(rowA[x]) : 0.0f;
+                        imag[(size_t)x * lanes + s] = rowB ? static_cast<float>(rowB[x]) : 0.0f;
+                    }
+                }
+                rowPlan->Execute(real.data(), imag.data(), scratch.data());
+
+                for (int s = 0; s < lanes; ++s) {
+                    int y = y0 + 2 * s;
+                    if (y >= height) break;
+                    bool hasSecond = y + 1 < height;
+                    float* aReal = outReal + (size_t)y * spectrum.stride;
+                    float* aImag = outImag + (size_t)y * spectrum.stride;
+                    for (int k = 0; k < halfWidth; ++k) {
+                        size_t z = (size_t)k * lanes + s;
+                        size_t mirror = (size_t)((width - k) % width) * lanes + s;
+                        aReal[k] = 0.5f * (real[z] + real[mirror]);
+                        aImag[k] = 0.5f * (imag[z] - imag[mirror]);
+                        if (hasSecond) {
+                            aReal[spectrum.stride + k] = 0.5f * (imag[z] + imag[mirror]);
+                            aImag[spectrum.stride + k] = -0.5f * (real[z] - real[mirror]);
+                        }
+                    }
+                }
+            }
         }
-        auto all_columns_buffer = std::make_unique<Complex[]>(width * height);
 
-#pragma omp parallel for
-        for (int x = 0; x < width; ++x) {
-            Complex* tempColumn = &all_columns_buffer.get()[x * height];
-            for (int y = 0; y < height; ++y) {
-                tempColumn[y] = tempComplexData.get()[y * width + x];
-            }
-            FFT_1D_Iterative(tempColumn, height, isInverse);
-            for (int y = 0; y < height; ++y) {
-                tempComplexData.get()[y * width + x] = tempColumn[y];
+        // FFTBatchLanes adjacent columns are one contiguous vector per row, already in batch order
+        int columnBatches = spectrum.stride / lanes;
+#pragma omp parallel
+        {
+            std::vector<float> real((size_t)height * lanes);
+            std::vector<float> imag((size_t)height * lanes);
+            std::vector<float> scratch(columnPlan->ScratchLength());
+#pragma omp for
+            for (int batch = 0; batch < columnBatches; ++batch) {
+                size_t u0 = (size_t)batch * lanes;
+                for (int v = 0; v < height; ++v) {
+                    std::copy_n(outReal + (size_t)v * spectrum.stride + u0, lanes, &real[(size_t)v * lanes]);
+                    std::copy_n(outImag + (size_t)v * spectrum.stride + u0, lanes, &imag[(size_t)v * lanes]);
+                }
+                columnPlan->Execute(real.data(), imag.data(), scratch.data());
+                for (int v = 0; v < height; ++v) {
+                    std::copy_n(&real[(size_t)v * lanes], lanes, outReal + (size_t)v * spectrum.stride + u0);
+                    std::copy_n(&imag[(size_t)v * lanes], lanes, outImag + (size_t)v * spectrum.stride + u0);
+                }
             }
         }
-//
-//        if (isInverse) {
-//            double scale = 1.0 / (width * height);
-//#pragma omp parallel for
-//            for (int i = 0; i < width * height; ++i) {
-//                tempComplexData[i] = tempComplexData[i] * scale;
-//            }
-//        }
+        return true;
+    }
+
+    int NextPowerOfTwo(int value)
+    {
+        int power = 1;
+        while (power < value) power <<= 1;
+        return power;
+    }
 
+    // Rotates the spectrum by (shiftX, shiftY), one row buffer per thread. Odd sizes need this:
+    // the half swap below only inverts itself when both sizes are even
+    static void RotateSpectrum(Complex* spectrum, int width, int height, int shiftX, int shiftY)
+    {
+        std::vector<Complex> rotated((size_t)width * height);
 #pragma omp parallel for
-        for (int i = 0; i < width * height; ++i) {
-            outputSpectrum[i] = tempComplexData.get()[i];
+        for (int y = 0; y < height; ++y) {
+            const Complex* row = &spectrum[(size_t)y * width];
+            Complex* destRow = &rotated[(size_t)((y + shiftY) % height) * width];
+            for (int x = 0; x < width; ++x) destRow[(x + shiftX) % width] = row[x];
         }
+        std::copy(rotated.begin(), rotated.end(), spectrum);
+    }
+
+    void FFT_InverseShift2D(Complex* spectrum, int width, int height) {
+        if (width % 2 == 0 && height % 2 == 0) {
+            FFT_Shift2D(spectrum, width, height);
+            return;
+        }
+        RotateSpectrum(spectrum, width, height, width - width / 2, height - height / 2);
     }
 
     void FFT_Shift2D(Complex* spectrum, int width, int height) {
         int halfWidth = width / 2;
         int halfHeight = height / 2;
+        if (width % 2 != 0 || height % 2 != 0) {
+            RotateSpectrum(spectrum, width, height, halfWidth, halfHeight);
+            return;
+        }
 
 #pragma omp parallel for
         for (int y = 0; y < halfHeight; ++y) {
@@ -9,6 +9,28 @@ namespace ImaGyNative
 	std::vector<double> createLaplacianKernel(int kernelSize);
 	std::vector<double> createGaussianKernel(int kernelSize, double sigma, bool isCircular);
 	std::vector<double> createAverageKernel(int kernelSize, bool isCircular);
+	bool SeparateKernel(const std::vector<double>& kernel, int kernelSize, std::vector<double>& rowKernel, std::vector<double>& columnKernel);
+
+	// Fixed-point kernel: weights[i] = round(kernel[i] * scale * 2^fractionBits)
+	// Q15 for normalized blur kernels, fewer fraction bits for large integer kernels (Laplacian)
+	struct QuantizedKernel {
+		int kernelSize;
+		int fractionBits;
+		std::vector<short> weights;
+	};
+	bool QuantizeKernel(const std::vector<double>& kernel, int kernelSize, double scale, QuantizedKernel& quantized);
+
+	// Nonzero taps of a quantized kernel, taken two at a time so one _mm_madd_epi16 does
+	// both multiply-adds per lane. Offsets are in bytes, so BGRA rows run every channel
+	// through the same tap list
+	struct QuantizedTapPair {
+		int rowOffset;
+		int offset0;
+		int offset1;
+		int weights; // (weight1 << 16) | weight0
+	};
+	std::vector<QuantizedTapPair> BuildTapPairs(const QuantizedKernel& kernel, int pixelBytes);
+
 	int OtsuThreshold(const unsigned char* sourcePixels, int width, int height, int stride);
 
     struct Complex {
@@ -70,7 +92,51 @@ namespace ImaGyNative
 
     void FFT_1D_Recursive(Complex* data, int N, bool isInverse);
     void ApplyFFT2D_CPU(const void* inputPixels, Complex* outputSpectrum, int width, int height, int stride, bool isInverse);
+    // DC moves to (width / 2, height / 2), FFT_InverseShift2D moves it back (they differ for odd sizes)
     void FFT_Shift2D(Complex* spectrum, int width, int height);
+    void FFT_InverseShift2D(Complex* spectrum, int width, int height);
+
+    // dest[x * rows + y] = source[y * columns + x], in cache-sized tiles
+    void TransposeComplex(const Complex* source, int columns, int rows, Complex* dest);
+
+    // In-place 2-D transform of a width x height array of any size (FFTPlan), rows then columns.
+    // The column pass runs on transposed rows. The inverse is scaled by 1 / (width * height)
+    void FFT2D(Complex* data, int width, int height, bool isInverse);
+
+    // Real-input 2-D transform keeping only the non-redundant half of the spectrum, about half the
+    // work and memory of the complex one: halfSpectrum[v * HalfSpectrumWidth(width) + u] for
+    // u <= width / 2. The other columns follow from F(u, v) = conj F(width - u, height - v)
+    //
+    // Transposed keeps the spectrum the way the column pass leaves it, halfSpectrum[u * height + v]:
+    // one transpose fewer each way, for consumers that index (u, v) themselves (masks, magnitudes)
+    enum class SpectrumLayout {
+        RowMajor,
+        Transposed
+    };
+    int HalfSpectrumWidth(int width);
+    void FFT2D_RealForward(const unsigned char* pixels, int width, int height, int stride, Complex* halfSpectrum,
+        SpectrumLayout layout = SpectrumLayout::RowMajor);
+    // Inverse of FFT2D_RealForward, scaled by 1 / (width * height), into width x height reals.
+    // halfSpectrum is overwritten. The spectrum is assumed Hermitian (any mask with
+    // mask(u, v) == mask(-u, -v) keeps it so)
+    void FFT2D_RealInverse(Complex* halfSpectrum, int width, int height, double* output,
+        SpectrumLayout layout = SpectrumLayout::RowMajor);
+
+    // Single-precision half spectrum with split real and imaginary parts, F(u, v) at
+    // [v * stride + u] for u < HalfSpectrumWidth(width). stride is padded to a multiple of
+    // FFTBatchLanes so the column pass reads whole vectors
+    struct SplitHalfSpectrum {
+        int width;
+        int height;
+        int stride;
+        std::vector<float> real;
+        std::vector<float> imag;
+    };
+    // FFT2D_RealForward in float through FFTBatchPlan: rows 16 at a time (8 packed pairs),
+    // then 8 adjacent half-spectrum columns at a time. For 8-bit visualisations of the spectrum.
+    // Returns false without touching spectrum when a size has no batch plan (Bluestein lengths)
+    bool FFT2D_RealForwardSplit(const unsigned char* pixels, int width, int height, int stride, SplitHalfSpectrum& spectrum);
+    int NextPowerOfTwo(int value);
 
 
     // Clustering
@@ -0,0 +1,284 @@
+#include "pch.h"
+#include "KMeans.h"
+#include "SimdDispatch.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <omp.h>
+#include <random>
+
+namespace ImaGyNative
+{
+    // Points per block of the assignment passes, and per block total of the k-means++ draw
+    static const int AssignBlockSize = 256;
+    static const int SeedBlockSize = 65536;
+
+    static double PointWeight(const KMeansPoints& points, int i)
+    {
+        return points.weights ? points.weights[i] : 1.0;
+    }
+
+    static float CentroidDistance(const float* a, const float* b, int dimensions)
+    {
+        float sum = 0.0f;
+        for (int d = 0; d < dimensions; ++d) sum += (a[d] - b[d]) * (a[d] - b[d]);
+        return std::sqrt(sum);
+    }
+
+    // Points [begin, begin + count) of every plane, for the SIMD kernels
+    static void OffsetPlanes(const KMeansPoints& points, int begin, const unsigned char** planes)
+    {
+        for (int d = 0; d < points.dimensions; ++d) planes[d] = points.planes[d] + begin;
+    }
+
+    // First assignment, before any bound exists: the nearest and second nearest centroid of a block
+    // of points through the SIMD kernel, every distance computed
+    static void AssignBlock(const KMeansPoints& points, int begin, int end, const std::vector<float>& centroids, int k,
+        unsigned char* labels, float* upper, float* lower)
+    {
+        const unsigned char* planes[KMeansMaxDimensions];
+        OffsetPlanes(points, begin, planes);
+        int count = end - begin;
+        ActiveSimdKernels().NearestCentroids(planes, points.dimensions, count, centroids.data(), k,
+            labels + begin, upper + begin, lower + begin);
+        for (int j = begin; j < end; ++j) {
+            upper[j] = std::sqrt(upper[j]);
+            lower[j] = std::sqrt(lower[j]);
+        }
+    }
+
+    // sums[c * (dimensions + 1) + d] weighted feature sums, [c * (dimensions + 1) + dimensions] the weight
+    static void AddPoint(const KMeansPoints& points, int i, int cluster, double sign, double* sums)
+    {
+        double weight = sign * PointWeight(points, i);
+        double* clusterSums = sums + (size_t)cluster * (points.dimensions + 1);
+        for (int d = 0; d < points.dimensions; ++d) clusterSums[d] += weight * points.planes[d][i];
+        clusterSums[points.dimensions] += weight;
+    }
+
+    static void MergeThreadSums(std::vector<std::vector<double>>& threadSums, std::vector<double>& sums)
+    {
+        for (std::vector<double>& partial : threadSums) {
+            for (size_t j = 0; j < sums.size(); ++j) sums[j] += partial[j];
+            std::fill(partial.begin(), partial.end(), 0.0);
+        }
+    }
+
+    // Points of a block whose bounds could not rule out a change of cluster: their features are
+    // gathered into small planes and every distance recomputed through the SIMD kernel, which costs
+    // about what the scalar distance to their own centroid alone would. Returns how many changed
+    // cluster; their weights are moved between the clusters' sums
+    static int ReassignCandidates(const KMeansPoints& points, const int* candidates, int candidateCount,
+        const std::vector<float>& centroids, int k, unsigned char* labels, float* upper, float* lower, double* sums)
+    {
+        if (candidateCount == 0) return 0;
+        unsigned char gathered[KMeansMaxDimensions][AssignBlockSize];
+        const unsigned char* planes[KMeansMaxDimensions];
+        for (int d = 0; d < points.dimensions; ++d) {
+            for (int j = 0; j < candidateCount; ++j) gathered[d][j] = points.planes[d][candidates[j]];
+            planes[d] = gathered[d];
+        }
+        unsigned char nearest[AssignBlockSize];
+        float best[AssignBlockSize];
+        float second[AssignBlockSize];
+        ActiveSimdKernels().NearestCentroids(planes, points.dimensions, candidateCount, centroids.data(), k, nearest, best, second);
+
+        int changed = 0;
+        for (int j = 0; j < candidateCount; ++j) {
+            int i = candidates[j];
+            upper[i] = std::sqrt(best[j]);
+            lower[i] = std::sqrt(second[j]);
+            if (nearest[j] != labels[i]) {
+                AddPoint(points, i, labels[i], -1.0, sums);
+                AddPoint(points, i, nearest[j], 1.0, sums);
+                labels[i] = nearest[j];
+                changed++;
+            }
+        }
+        return changed;
+    }
+
+    // Point drawn with probability weight * minDistance[i], blockTotals holding those sums per block
+    static int PickWeighted(const KMeansPoints& points, const float* minDistance, const std::vector<double>& blockTotals, std::mt19937& rng)
+    {
+        double total = 0.0;
+        for (double blockTotal : blockTotals) total += blockTotal;
+        // every point already coincides with a centroid
+        if (total <= 0.0) return static_cast<int>(rng() % (unsigned int)points.count);
+
+        double target = std::uniform_real_distribution<double>(0.0, total)(rng);
+        int block = 0;
+        for (; block + 1 < (int)blockTotals.size() && target > blockTotals[block]; ++block) target -= blockTotals[block];
+
+        int end = std::min(points.count, (block + 1) * SeedBlockSize);
+        int chosen = -1;
+        double cumulative = 0.0;
+        for (int i = block * SeedBlockSize; i < end; ++i) {
+            double share = PointWeight(points, i) * minDistance[i];
+            if (share <= 0.0) continue;
+            chosen = i;
+            cumulative += share;
+            if (cumulative >= target) break;
+        }
+        return chosen >= 0 ? chosen : static_cast<int>(rng() % (unsigned int)points.count);
+    }
+
+    // Weighted k-means++: each new centroid is drawn with probability weight * D^2 to the nearest
+    // one so far. minDistance (one float per point) is updated with each new centroid only
+    static void SeedCentroids(const KMeansPoints& points, int k, unsigned int seed, std::vector<float>& centroids, float* minDistance)
+    {
+        std::mt19937 rng(seed);
+        int dimensions = points.dimensions;
+        int blockCount = (points.count + SeedBlockSize - 1) / SeedBlockSize;
+        std::vector<double> blockTotals(blockCount);
+
+#pragma omp parallel for
+        for (int block = 0; block < blockCount; ++block) {
+            int end = std::min(points.count, (block + 1) * SeedBlockSize);
+            double total = 0.0;
+            for (int i = block * SeedBlockSize; i < end; ++i) {
+                minDistance[i] = 1.0f;
+                total += PointWeight(points, i);
+            }
+            blockTotals[block] = total;
+        }
+
+        for (int c = 0; c < k; ++c) {
+            int chosen = PickWeighted(points, minDistance, blockTotals, rng);
+            float* centroid = &centroids[(size_t)c * dimensions];
+            for (int d = 0; d < dimensions; ++d) centroid[d] = points.planes[d][chosen];
+            if (c + 1 == k) break;
+
+#pragma omp parallel for
+            for (int block = 0; block < blockCount; ++block) {
+                int end = std::min(points.count, (block + 1) * SeedBlockSize);
+                double total = 0.0;
+                for (int begin = block * SeedBlockSize; begin < end; begin += AssignBlockSize) {
+                    int count = std::min(AssignBlockSize, end - begin);
+                    const unsigned char* planes[KMeansMaxDimensions];
+                    OffsetPlanes(points, begin, planes);
+                    unsigned char nearest[AssignBlockSize];
+                    float distance[AssignBlockSize];
+                    float unused[AssignBlockSize];
+                    ActiveSimdKernels().NearestCentroids(planes, dimensions, count, centroid, 1, nearest, distance, unused);
+
+                    float* blockMinimum = minDistance + begin;
+                    if (c == 0) std::copy(distance, distance + count, blockMinimum);
+                    else for (int j = 0; j < count; ++j) blockMinimum[j] = std::min(blockMinimum[j], distance[j]);
+                    if (points.weights) {
+                        for (int j = 0; j < count; ++j) total += (double)points.weights[begin + j] * blockMinimum[j];
+                    }
+                    else {
+                        for (int j = 0; j < count; ++j) total += blockMinimum[j];
+                    }
+                }
+                blockTotals[block] = total;
+            }
+        }
+    }
+
+    void AssignNearestCentroids(const KMeansPoints& points, const float* centroids, int k, unsigned char* labels)
+    {
+        float best[AssignBlockSize];
+        float second[AssignBlockSize];
+        for (int begin = 0; begin < points.count; begin += AssignBlockSize) {
+            const unsigned char* planes[KMeansMaxDimensions];
+            OffsetPlanes(points, begin, planes);
+            int count = std::min(AssignBlockSize, points.count - begin);
+            ActiveSimdKernels().NearestCentroids(planes, points.dimensions, count, centroids, k, labels + begin, best, second);
+        }
+    }
+
+    void RunKMeans(const KMeansPoints& points, int k, int maxIterations, unsigned int seed,
+        std::vector<float>& centroids, std::vector<unsigned char>& labels)
+    {
+        int count = points.count;
+        int dimensions = points.dimensions;
+        labels.assign(std::max(count, 0), 0);
+        if (count <= 0) {
+            centroids.clear();
+            return;
+        }
+        k = std::max(1, std::min(k, std::min(count, KMeansMaxClusters)));
+        maxIterations = std::max(maxIterations, 1);
+        centroids.assign((size_t)k * dimensions, 0.0f);
+
+        std::vector<float> upper(count);
+        std::vector<float> lower(count);
+        SeedCentroids(points, k, seed, centroids, lower.data());
+
+        int blockCount = (count + AssignBlockSize - 1) / AssignBlockSize;
+#pragma omp parallel for
+        for (int block = 0; block < blockCount; ++block) {
+            int begin = block * AssignBlockSize;
+            AssignBlock(points, begin, std::min(count, begin + AssignBlockSize), centroids, k, labels.data(), upper.data(), lower.data());
+        }
+
+        size_t sumsLength = (size_t)k * (dimensions + 1);
+        std::vector<double> sums(sumsLength, 0.0);
+        std::vector<std::vector<double>> threadSums(omp_get_max_threads(), std::vector<double>(sumsLength, 0.0));
+#pragma omp parallel
+        {
+            double* partial = threadSums[omp_get_thread_num()].data();
+#pragma omp for
+            for (int i = 0; i < count; ++i) AddPoint(points, i, labels[i], 1.0, partial);
+        }
+        MergeThreadSums(threadSums, sums);
+
+        std::vector<float> previous(centroids.size());
+        std::vector<float> moved(k);
+        std::vector<float> halfNearest(k);
+        for (int iteration = 0; iteration < maxIterations; ++iteration) {
+            previous = centroids;
+            for (int c = 0; c < k; ++c) {
+                const double* clusterSums = &sums[(size_t)c * (dimensions + 1)];
+                if (clusterSums[dimensions] > 0.0) {
+                    for (int d = 0; d < dimensions; ++d) {
+                        centroids[(size_t)c * dimensions + d] = static_cast<float>(clusterSums[d] / clusterSums[dimensions]);
+                    }
+                }
+                moved[c] = CentroidDistance(&previous[(size_t)c * dimensions], &centroids[(size_t)c * dimensions], dimensions);
+            }
+            if (iteration + 1 == maxIterations) break;
+
+            // A point's lower bound drops by the largest move among the other centroids
+            int farthest = static_cast<int>(std::max_element(moved.begin(), moved.end()) - moved.begin());
+            float maxMoved = moved[farthest];
+            float secondMoved = 0.0f;
+            for (int c = 0; c < k; ++c) {
+                if (c != farthest) secondMoved = std::max(secondMoved, moved[c]);
+            }
+            for (int c = 0; c < k; ++c) {
+                float nearest = FLT_MAX;
+                for (int other = 0; other < k; ++other) {
+                    if (other != c) nearest = std::min(nearest, CentroidDistance(&centroids[(size_t)c * dimensions], &centroids[(size_t)other * dimensions], dimensions));
+                }
+                halfNearest[c] = 0.5f * nearest;
+            }
+
+            int changed = 0;
+#pragma omp parallel reduction(+:changed)
+            {
+                double* partial = threadSums[omp_get_thread_num()].data();
+#pragma omp for
+                for (int block = 0; block < blockCount; ++block) {
+                    int begin = block * AssignBlockSize;
+                    int end = std::min(count, begin + AssignBlockSize);
+                    int candidates[AssignBlockSize];
+                    int candidateCount = 0;
+                    for (int i = begin; i < end; ++i) {
+                        int label = labels[i];
+                        upper[i] += moved[label];
+                        lower[i] -= (label == farthest) ? secondMoved : maxMoved;
+                        if (upper[i] > std::max(halfNearest[label], lower[i])) candidates[candidateCount++] = i;
+                    }
+                    changed += ReassignCandidates(points, candidates, candidateCount, centroids, k,
+                        labels.data(), upper.data(), lower.data(), partial);
+                }
+            }
+            // nothing moved: the next update would leave every centroid where it is
+            if (changed == 0) break;
+            MergeThreadSums(threadSums, sums);
+        }
+    }
+}
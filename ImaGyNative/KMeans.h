@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+
+namespace ImaGyNative
+{
+    const int KMeansMaxDimensions = 5;
+    // Labels are bytes
+    const int KMeansMaxClusters = 256;
+
+    // Points as 8-bit feature planes (SoA): feature d of point i is planes[d][i]. Every feature is on
+    // the same 0..255 scale, distances are plain Euclidean
+    struct KMeansPoints {
+        int dimensions;
+        int count;
+        const unsigned char* planes[KMeansMaxDimensions];
+        const float* weights; // nullptr: every point weighs 1
+    };
+
+    // Weighted k-means (Lloyd) with Hamerly's bounds: each point keeps an upper bound on the distance
+    // to its centroid and a lower bound on the distance to every other one, both moved by how far the
+    // centroids moved. A point whose upper bound is below max(lower bound, half the distance from its
+    // centroid to the nearest other centroid) cannot change cluster and is skipped without computing
+    // any distance, which after the first few iterations is most of them; the rest are gathered per
+    // block and go through the SIMD NearestCentroids kernel. Centroid sums are kept
+    // incrementally from the points that changed cluster, per-thread and merged after each pass.
+    // Stops after maxIterations centroid updates or when no point changes cluster.
+    //
+    // Seeded by weighted k-means++ from `seed`. k is clamped to [1, min(count, KMeansMaxClusters)].
+    // centroids receives k * dimensions floats, centroid c at [c * dimensions], labels one byte per point
+    void RunKMeans(const KMeansPoints& points, int k, int maxIterations, unsigned int seed,
+        std::vector<float>& centroids, std::vector<unsigned char>& labels);
+
+    // Index of the nearest of k centroids (laid out as RunKMeans returns them) for every point, no
+    // bounds kept. Runs on the calling thread, for callers that label their own tiles in parallel
+    void AssignNearestCentroids(const KMeansPoints& points, const float* centroids, int k, unsigned char* labels);
+}
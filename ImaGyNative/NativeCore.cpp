@@ -2,6 +2,9 @@
 #include "NativeCore.h"
 #include "ImageProcessingUtils.h"
 #include "CPUImageProcessor.h"
+#include "BorderHandling.h"
+#include "TemplateMatching.h"
+#include "SpectrumCache.h"
 #include "CudaKernel.cuh" 
 #include "CudaColorKernel.cuh"
 #include <cmath>
@@ -99,6 +102,18 @@ namespace ImaGyNative
 
         }
     }
+    void NativeCore::ApplyKMeansClusteringHistogram(void* pixels, int width, int height, int stride, int k, int iteration, int bitsPerChannel)
+    {
+        ApplyKMeansClusteringHistogram_CPU(pixels, width, height, stride, k, iteration, bitsPerChannel);
+    }
+    void NativeCore::ApplyGmmSegmentation(void* pixels, int width, int height, int stride, int numClusters)
+    {
+        ApplyGmmSegmentation_CPU(pixels, width, height, stride, numClusters);
+    }
+    void NativeCore::ApplyGmmSegmentationColor(void* pixels, int width, int height, int stride, int numClusters)
+    {
+        ApplyGmmSegmentationColor_CPU(pixels, width, height, stride, numClusters);
+    }
 
     // Equalization
     void NativeCore::ApplyEqualization(void* pixels, int width, int height, int stride, unsigned char threshold)
@@ -207,7 +222,7 @@ namespace ImaGyNative
     {
         if (isCPU) {
             // FFT 연산을 위한 임시 복소수 배열
-            Complex* tempSpectrum = new Complex[width * height];
+            Complex* tempSpectrum = new Complex[HalfSpectrumWidth(width) * height];
             if (isPhase) {
                 ApplyFFT2DPhase_CPU(pixels, tempSpectrum, width, height, stride, isInverse);
             }
@@ -221,13 +236,14 @@ namespace ImaGyNative
                 if (LaunchFftSpectrumKernel(static_cast<unsigned char*>(pixels), width, height, stride)) {
                     return;
                 }
-                Complex* tempSpectrum = new Complex[width * height];
+                Complex* tempSpectrum = new Complex[HalfSpectrumWidth(width) * height];
                 if (isPhase) {
                     ApplyFFT2DPhase_CPU(pixels, tempSpectrum, width, height, stride, isInverse);
                 }
                 else {
                     ApplyFFT2DSpectrum_CPU(pixels, tempSpectrum, width, height, stride, isInverse);
                 }
+                delete[] tempSpectrum;
             }
         }
     }
@@ -242,6 +258,32 @@ namespace ImaGyNative
         ApplyAxialBandStopFilter_CPU(pixels, width, height, stride, lowFreqRadius, bandThickness);
     }
 
+    void NativeCore::ApplyFrequencyMaskFilter(void* pixels, int width, int height, int stride, int maskType, double cutoff, double bandwidth, int order) {
+        if (maskType < 0 || maskType > static_cast<int>(FrequencyMaskType::BandStop)) {
+            maskType = static_cast<int>(FrequencyMaskType::IdealLowPass);
+        }
+        FrequencyMaskParams params = {};
+        params.type = static_cast<FrequencyMaskType>(maskType);
+        params.cutoff = cutoff;
+        params.bandwidth = bandwidth;
+        params.order = order;
+        ApplyFrequencyMask_CPU(pixels, width, height, stride, params);
+    }
+
+    void NativeCore::ApplyNotchFilter(void* pixels, int width, int height, int stride, const double* notchCenters, int notchCount, double radius, int order) {
+        FrequencyMaskParams params = {};
+        params.type = FrequencyMaskType::Notch;
+        params.cutoff = radius;
+        params.order = order;
+        if (notchCount > 0) params.notches.assign(notchCenters, notchCenters + 2 * notchCount);
+        ApplyFrequencyMask_CPU(pixels, width, height, stride, params);
+    }
+
+    void NativeCore::ClearSpectrumCache() {
+        ImaGyNative::ClearSpectrumCache();
+        ClearFrequencyMaskCache();
+    }
+
     void NativeCore::ApplyFFTColor(void* pixels, int width, int height, int stride, int kernelSize, bool isInverse, bool isCPU, bool isPhase)
     {
         if (IsCudaAvailable()) {
@@ -309,6 +351,15 @@ namespace ImaGyNative
         ApplyErosionColor_CPU(pixels, width, height, stride, kernelSize, useCircularKernel);
     }
 
+    /// Border
+    void NativeCore::SetBorderMode(int borderMode, unsigned char constantValue)
+    {
+        if (borderMode < 0 || borderMode > static_cast<int>(BorderMode::Constant)) {
+            borderMode = static_cast<int>(BorderMode::Reflect);
+        }
+        SetBorderPolicy(static_cast<BorderMode>(borderMode), constantValue);
+    }
+
     /// NCC
     void NativeCore::ApplyNCC(void* pixels, int width, int height, int stride, void* templatePixels, int templateWidth, int templateHeight, int templateStride, int* outCoords)
     {
@@ -337,6 +388,46 @@ namespace ImaGyNative
         }
         ApplySSD_CPU(pixels, width, height, stride, templatePixels, templateWidth, templateHeight, templateStride, outCoords);
     }
+    void NativeCore::ApplyPyramidMatch(void* pixels, int width, int height, int stride, void* templatePixels, int templateWidth, int templateHeight, int templateStride, int matchMethod, int* outCoords)
+    {
+        if (matchMethod < 0 || matchMethod > static_cast<int>(MatchMethod::SSD)) {
+            matchMethod = static_cast<int>(MatchMethod::NCC);
+        }
+        GrayImage source = { static_cast<const unsigned char*>(pixels), width, height, stride };
+        GrayImage templ = { static_cast<const unsigned char*>(templatePixels), templateWidth, templateHeight, templateStride };
+        // 8 coarse candidates: enough for the repeated die structures seen in review images
+        MatchTemplatePyramid_CPU(source, templ, static_cast<MatchMethod>(matchMethod), -1, 8, outCoords);
+    }
+    int NativeCore::ApplyTemplateMatchPeaks(void* pixels, int width, int height, int stride, void* templatePixels, int templateWidth, int templateHeight, int templateStride,
+        int matchMethod, int maxPeaks, int minDistance, double* outPeaks)
+    {
+        if (matchMethod < 0 || matchMethod > static_cast<int>(MatchMethod::SSD)) {
+            matchMethod = static_cast<int>(MatchMethod::NCC);
+        }
+        GrayImage source = { static_cast<const unsigned char*>(pixels), width, height, stride };
+        GrayImage templ = { static_cast<const unsigned char*>(templatePixels), templateWidth, templateHeight, templateStride };
+        std::vector<MatchPeak> peaks = FindMatchPeaks_CPU(source, templ, static_cast<MatchMethod>(matchMethod), maxPeaks, minDistance);
+        for (size_t i = 0; i < peaks.size(); ++i) {
+            outPeaks[i * 3] = peaks[i].x;
+            outPeaks[i * 3 + 1] = peaks[i].y;
+            outPeaks[i * 3 + 2] = peaks[i].score;
+        }
+        return static_cast<int>(peaks.size());
+    }
+    void NativeCore::ApplyTemplateMatchBatch(void* pixels, int width, int height, int stride,
+        void** templatePixels, const int* templateWidths, const int* templateHeights, const int* templateStrides,
+        int templateCount, int matchMethod, int* outCoords)
+    {
+        if (matchMethod < 0 || matchMethod > static_cast<int>(MatchMethod::SSD)) {
+            matchMethod = static_cast<int>(MatchMethod::NCC);
+        }
+        GrayImage source = { static_cast<const unsigned char*>(pixels), width, height, stride };
+        std::vector<GrayImage> templates(std::max(templateCount, 0));
+        for (int i = 0; i < (int)templates.size(); ++i) {
+            templates[i] = { static_cast<const unsigned char*>(templatePixels[i]), templateWidths[i], templateHeights[i], templateStrides[i] };
+        }
+        MatchTemplateBatch_CPU(source, templates, static_cast<MatchMethod>(matchMethod), outCoords);
+    }
 
 
 
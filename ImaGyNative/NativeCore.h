@@ -20,6 +20,14 @@ namespace ImaGyNative
         static void ApplyEqualizationColor(void* pixels, int width, int height, int stride, unsigned char threshold);
         
         static void ApplyKMeansClustering(void* pixels, int width, int height, int stride, int k, int iteration, bool location);
+        // Colour-only k-means on a histogram of bitsPerChannel (4..7) bits per channel; iteration cost
+        // depends on the number of occupied bins, not the image size. For very large images, where
+        // ApplyKMeansClustering's per-pixel passes dominate; each pixel takes the mean colour of its bin's cluster
+        static void ApplyKMeansClusteringHistogram(void* pixels, int width, int height, int stride, int k, int iteration, int bitsPerChannel);
+        // Gaussian mixture segmentation into numClusters populations (e.g. background, pattern, defect),
+        // each pixel replaced by the mean of its most probable component
+        static void ApplyGmmSegmentation(void* pixels, int width, int height, int stride, int numClusters);
+        static void ApplyGmmSegmentationColor(void* pixels, int width, int height, int stride, int numClusters);
 
         static void ApplyHistogram(void* pixels, int width, int height, int stride, int* hist);
 
@@ -33,6 +41,17 @@ namespace ImaGyNative
 
         static void ApplyFrequencyFilter(void* pixels, int width, int height, int stride, int filterType, double radius);
         static void ApplyAxialBandStopFilter(void* pixels, int width, int height, int stride, double lowFreqRadius, double bandThickness);
+        // maskType: 0 ideal low-pass, 1 ideal high-pass, 2 / 3 Butterworth low / high-pass, 4 / 5 Gaussian low / high-pass,
+        // 6 band-pass, 7 band-stop (Butterworth rings of radius cutoff and width bandwidth). cutoff and bandwidth are
+        // in frequency units (pixels of the shifted spectrum), order is the Butterworth order
+        static void ApplyFrequencyMaskFilter(void* pixels, int width, int height, int stride, int maskType, double cutoff, double bandwidth, int order);
+        // Butterworth notch reject for periodic patterns: notchCenters holds notchCount (du, dv) offsets from DC,
+        // each removed with its mirror (-du, -dv) within about radius
+        static void ApplyNotchFilter(void* pixels, int width, int height, int stride, const double* notchCenters, int notchCount, double radius, int order);
+        // The frequency filters cache the forward spectrum of the image they last ran on (up to 256 MB),
+        // so re-running them on the same unchanged buffer skips the forward FFT, and their masks (up to 128 MB).
+        // Frees that memory
+        static void ClearSpectrumCache();
 
         // Blurring
         static void ApplyGaussianBlur(void* pixels, int width, int height, int stride, double sigma, int kernelSize, bool useCircularKernel);
@@ -48,6 +67,9 @@ namespace ImaGyNative
         static void ApplyErosion(void* pixels, int width, int height, int stride, int kernelSize, bool useCircularKernel);
         static void ApplyErosionColor(void* pixels, int width, int height, int stride, int kernelSize, bool useCircularKernel);
 
+        // Border handling for neighborhood filters (0: Replicate, 1: Reflect, 2: Constant)
+        static void SetBorderMode(int borderMode, unsigned char constantValue);
+
 
         // Image Matching
                 // Image Matching
@@ -57,5 +79,57 @@ namespace ImaGyNative
             void* templatePixels, int templateWidth, int templateHeight, int templateStride, int* outCoords);
         static void ApplySSD(void* pixels, int width, int height, int stride, 
             void* templatePixels, int templateWidth, int templateHeight, int templateStride, int* outCoords);
+
+        // Coarse-to-fine search on Gaussian pyramids of the full-resolution images
+        // matchMethod: 0 NCC, 1 SAD, 2 SSD
+        static void ApplyPyramidMatch(void* pixels, int width, int height, int stride,
+            void* templatePixels, int templateWidth, int templateHeight, int templateStride, int matchMethod, int* outCoords);
+
+        // Up to maxPeaks matches, best first, at least minDistance pixels apart (<= 0: half the template).
+        // outPeaks receives x, y (sub-pixel) and score for each peak, 3 * maxPeaks doubles:
+        // the NCC coefficient, or the SAD / SSD error. Returns the number of peaks written
+        static int ApplyTemplateMatchPeaks(void* pixels, int width, int height, int stride,
+            void* templatePixels, int templateWidth, int templateHeight, int templateStride,
+            int matchMethod, int maxPeaks, int minDistance, double* outPeaks);
+
+        // templateCount templates against one image, source statistics computed once.
+        // outCoords receives x, y of the best match of each template, 2 * templateCount ints
+        static void ApplyTemplateMatchBatch(void* pixels, int width, int height, int stride,
+            void** templatePixels, const int* templateWidths, const int* templateHeights, const int* templateStrides,
+            int templateCount, int matchMethod, int* outCoords);
+    };
+
+    // Records a chain of grayscale operators and runs it tile by tile in one pass, so the frame is
+    // read and written once per Execute instead of once per operator. Neighborhood stages are fused
+    // by growing the tile halo by each stage's radius, per-pixel stages are folded into one lookup table.
+    // The result matches calling the *_CPU functions one after another.
+    // Binarization with threshold -1 (Otsu) needs the histogram of its input and splits the chain there
+    class IMAGYNATIVE_API Pipeline
+    {
+    public:
+        Pipeline();
+        ~Pipeline();
+
+        void AddGaussianBlur(double sigma, int kernelSize, bool useCircularKernel);
+        void AddAverageBlur(int kernelSize, bool useCircularKernel);
+        void AddDifferential();
+        void AddSobel(int kernelSize);
+        void AddLaplacian(int kernelSize);
+        void AddDilation(int kernelSize, bool useCircularKernel);
+        void AddErosion(int kernelSize, bool useCircularKernel);
+        void AddBinarization(int threshold);
+        void AddAdjBrightness(int value);
+
+        void Clear();
+        int StageCount() const;
+
+        void Execute(void* pixels, int width, int height, int stride) const;
+
+    private:
+        Pipeline(const Pipeline&) = delete;
+        Pipeline& operator=(const Pipeline&) = delete;
+
+        struct Impl; // Pipeline.cpp
+        Impl* impl;
     };
 }
@@ -0,0 +1,125 @@
+#include "pch.h"
+#include "SimdKernels.h"
+
+namespace ImaGyNative
+{
+    namespace
+    {
+        struct Avx2
+        {
+            static const int Width = 32;
+            using Vector = __m256i;
+            struct Accumulator { __m256i sum[4]; };
+
+            static Vector Load(const unsigned char* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+            static void Store(unsigned char* p, Vector v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+            static Vector Max(Vector a, Vector b) { return _mm256_max_epu8(a, b); }
+            static Vector Min(Vector a, Vector b) { return _mm256_min_epu8(a, b); }
+            static Vector AbsDiff(Vector a, Vector b) { return _mm256_or_si256(_mm256_subs_epu8(a, b), _mm256_subs_epu8(b, a)); }
+            static Vector AddSaturate(Vector a, Vector b) { return _mm256_adds_epu8(a, b); }
+            static Vector Zero() { return _mm256_setzero_si256(); }
+
+            // unpack interleaves within 128-bit halves, which a sum doesn't care about
+            static Vector DotAccumulate(Vector sums, Vector a, Vector b)
+            {
+                const __m256i zero = _mm256_setzero_si256();
+                sums = _mm256_add_epi32(sums, _mm256_madd_epi16(_mm256_unpacklo_epi8(a, zero), _mm256_unpacklo_epi8(b, zero)));
+                return _mm256_add_epi32(sums, _mm256_madd_epi16(_mm256_unpackhi_epi8(a, zero), _mm256_unpackhi_epi8(b, zero)));
+            }
+
+            static Vector AbsDiffAccumulate(Vector sums, Vector a, Vector b) { return _mm256_add_epi64(sums, _mm256_sad_epu8(a, b)); }
+
+            static Vector SquaredDiffAccumulate(Vector sums, Vector a, Vector b)
+            {
+                const __m256i zero = _mm256_setzero_si256();
+                __m256i lo = _mm256_sub_epi16(_mm256_unpacklo_epi8(a, zero), _mm256_unpacklo_epi8(b, zero));
+                __m256i hi = _mm256_sub_epi16(_mm256_unpackhi_epi8(a, zero), _mm256_unpackhi_epi8(b, zero));
+                return _mm256_add_epi32(sums, _mm256_add_epi32(_mm256_madd_epi16(lo, lo), _mm256_madd_epi16(hi, hi)));
+            }
+
+            static long long HorizontalSum64(Vector v)
+            {
+                alignas(32) long long lanes[4];
+                _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), v);
+                return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+            }
+
+            static long long HorizontalSum(Vector v)
+            {
+                alignas(32) int lanes[8];
+                _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), v);
+                long long sum = 0;
+                for (int i = 0; i < 8; ++i) sum += lanes[i];
+                return sum;
+            }
+
+            static void Clear(Accumulator& acc)
+            {
+                for (int i = 0; i < 4; ++i) acc.sum[i] = _mm256_setzero_si256();
+            }
+
+            // Widening with cvtepu8 keeps the 16-bit lanes in pixel order, but unpack/madd work
+            // per 128-bit half: sum[0] holds pixels 0-3 | 8-11, sum[1] 4-7 | 12-15, and so on.
+            // StoreSums puts them back in order once per block
+            static void MultiplyAdd(Accumulator& acc, const unsigned char* p0, const unsigned char* p1, int weights)
+            {
+                __m256i w = _mm256_set1_epi32(weights);
+                for (int half = 0; half < 2; ++half) {
+                    __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p0 + half * 16)));
+                    __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p1 + half * 16)));
+                    acc.sum[half * 2] = _mm256_add_epi32(acc.sum[half * 2], _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), w));
+                    acc.sum[half * 2 + 1] = _mm256_add_epi32(acc.sum[half * 2 + 1], _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), w));
+                }
+            }
+
+            static void StoreSums(int* out, const Accumulator& acc)
+            {
+                for (int half = 0; half < 2; ++half) {
+                    __m256i lo = acc.sum[half * 2];
+                    __m256i hi = acc.sum[half * 2 + 1];
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + half * 16), _mm256_permute2x128_si256(lo, hi, 0x20));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + half * 16 + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+                }
+            }
+
+            // The packs work per 128-bit half, which leaves 4-byte groups as
+            // v0[0-3] v1[0-3] v2[0-3] v3[0-3] | v0[4-7] v1[4-7] ..., one dword permute restores the order
+            static void PackSums(const int* sums, int shift, unsigned char* out)
+            {
+                const __m128i count = _mm_cvtsi32_si128(shift);
+                __m256i v[4];
+                for (int i = 0; i < 4; ++i) v[i] = _mm256_sra_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(sums + i * 8)), count);
+                __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(v[0], v[1]), _mm256_packs_epi32(v[2], v[3]));
+                Store(out, _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7)));
+            }
+        };
+
+        // FFTBatchLanes floats, one YMM register. No FMA: AVX2 detection doesn't imply it
+        struct Avx2Float
+        {
+            using Vector = __m256;
+
+            static Vector Load(const float* p) { return _mm256_loadu_ps(p); }
+            static void Store(float* p, Vector v) { _mm256_storeu_ps(p, v); }
+            static Vector Broadcast(float value) { return _mm256_set1_ps(value); }
+            static Vector Add(Vector a, Vector b) { return _mm256_add_ps(a, b); }
+            static Vector Sub(Vector a, Vector b) { return _mm256_sub_ps(a, b); }
+            static Vector Mul(Vector a, Vector b) { return _mm256_mul_ps(a, b); }
+            static Vector Min(Vector a, Vector b) { return _mm256_min_ps(a, b); }
+            static Vector Max(Vector a, Vector b) { return _mm256_max_ps(a, b); }
+            static Vector Less(Vector a, Vector b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+            // mask ? b : a
+            static Vector Blend(Vector a, Vector b, Vector mask) { return _mm256_blendv_ps(a, b, mask); }
+            static Vector LoadBytes(const unsigned char* p)
+            {
+                return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p))));
+            }
+        };
+    }
+
+    const SimdKernelTable& Avx2Kernels()
+    {
+        static const SimdKernelTable table = MakeKernelTable<Avx2, Avx2Float>(SimdLevel::Avx2);
+        return table;
+    }
+}
@@ -0,0 +1,124 @@
+#include "pch.h"
+#include "SimdKernels.h"
+
+namespace ImaGyNative
+{
+    namespace
+    {
+        struct Avx512
+        {
+            static const int Width = 64;
+            using Vector = __m512i;
+            struct Accumulator { __m512i sum[4]; };
+
+            static Vector Load(const unsigned char* p) { return _mm512_loadu_si512(p); }
+            static void Store(unsigned char* p, Vector v) { _mm512_storeu_si512(p, v); }
+            static Vector Max(Vector a, Vector b) { return _mm512_max_epu8(a, b); }
+            static Vector Min(Vector a, Vector b) { return _mm512_min_epu8(a, b); }
+            static Vector AbsDiff(Vector a, Vector b) { return _mm512_or_si512(_mm512_subs_epu8(a, b), _mm512_subs_epu8(b, a)); }
+            static Vector AddSaturate(Vector a, Vector b) { return _mm512_adds_epu8(a, b); }
+            static Vector Zero() { return _mm512_setzero_si512(); }
+
+            static Vector DotAccumulate(Vector sums, Vector a, Vector b)
+            {
+                const __m512i zero = _mm512_setzero_si512();
+                sums = _mm512_add_epi32(sums, _mm512_madd_epi16(_mm512_unpacklo_epi8(a, zero), _mm512_unpacklo_epi8(b, zero)));
+                return _mm512_add_epi32(sums, _mm512_madd_epi16(_mm512_unpackhi_epi8(a, zero), _mm512_unpackhi_epi8(b, zero)));
+            }
+
+            static Vector AbsDiffAccumulate(Vector sums, Vector a, Vector b) { return _mm512_add_epi64(sums, _mm512_sad_epu8(a, b)); }
+
+            static Vector SquaredDiffAccumulate(Vector sums, Vector a, Vector b)
+            {
+                const __m512i zero = _mm512_setzero_si512();
+                __m512i lo = _mm512_sub_epi16(_mm512_unpacklo_epi8(a, zero), _mm512_unpacklo_epi8(b, zero));
+                __m512i hi = _mm512_sub_epi16(_mm512_unpackhi_epi8(a, zero), _mm512_unpackhi_epi8(b, zero));
+                return _mm512_add_epi32(sums, _mm512_add_epi32(_mm512_madd_epi16(lo, lo), _mm512_madd_epi16(hi, hi)));
+            }
+
+            static long long HorizontalSum64(Vector v) { return _mm512_reduce_add_epi64(v); }
+
+            // lanes summed in 64 bits, _mm512_reduce_add_epi32 could overflow on long rows
+            static long long HorizontalSum(Vector v)
+            {
+                alignas(64) int lanes[16];
+                _mm512_store_si512(lanes, v);
+                long long sum = 0;
+                for (int i = 0; i < 16; ++i) sum += lanes[i];
+                return sum;
+            }
+
+            static void Clear(Accumulator& acc)
+            {
+                for (int i = 0; i < 4; ++i) acc.sum[i] = _mm512_setzero_si512();
+            }
+
+            // Same layout as the AVX2 backend with four 128-bit lanes:
+            // sum[0] lane k holds pixels 8k..8k+3, sum[1] lane k holds 8k+4..8k+7
+            static void MultiplyAdd(Accumulator& acc, const unsigned char* p0, const unsigned char* p1, int weights)
+            {
+                __m512i w = _mm512_set1_epi32(weights);
+                for (int half = 0; half < 2; ++half) {
+                    __m512i a = _mm512_cvtepu8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p0 + half * 32)));
+                    __m512i b = _mm512_cvtepu8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p1 + half * 32)));
+                    acc.sum[half * 2] = _mm512_add_epi32(acc.sum[half * 2], _mm512_madd_epi16(_mm512_unpacklo_epi16(a, b), w));
+                    acc.sum[half * 2 + 1] = _mm512_add_epi32(acc.sum[half * 2 + 1], _mm512_madd_epi16(_mm512_unpackhi_epi16(a, b), w));
+                }
+            }
+
+            static void StoreSums(int* out, const Accumulator& acc)
+            {
+                // interleave 128-bit lanes of lo / hi, indices are 64-bit elements (hi starts at 8)
+                const __m512i firstHalf = _mm512_setr_epi64(0, 1, 8, 9, 2, 3, 10, 11);
+                const __m512i secondHalf = _mm512_setr_epi64(4, 5, 12, 13, 6, 7, 14, 15);
+                for (int half = 0; half < 2; ++half) {
+                    __m512i lo = acc.sum[half * 2];
+                    __m512i hi = acc.sum[half * 2 + 1];
+                    _mm512_storeu_si512(out + half * 32, _mm512_permutex2var_epi64(lo, firstHalf, hi));
+                    _mm512_storeu_si512(out + half * 32 + 16, _mm512_permutex2var_epi64(lo, secondHalf, hi));
+                }
+            }
+
+            // Per 128-bit lane L the packs leave v0[4L..4L+3] v1[..] v2[..] v3[..], dword m of the
+            // result has to come from dword (m % 4) * 4 + m / 4
+            static void PackSums(const int* sums, int shift, unsigned char* out)
+            {
+                const __m128i count = _mm_cvtsi32_si128(shift);
+                __m512i v[4];
+                for (int i = 0; i < 4; ++i) v[i] = _mm512_sra_epi32(_mm512_loadu_si512(sums + i * 16), count);
+                __m512i packed = _mm512_packus_epi16(_mm512_packs_epi32(v[0], v[1]), _mm512_packs_epi32(v[2], v[3]));
+                const __m512i order = _mm512_setr_epi32(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+                Store(out, _mm512_permutexvar_epi32(order, packed));
+            }
+        };
+
+        // The batch layout fixes FFTBatchLanes at 8 floats, a YMM register: same code as Avx2Float,
+        // private to this backend like everything else here
+        struct Avx512Float
+        {
+            using Vector = __m256;
+
+            static Vector Load(const float* p) { return _mm256_loadu_ps(p); }
+            static void Store(float* p, Vector v) { _mm256_storeu_ps(p, v); }
+            static Vector Broadcast(float value) { return _mm256_set1_ps(value); }
+            static Vector Add(Vector a, Vector b) { return _mm256_add_ps(a, b); }
+            static Vector Sub(Vector a, Vector b) { return _mm256_sub_ps(a, b); }
+            static Vector Mul(Vector a, Vector b) { return _mm256_mul_ps(a, b); }
+            static Vector Min(Vector a, Vector b) { return _mm256_min_ps(a, b); }
+            static Vector Max(Vector a, Vector b) { return _mm256_max_ps(a, b); }
+            static Vector Less(Vector a, Vector b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+            // mask ? b : a
+            static Vector Blend(Vector a, Vector b, Vector mask) { return _mm256_blendv_ps(a, b, mask); }
+            static Vector LoadBytes(const unsigned char* p)
+            {
+                return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p))));
+            }
+        };
+    }
+
+    const SimdKernelTable& Avx512Kernels()
+    {
+        static const SimdKernelTable table = MakeKernelTable<Avx512, Avx512Float>(SimdLevel::Avx512);
+        return table;
+    }
+}
@@ -1,430 +1,302 @@
 #include "pch.h"
 #include "NativeCoreSse.h"
+#include "BorderHandling.h"
+#include "SimdKernels.h"
+#include "TileScheduler.h"
+#include "ImageProcessingUtils.h"
+#include "CPUImageProcessor.h"
 #include <immintrin.h> // For SSE intrinsics
 #include <algorithm>   // For std::min
+#include <vector>
 
 namespace ImaGyNative
 {
-    namespace SSE
+    namespace
     {
-        // Corrected SSE implementation for Average Blur  
-        void ApplyAverageBlurSse(void* pixels, int width, int height, int stride, int kernelSize)
+        struct Sse2
         {
-            unsigned char* pixelData = static_cast<unsigned char*>(pixels);
-            unsigned char* sourceBuffer = new unsigned char[height * stride];
-            memcpy(sourceBuffer, pixelData, height * stride);
+            static const int Width = 16;
+            using Vector = __m128i;
+            struct Accumulator { __m128i sum[4]; };
+
+            static Vector Load(const unsigned char* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+            static void Store(unsigned char* p, Vector v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+            static Vector Max(Vector a, Vector b) { return _mm_max_epu8(a, b); }
+            static Vector Min(Vector a, Vector b) { return _mm_min_epu8(a, b); }
+            static Vector AbsDiff(Vector a, Vector b) { return _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a)); }
+            static Vector AddSaturate(Vector a, Vector b) { return _mm_adds_epu8(a, b); }
+            static Vector Zero() { return _mm_setzero_si128(); }
+
+            // bytes widened to int16, then pairwise products summed into the int32 lanes
+            static Vector DotAccumulate(Vector sums, Vector a, Vector b)
+            {
+                const __m128i zero = _mm_setzero_si128();
+                sums = _mm_add_epi32(sums, _mm_madd_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero)));
+                return _mm_add_epi32(sums, _mm_madd_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero)));
+            }
 
-            const int vectorSize = 16;
-            int vectorizedWidth = width - (width % vectorSize);
-            const __m128i mul_div_9 = _mm_set1_epi16(7282); // for x/9 approximation
-            __m128i zero = _mm_setzero_si128();
+            static Vector AbsDiffAccumulate(Vector sums, Vector a, Vector b) { return _mm_add_epi64(sums, _mm_sad_epu8(a, b)); }
 
-            for (int y = 1; y < height - 1; ++y)
+            static Vector SquaredDiffAccumulate(Vector sums, Vector a, Vector b)
             {
-                for (int x = 1; x < vectorizedWidth - 1; x += vectorSize)
-                {
-                    // Load 9 neighboring 16-pixel blocks
-                    __m128i p8_tl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + (y - 1) * stride + (x - 1)));
-                    __m128i p8_tc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + (y - 1) * stride + x));
-                    __m128i p8_tr = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + (y - 1) * stride + (x + 1)));
-                    __m128i p8_ml = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + y * stride + (x - 1)));
-                    __m128i p8_mc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + y * stride + x));
-                    __m128i p8_mr = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + y * stride + (x + 1)));
-                    __m128i p8_bl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + (y + 1) * stride + (x - 1)));
-                    __m128i p8_bc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + (y + 1) * stride + x));
-                    __m128i p8_br = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + (y + 1) * stride + (x + 1)));
-
-                    // Process low 8 pixels
-                    __m128i sum_lo = _mm_add_epi16(_mm_unpacklo_epi8(p8_tl, zero), _mm_unpacklo_epi8(p8_tc, zero));
-                    sum_lo = _mm_add_epi16(sum_lo, _mm_unpacklo_epi8(p8_tr, zero));
-                    sum_lo = _mm_add_epi16(sum_lo, _mm_unpacklo_epi8(p8_ml, zero));
-                    sum_lo = _mm_add_epi16(sum_lo, _mm_unpacklo_epi8(p8_mc, zero));
-                    sum_lo = _mm_add_epi16(sum_lo, _mm_unpacklo_epi8(p8_mr, zero));
-                    sum_lo = _mm_add_epi16(sum_lo, _mm_unpacklo_epi8(p8_bl, zero));
-                    sum_lo = _mm_add_epi16(sum_lo, _mm_unpacklo_epi8(p8_bc, zero));
-                    sum_lo = _mm_add_epi16(sum_lo, _mm_unpacklo_epi8(p8_br, zero));
-                    __m128i avg_lo = _mm_mulhi_epu16(sum_lo, mul_div_9);
-
-                    // Process high 8 pixels
-                    __m128i sum_hi = _mm_add_epi16(_mm_unpackhi_epi8(p8_tl, zero), _mm_unpackhi_epi8(p8_tc, zero));
-                    sum_hi = _mm_add_epi16(sum_hi, _mm_unpackhi_epi8(p8_tr, zero));
-                    sum_hi = _mm_add_epi16(sum_hi, _mm_unpackhi_epi8(p8_ml, zero));
-                    sum_hi = _mm_add_epi16(sum_hi, _mm_unpackhi_epi8(p8_mc, zero));
-                    sum_hi = _mm_add_epi16(sum_hi, _mm_unpackhi_epi8(p8_mr, zero));
-                    sum_hi = _mm_add_epi16(sum_hi, _mm_unpackhi_epi8(p8_bl, zero));
-                    sum_hi = _mm_add_epi16(sum_hi, _mm_unpackhi_epi8(p8_bc, zero));
-                    sum_hi = _mm_add_epi16(sum_hi, _mm_unpackhi_epi8(p8_br, zero));
-                    __m128i avg_hi = _mm_mulhi_epu16(sum_hi, mul_div_9);
-
-                    // Pack and store
-                    _mm_storeu_si128(reinterpret_cast<__m128i*>(pixelData + y * stride + x), _mm_packus_epi16(avg_lo, avg_hi));
-                }
+                const __m128i zero = _mm_setzero_si128();
+                __m128i lo = _mm_sub_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+                __m128i hi = _mm_sub_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+                return _mm_add_epi32(sums, _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi)));
+            }
 
-                // Process remaining pixels
-                for (int x = vectorizedWidth; x < width - 1; ++x) {
-                    if (x > 0) {
-                        int sum = 0;
-                        for (int j = -1; j <= 1; ++j) {
-                            for (int i = -1; i <= 1; ++i) {
-                                sum += sourceBuffer[(y + j) * stride + (x + i)];
-                            }
-                        }
-                        pixelData[y * stride + x] = static_cast<unsigned char>(sum / 9);
-                    }
-                }
+            static long long HorizontalSum(Vector v)
+            {
+                alignas(16) int lanes[4];
+                _mm_store_si128(reinterpret_cast<__m128i*>(lanes), v);
+                return (long long)lanes[0] + lanes[1] + lanes[2] + lanes[3];
             }
-            delete[] sourceBuffer;
-        }
 
-        void ApplyGaussianBlurSse(void* pixels, int width, int height, int stride, double sigma, int kernelSize)
-        {
-            unsigned char* pixelData = static_cast<unsigned char*>(pixels);
-            unsigned char* sourceBuffer = new unsigned char[height * stride];
-            memcpy(sourceBuffer, pixelData, height * stride);
+            static long long HorizontalSum64(Vector v)
+            {
+                alignas(16) long long lanes[2];
+                _mm_store_si128(reinterpret_cast<__m128i*>(lanes), v);
+                return lanes[0] + lanes[1];
+            }
 
-            const int vectorSize = 16;
-            int vectorizedWidth = width - (width % vectorSize);
-            __m128i zero = _mm_setzero_si128();
+            static void Clear(Accumulator& acc)
+            {
+                for (int i = 0; i < 4; ++i) acc.sum[i] = _mm_setzero_si128();
+            }
 
-            const __m128i w1 = _mm_set1_epi16(1);
-            const __m128i w2 = _mm_set1_epi16(2);
-            const __m128i w4 = _mm_set1_epi16(4);
+            // (p0, p1) interleaved per lane -> p0 * weight0 + p1 * weight1
+            static void MultiplyAdd(Accumulator& acc, const unsigned char* p0, const unsigned char* p1, int weights)
+            {
+                const __m128i zero = _mm_setzero_si128();
+                __m128i w = _mm_set1_epi32(weights);
+                __m128i a = Load(p0);
+                __m128i b = Load(p1);
+                __m128i a_lo = _mm_unpacklo_epi8(a, zero);
+                __m128i a_hi = _mm_unpackhi_epi8(a, zero);
+                __m128i b_lo = _mm_unpacklo_epi8(b, zero);
+                __m128i b_hi = _mm_unpackhi_epi8(b, zero);
+                acc.sum[0] = _mm_add_epi32(acc.sum[0], _mm_madd_epi16(_mm_unpacklo_epi16(a_lo, b_lo), w));
+                acc.sum[1] = _mm_add_epi32(acc.sum[1], _mm_madd_epi16(_mm_unpackhi_epi16(a_lo, b_lo), w));
+                acc.sum[2] = _mm_add_epi32(acc.sum[2], _mm_madd_epi16(_mm_unpacklo_epi16(a_hi, b_hi), w));
+                acc.sum[3] = _mm_add_epi32(acc.sum[3], _mm_madd_epi16(_mm_unpackhi_epi16(a_hi, b_hi), w));
+            }
 
-            for (int y = 1; y < height - 1; ++y)
+            static void StoreSums(int* out, const Accumulator& acc)
             {
-                for (int x = 1; x < vectorizedWidth - 1; x += vectorSize)
-                {
-                    __m128i p8_tl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + (y - 1) * stride + (x - 1)));
-                    __m128i p8_tc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + (y - 1) * stride + x));
-                    __m128i p8_tr = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + (y - 1) * stride + (x + 1)));
-                    __m128i p8_ml = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + y * stride + (x - 1)));
-                    __m128i p8_mc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + y * stride + x));
-                    __m128i p8_mr = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + y * stride + (x + 1)));
-                    __m128i p8_bl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + (y + 1) * stride + (x - 1)));
-                    __m128i p8_bc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + (y + 1) * stride + x));
-                    __m128i p8_br = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + (y + 1) * stride + (x + 1)));
-
-                    // Process low 8 pixels
-                    __m128i sum_lo = _mm_mullo_epi16(_mm_unpacklo_epi8(p8_tl, zero), w1);
-                    sum_lo = _mm_add_epi16(sum_lo, _mm_mullo_epi16(_mm_unpacklo_epi8(p8_tc, zero), w2));
-                    sum_lo = _mm_add_epi16(sum_lo, _mm_mullo_epi16(_mm_unpacklo_epi8(p8_tr, zero), w1));
-                    sum_lo = _mm_add_epi16(sum_lo, _mm_mullo_epi16(_mm_unpacklo_epi8(p8_ml, zero), w2));
-                    sum_lo = _mm_add_epi16(sum_lo, _mm_mullo_epi16(_mm_unpacklo_epi8(p8_mc, zero), w4));
-                    sum_lo = _mm_add_epi16(sum_lo, _mm_mullo_epi16(_mm_unpacklo_epi8(p8_mr, zero), w2));
-                    sum_lo = _mm_add_epi16(sum_lo, _mm_mullo_epi16(_mm_unpacklo_epi8(p8_bl, zero), w1));
-                    sum_lo = _mm_add_epi16(sum_lo, _mm_mullo_epi16(_mm_unpacklo_epi8(p8_bc, zero), w2));
-                    sum_lo = _mm_add_epi16(sum_lo, _mm_mullo_epi16(_mm_unpacklo_epi8(p8_br, zero), w1));
-                    __m128i avg_lo = _mm_srli_epi16(sum_lo, 4);
-
-                    // Process high 8 pixels
-                    __m128i sum_hi = _mm_mullo_epi16(_mm_unpackhi_epi8(p8_tl, zero), w1);
-                    sum_hi = _mm_add_epi16(sum_hi, _mm_mullo_epi16(_mm_unpackhi_epi8(p8_tc, zero), w2));
-                    sum_hi = _mm_add_epi16(sum_hi, _mm_mullo_epi16(_mm_unpackhi_epi8(p8_tr, zero), w1));
-                    sum_hi = _mm_add_epi16(sum_hi, _mm_mullo_epi16(_mm_unpackhi_epi8(p8_ml, zero), w2));
-                    sum_hi = _mm_add_epi16(sum_hi, _mm_mullo_epi16(_mm_unpackhi_epi8(p8_mc, zero), w4));
-                    sum_hi = _mm_add_epi16(sum_hi, _mm_mullo_epi16(_mm_unpackhi_epi8(p8_mr, zero), w2));
-                    sum_hi = _mm_add_epi16(sum_hi, _mm_mullo_epi16(_mm_unpackhi_epi8(p8_bl, zero), w1));
-                    sum_hi = _mm_add_epi16(sum_hi, _mm_mullo_epi16(_mm_unpackhi_epi8(p8_bc, zero), w2));
-                    sum_hi = _mm_add_epi16(sum_hi, _mm_mullo_epi16(_mm_unpackhi_epi8(p8_br, zero), w1));
-                    __m128i avg_hi = _mm_srli_epi16(sum_hi, 4);
-
-                    _mm_storeu_si128(reinterpret_cast<__m128i*>(pixelData + y * stride + x), _mm_packus_epi16(avg_lo, avg_hi));
-                }
+                for (int i = 0; i < 4; ++i) _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 4), acc.sum[i]);
+            }
 
-                for (int x = vectorizedWidth; x < width - 1; ++x) {
-                    if (x > 0) {
-                        int sum = 0;
-                        int kernel[9] = { 1, 2, 1, 2, 4, 2, 1, 2, 1 };
-                        int k_idx = 0;
-                        for (int j = -1; j <= 1; ++j) {
-                            for (int i = -1; i <= 1; ++i) {
-                                sum += sourceBuffer[(y + j) * stride + (x + i)] * kernel[k_idx++];
-                            }
-                        }
-                        pixelData[y * stride + x] = static_cast<unsigned char>(sum / 16);
-                    }
-                }
+            // int32 -> int16 -> uint8 with signed then unsigned saturation, i.e. clamp to 0..255
+            static void PackSums(const int* sums, int shift, unsigned char* out)
+            {
+                const __m128i count = _mm_cvtsi32_si128(shift);
+                __m128i v[4];
+                for (int i = 0; i < 4; ++i) v[i] = _mm_sra_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(sums + i * 4)), count);
+                Store(out, _mm_packus_epi16(_mm_packs_epi32(v[0], v[1]), _mm_packs_epi32(v[2], v[3])));
             }
-            delete[] sourceBuffer;
-        }
+        };
 
-        void ApplyDifferentialSse(void* pixels, int width, int height, int stride, unsigned char threshold)
+        // FFTBatchLanes floats as two XMM registers
+        struct Sse2Float
         {
-            unsigned char* pixelData = static_cast<unsigned char*>(pixels);
-            unsigned char* sourceBuffer = new unsigned char[height * stride]; // readonly Buffer !!!
-            memcpy(sourceBuffer, pixelData, height * stride);
-
-            const int vectorSize = 16;
-            int vectorizedWidth = width - (width % vectorSize);
-
-            for (int y = 0; y < height - 1; ++y)
+            struct Vector { __m128 low, high; };
+
+            static Vector Load(const float* p) { return { _mm_loadu_ps(p), _mm_loadu_ps(p + 4) }; }
+            static void Store(float* p, Vector v) { _mm_storeu_ps(p, v.low); _mm_storeu_ps(p + 4, v.high); }
+            static Vector Broadcast(float value) { return { _mm_set1_ps(value), _mm_set1_ps(value) }; }
+            static Vector Add(Vector a, Vector b) { return { _mm_add_ps(a.low, b.low), _mm_add_ps(a.high, b.high) }; }
+            static Vector Sub(Vector a, Vector b) { return { _mm_sub_ps(a.low, b.low), _mm_sub_ps(a.high, b.high) }; }
+            static Vector Mul(Vector a, Vector b) { return { _mm_mul_ps(a.low, b.low), _mm_mul_ps(a.high, b.high) }; }
+            static Vector Min(Vector a, Vector b) { return { _mm_min_ps(a.low, b.low), _mm_min_ps(a.high, b.high) }; }
+            static Vector Max(Vector a, Vector b) { return { _mm_max_ps(a.low, b.low), _mm_max_ps(a.high, b.high) }; }
+            static Vector Less(Vector a, Vector b) { return { _mm_cmplt_ps(a.low, b.low), _mm_cmplt_ps(a.high, b.high) }; }
+            // mask ? b : a, without SSE4.1 blendv
+            static Vector Blend(Vector a, Vector b, Vector mask)
             {
-                for (int x = 0; x < vectorizedWidth; x += vectorSize)
-                {
-                    __m128i p_center = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + y * stride + x));
-                    __m128i p_right = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + y * stride + (x + 1)));
-                    __m128i p_down = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + (y + 1) * stride + x));
-
-                    // Calculate absolute differences using saturated subtraction
-                    __m128i diff_x = _mm_adds_epu8(_mm_subs_epu8(p_right, p_center), _mm_subs_epu8(p_center, p_right));
-                    __m128i diff_y = _mm_adds_epu8(_mm_subs_epu8(p_down, p_center), _mm_subs_epu8(p_center, p_down));
+                return { _mm_or_ps(_mm_and_ps(mask.low, b.low), _mm_andnot_ps(mask.low, a.low)),
+                    _mm_or_ps(_mm_and_ps(mask.high, b.high), _mm_andnot_ps(mask.high, a.high)) };
+            }
+            static Vector LoadBytes(const unsigned char* p)
+            {
+                const __m128i zero = _mm_setzero_si128();
+                __m128i words = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)), zero);
+                return { _mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero)), _mm_cvtepi32_ps(_mm_unpackhi_epi16(words, zero)) };
+            }
+        };
 
-                    __m128i sum = _mm_adds_epu8(diff_x, diff_y);
+        int OddKernelSize(int kernelSize)
+        {
+            if (kernelSize < 1) return 1;
+            return (kernelSize % 2 == 0) ? kernelSize + 1 : kernelSize;
+        }
 
-                    // Apply threshold
-                    _mm_storeu_si128(reinterpret_cast<__m128i*>(pixelData + y * stride + x), sum);
+        // KxK kernel in fixed point, floored and clamped to 0..255, in place
+        void ConvolveSimd(unsigned char* pixelData, int width, int height, int stride,
+            const std::vector<double>& kernel, int kernelSize, double scale)
+        {
+            QuantizedKernel quantized;
+            if (!QuantizeKernel(kernel, kernelSize, scale, quantized)) {
+                // weights too large for int16, the double path normalizes by the kernel sum itself
+                ApplyConvolution(pixelData, pixelData, width, height, stride, kernel, kernelSize);
+                return;
+            }
+            std::vector<QuantizedTapPair> pairs = BuildTapPairs(quantized, 1);
+            int fractionBits = quantized.fractionBits;
+            const SimdKernelTable& simd = ActiveSimdKernels();
+
+            ForEachTile(pixelData, pixelData, width, height, stride, 1, kernelSize / 2, [&](const PaddedImage& padded, unsigned char* tileDest) {
+                int tileWidth = padded.Width();
+                int tileHeight = padded.Height();
+                #pragma omp parallel
+                {
+                    std::vector<int> sums(tileWidth);
+                    #pragma omp for
+                    for (int y = 0; y < tileHeight; ++y) {
+                        simd.ConvolveRow(padded, y, pairs.data(), static_cast<int>(pairs.size()), sums.data());
+                        simd.PackRow(sums.data(), fractionBits, tileWidth, tileDest + y * stride);
+                    }
                 }
+            });
+        }
 
-                for (int x = vectorizedWidth; x < width - 1; ++x)
+        // Square KxK max / min as a vertical pass over K padded rows, then K shifted reads of that row
+        template <bool isMax>
+        void MorphologySimd(unsigned char* pixelData, int width, int height, int stride, int kernelSize)
+        {
+            int center = kernelSize / 2;
+            const SimdKernelTable& simd = ActiveSimdKernels();
+
+            ForEachTile(pixelData, pixelData, width, height, stride, 1, center, [&](const PaddedImage& padded, unsigned char* tileDest) {
+                int tileWidth = padded.Width();
+                int tileHeight = padded.Height();
+                int paddedWidth = tileWidth + 2 * center;
+                #pragma omp parallel
                 {
-                    int gradX = (int)sourceBuffer[y * stride + (x + 1)] - (int)sourceBuffer[y * stride + x];
-                    int gradY = (int)sourceBuffer[(y + 1) * stride + x] - (int)sourceBuffer[y * stride + x];
-                    int val = abs(gradX) + abs(gradY);
-                    // Clamp val to 0-255
-                    if (val > 255) val = 255;
-                    if (val < 0) val = 0; // abs ensures >= 0, but good practice
-                    pixelData[y * stride + x] = static_cast<unsigned char>(val);
+                    std::vector<const unsigned char*> sources(kernelSize);
+                    std::vector<unsigned char> columnExtremum(paddedWidth);
+                    #pragma omp for
+                    for (int y = 0; y < tileHeight; ++y) {
+                        for (int k = 0; k < kernelSize; ++k) sources[k] = padded.Row(y + k - center) - center;
+                        if (isMax) simd.MaxRows(sources.data(), kernelSize, paddedWidth, columnExtremum.data());
+                        else simd.MinRows(sources.data(), kernelSize, paddedWidth, columnExtremum.data());
+
+                        for (int k = 0; k < kernelSize; ++k) sources[k] = columnExtremum.data() + k;
+                        if (isMax) simd.MaxRows(sources.data(), kernelSize, tileWidth, tileDest + y * stride);
+                        else simd.MinRows(sources.data(), kernelSize, tileWidth, tileDest + y * stride);
+                    }
                 }
-            }
+            });
+        }
+    }
+
+    const SimdKernelTable& Sse2Kernels()
+    {
+        static const SimdKernelTable table = MakeKernelTable<Sse2, Sse2Float>(SimdLevel::Sse2);
+        return table;
+    }
+
+    namespace SSE
+    {
+        // The fixed 3x3 entry points keep their signatures and forward to the kernel-size versions.
+        // Every filter runs on the backend picked at DLL load (AVX-512 / AVX2 / SSE2 / scalar)
+        // The running-sum box filter: exact integer window sums floored once, where K*K rounded
+        // Q15 weights of 1 / (K*K) would drift by several gray levels at large K
+        void ApplyAverageBlurSse(void* pixels, int width, int height, int stride, int kernelSize)
+        {
+            ApplyAverageBlur_CPU(pixels, width, height, stride, OddKernelSize(kernelSize), false);
+        }
 
-            delete[] sourceBuffer;
+        void ApplyGaussianBlurSse(void* pixels, int width, int height, int stride, double sigma, int kernelSize)
+        {
+            kernelSize = OddKernelSize(kernelSize);
+            // callers of the old 3x3 version passed anything for sigma
+            if (sigma <= 0) sigma = 0.3 * ((kernelSize - 1) * 0.5 - 1) + 0.8;
+            std::vector<double> kernel = createGaussianKernel(kernelSize, sigma, false);
+            ConvolveSimd(static_cast<unsigned char*>(pixels), width, height, stride, kernel, kernelSize, 1.0);
         }
 
-        void ApplySobelSse(void* pixels, int width, int height, int stride, unsigned char threshold)
+        void ApplyDifferentialSse(void* pixels, int width, int height, int stride, unsigned char threshold)
         {
             unsigned char* pixelData = static_cast<unsigned char*>(pixels);
-            unsigned char* sourceBuffer = new unsigned char[height * stride];
-            memcpy(sourceBuffer, pixelData, height * stride);
-
-            const int vectorSize = 16;
-            int vectorizedWidth = width - (width % vectorSize);
-            __m128i zero = _mm_setzero_si128();
+            const SimdKernelTable& simd = ActiveSimdKernels();
 
-            for (int y = 1; y < height - 1; ++y)
-            {
-                for (int x = 1; x < vectorizedWidth - 1; x += vectorSize)
-                {
-                    // Load 8-bit pixel blocks
-                    __m128i p8_tl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + (y - 1) * stride + (x - 1)));
-                    __m128i p8_tc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + (y - 1) * stride + x));
-                    __m128i p8_tr = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + (y - 1) * stride + (x + 1)));
-                    __m128i p8_ml = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + y * stride + (x - 1)));
-                    __m128i p8_mr = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + y * stride + (x + 1)));
-                    __m128i p8_bl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + (y + 1) * stride + (x - 1)));
-                    __m128i p8_bc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + (y + 1) * stride + x));
-                    __m128i p8_br = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + (y + 1) * stride + (x + 1)));
-
-                    // Process low 8 pixels
-                    __m128i p16_tl_lo = _mm_unpacklo_epi8(p8_tl, zero);
-                    __m128i p16_tc_lo = _mm_unpacklo_epi8(p8_tc, zero);
-                    __m128i p16_tr_lo = _mm_unpacklo_epi8(p8_tr, zero);
-                    __m128i p16_ml_lo = _mm_unpacklo_epi8(p8_ml, zero);
-                    __m128i p16_mr_lo = _mm_unpacklo_epi8(p8_mr, zero);
-                    __m128i p16_bl_lo = _mm_unpacklo_epi8(p8_bl, zero);
-                    __m128i p16_bc_lo = _mm_unpacklo_epi8(p8_bc, zero);
-                    __m128i p16_br_lo = _mm_unpacklo_epi8(p8_br, zero);
-
-                    __m128i gx_lo = _mm_sub_epi16(p16_tr_lo, p16_tl_lo);
-                    gx_lo = _mm_add_epi16(gx_lo, _mm_slli_epi16(p16_mr_lo, 1));
-                    gx_lo = _mm_sub_epi16(gx_lo, _mm_slli_epi16(p16_ml_lo, 1));
-                    gx_lo = _mm_add_epi16(gx_lo, _mm_sub_epi16(p16_br_lo, p16_bl_lo));
-
-                    __m128i gy_lo = _mm_sub_epi16(p16_bl_lo, p16_tl_lo);
-                    gy_lo = _mm_add_epi16(gy_lo, _mm_slli_epi16(p16_bc_lo, 1));
-                    gy_lo = _mm_sub_epi16(gy_lo, _mm_slli_epi16(p16_tc_lo, 1));
-                    gy_lo = _mm_add_epi16(gy_lo, _mm_sub_epi16(p16_br_lo, p16_tr_lo));
-
-                    // Process high 8 pixels
-                    __m128i p16_tl_hi = _mm_unpackhi_epi8(p8_tl, zero);
-                    __m128i p16_tc_hi = _mm_unpackhi_epi8(p8_tc, zero);
-                    __m128i p16_tr_hi = _mm_unpackhi_epi8(p8_tr, zero);
-                    __m128i p16_ml_hi = _mm_unpackhi_epi8(p8_ml, zero);
-                    __m128i p16_mr_hi = _mm_unpackhi_epi8(p8_mr, zero);
-                    __m128i p16_bl_hi = _mm_unpackhi_epi8(p8_bl, zero);
-                    __m128i p16_bc_hi = _mm_unpackhi_epi8(p8_bc, zero);
-                    __m128i p16_br_hi = _mm_unpackhi_epi8(p8_br, zero);
-
-                    __m128i gx_hi = _mm_sub_epi16(p16_tr_hi, p16_tl_hi);
-                    gx_hi = _mm_add_epi16(gx_hi, _mm_slli_epi16(p16_mr_hi, 1));
-                    gx_hi = _mm_sub_epi16(gx_hi, _mm_slli_epi16(p16_ml_hi, 1));
-                    gx_hi = _mm_add_epi16(gx_hi, _mm_sub_epi16(p16_br_hi, p16_bl_hi));
-
-                    __m128i gy_hi = _mm_sub_epi16(p16_bl_hi, p16_tl_hi);
-                    gy_hi = _mm_add_epi16(gy_hi, _mm_slli_epi16(p16_bc_hi, 1));
-                    gy_hi = _mm_sub_epi16(gy_hi, _mm_slli_epi16(p16_tc_hi, 1));
-                    gy_hi = _mm_add_epi16(gy_hi, _mm_sub_epi16(p16_br_hi, p16_tr_hi));
-
-                    __m128i sum_lo = _mm_add_epi16(_mm_abs_epi16(gx_lo), _mm_abs_epi16(gy_lo));
-                    __m128i sum_hi = _mm_add_epi16(_mm_abs_epi16(gx_hi), _mm_abs_epi16(gy_hi));
-
-                    _mm_storeu_si128(reinterpret_cast<__m128i*>(pixelData + y * stride + x), _mm_packus_epi16(sum_lo, sum_hi));
+            ForEachTile(pixelData, pixelData, width, height, stride, 1, 1, [&](const PaddedImage& padded, unsigned char* tileDest) {
+                #pragma omp parallel for
+                for (int y = 0; y < padded.Height(); ++y) {
+                    simd.DifferentialRow(padded.Row(y), padded.Row(y + 1), padded.Width(), tileDest + y * stride);
                 }
+            });
+        }
 
-                // Process remaining pixels
-                for (int x = vectorizedWidth; x < width - 1; ++x) {
-                    if (x > 0) {
-                        int gx = (sourceBuffer[(y - 1) * stride + (x + 1)] + 2 * sourceBuffer[y * stride + (x + 1)] + sourceBuffer[(y + 1) * stride + (x + 1)]) - (sourceBuffer[(y - 1) * stride + (x - 1)] + 2 * sourceBuffer[y * stride + (x - 1)] + sourceBuffer[(y + 1) * stride + (x - 1)]);
-                        int gy = (sourceBuffer[(y + 1) * stride + (x - 1)] + 2 * sourceBuffer[(y + 1) * stride + x] + sourceBuffer[(y + 1) * stride + (x + 1)]) - (sourceBuffer[(y - 1) * stride + (x - 1)] + 2 * sourceBuffer[(y - 1) * stride + x] + sourceBuffer[(y - 1) * stride + (x + 1)]);
-                        int sum = abs(gx) + abs(gy);
-                        if (sum > 255) sum = 255;
-                        pixelData[y * stride + x] = static_cast<unsigned char>(sum);
-                    }
-                }
-            }
-            delete[] sourceBuffer;
+        void ApplySobelSse(void* pixels, int width, int height, int stride, unsigned char threshold)
+        {
+            ApplySobelSseEx(pixels, width, height, stride, 3);
         }
 
-        void ApplyLaplacianSse(void* pixels, int width, int height, int stride, unsigned char threshold)
+        // |Gx| + |Gy|, kernels from createSobelKernelX/Y scaled by 2 so 3x3 is the integer [1 2 1] Sobel
+        void ApplySobelSseEx(void* pixels, int width, int height, int stride, int kernelSize)
         {
+            kernelSize = OddKernelSize(kernelSize);
             unsigned char* pixelData = static_cast<unsigned char*>(pixels);
-            unsigned char* sourceBuffer = new unsigned char[height * stride];
-            memcpy(sourceBuffer, pixelData, height * stride);
-
-            const int vectorSize = 16;
-            int vectorizedWidth = width - (width % vectorSize);
-            __m128i zero = _mm_setzero_si128();
-            const __m128i w_neg_8 = _mm_set1_epi16(-8);
-
-            for (int y = 1; y < height - 1; ++y)
-            {
-                for (int x = 1; x < vectorizedWidth - 1; x += vectorSize)
+            QuantizedKernel quantizedX, quantizedY;
+            if (!QuantizeKernel(createSobelKernelX(kernelSize), kernelSize, 2.0, quantizedX)
+                || !QuantizeKernel(createSobelKernelY(kernelSize), kernelSize, 2.0, quantizedY)) {
+                ApplySobel_CPU(pixels, width, height, stride, kernelSize);
+                return;
+            }
+            std::vector<QuantizedTapPair> pairsX = BuildTapPairs(quantizedX, 1);
+            std::vector<QuantizedTapPair> pairsY = BuildTapPairs(quantizedY, 1);
+            // X and Y are transposes of each other, so both get the same fractionBits
+            int fractionBits = quantizedX.fractionBits;
+            const SimdKernelTable& simd = ActiveSimdKernels();
+
+            ForEachTile(pixelData, pixelData, width, height, stride, 1, kernelSize / 2, [&](const PaddedImage& padded, unsigned char* tileDest) {
+                int tileWidth = padded.Width();
+                int tileHeight = padded.Height();
+                #pragma omp parallel
                 {
-                    __m128i p8_tl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + (y - 1) * stride + (x - 1)));
-                    __m128i p8_tc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + (y - 1) * stride + x));
-                    __m128i p8_tr = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + (y - 1) * stride + (x + 1)));
-                    __m128i p8_ml = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + y * stride + (x - 1)));
-                    __m128i p8_mc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + y * stride + x));
-                    __m128i p8_mr = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + y * stride + (x + 1)));
-                    __m128i p8_bl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + (y + 1) * stride + (x - 1)));
-                    __m128i p8_bc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + (y + 1) * stride + x));
-                    __m128i p8_br = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + (y + 1) * stride + (x + 1)));
-
-                    // Process low 8 pixels
-                    __m128i sum_lo = _mm_add_epi16(_mm_unpacklo_epi8(p8_tl, zero), _mm_unpacklo_epi8(p8_tc, zero));
-                    sum_lo = _mm_add_epi16(sum_lo, _mm_unpacklo_epi8(p8_tr, zero));
-                    sum_lo = _mm_add_epi16(sum_lo, _mm_unpacklo_epi8(p8_ml, zero));
-                    sum_lo = _mm_add_epi16(sum_lo, _mm_unpacklo_epi8(p8_mr, zero));
-                    sum_lo = _mm_add_epi16(sum_lo, _mm_unpacklo_epi8(p8_bl, zero));
-                    sum_lo = _mm_add_epi16(sum_lo, _mm_unpacklo_epi8(p8_bc, zero));
-                    sum_lo = _mm_add_epi16(sum_lo, _mm_unpacklo_epi8(p8_br, zero));
-                    __m128i center_term_lo = _mm_mullo_epi16(_mm_unpacklo_epi8(p8_mc, zero), w_neg_8);
-                    sum_lo = _mm_add_epi16(sum_lo, center_term_lo);
-                    sum_lo = _mm_max_epi16(sum_lo, zero); // Clamp to 0
-
-                    // Process high 8 pixels
-                    __m128i sum_hi = _mm_add_epi16(_mm_unpackhi_epi8(p8_tl, zero), _mm_unpackhi_epi8(p8_tc, zero));
-                    sum_hi = _mm_add_epi16(sum_hi, _mm_unpackhi_epi8(p8_tr, zero));
-                    sum_hi = _mm_add_epi16(sum_hi, _mm_unpackhi_epi8(p8_ml, zero));
-                    sum_hi = _mm_add_epi16(sum_hi, _mm_unpackhi_epi8(p8_mr, zero));
-                    sum_hi = _mm_add_epi16(sum_hi, _mm_unpackhi_epi8(p8_bl, zero));
-                    sum_hi = _mm_add_epi16(sum_hi, _mm_unpackhi_epi8(p8_bc, zero));
-                    sum_hi = _mm_add_epi16(sum_hi, _mm_unpackhi_epi8(p8_br, zero));
-                    __m128i center_term_hi = _mm_mullo_epi16(_mm_unpackhi_epi8(p8_mc, zero), w_neg_8);
-                    sum_hi = _mm_add_epi16(sum_hi, center_term_hi);
-                    sum_hi = _mm_max_epi16(sum_hi, zero); // Clamp to 0
-
-                    _mm_storeu_si128(reinterpret_cast<__m128i*>(pixelData + y * stride + x), _mm_packus_epi16(sum_lo, sum_hi));
-                }
-
-                for (int x = vectorizedWidth; x < width - 1; ++x) {
-                    if (x > 0) {
-                        int sum = 0;
-                        int kernel[9] = { 1, 1, 1, 1, -8, 1, 1, 1, 1 };
-                        int k_idx = 0;
-                        for (int j = -1; j <= 1; ++j) {
-                            for (int i = -1; i <= 1; ++i) {
-                                sum += (int)sourceBuffer[(y + j) * stride + (x + i)] * kernel[k_idx++];
-                            }
-                        }
-                        if (sum < 0) sum = 0;
-                        if (sum > 255) sum = 255;
-                        pixelData[y * stride + x] = static_cast<unsigned char>(sum);
+                    std::vector<int> sumsX(tileWidth), sumsY(tileWidth);
+                    #pragma omp for
+                    for (int y = 0; y < tileHeight; ++y) {
+                        simd.ConvolveRow(padded, y, pairsX.data(), static_cast<int>(pairsX.size()), sumsX.data());
+                        simd.ConvolveRow(padded, y, pairsY.data(), static_cast<int>(pairsY.size()), sumsY.data());
+                        for (int x = 0; x < tileWidth; ++x) sumsX[x] = abs(sumsX[x]) + abs(sumsY[x]);
+                        simd.PackRow(sumsX.data(), fractionBits, tileWidth, tileDest + y * stride);
                     }
                 }
-            }
-            delete[] sourceBuffer;
+            });
         }
 
-        void ApplyDilationSse(void* pixels, int width, int height, int stride, unsigned char threshold)
+        void ApplyLaplacianSse(void* pixels, int width, int height, int stride, unsigned char threshold)
         {
-            unsigned char* pixelData = static_cast<unsigned char*>(pixels);
-            unsigned char* sourceBuffer = new unsigned char[height * stride];
-            memcpy(sourceBuffer, pixelData, height * stride);
+            ApplyLaplacianSseEx(pixels, width, height, stride, 3);
+        }
 
-            const int vectorSize = 16;
-            int vectorizedWidth = width - (width % vectorSize);
+        void ApplyLaplacianSseEx(void* pixels, int width, int height, int stride, int kernelSize)
+        {
+            kernelSize = OddKernelSize(kernelSize);
+            std::vector<double> kernel = createLaplacianKernel(kernelSize);
+            ConvolveSimd(static_cast<unsigned char*>(pixels), width, height, stride, kernel, kernelSize, 1.0);
+        }
 
-            for (int y = 1; y < height - 1; ++y)
-            {
-                for (int x = 1; x < vectorizedWidth - 1; x += vectorSize)
-                {
-                    __m128i max_val = _mm_setzero_si128();
-                    for (int j = -1; j <= 1; ++j) {
-                        for (int i = -1; i <= 1; ++i) {
-                            __m128i neighbor = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + (y + j) * stride + (x + i)));
-                            max_val = _mm_max_epu8(max_val, neighbor);
-                        }
-                    }
-                    _mm_storeu_si128(reinterpret_cast<__m128i*>(pixelData + y * stride + x), max_val);
-                }
+        void ApplyDilationSse(void* pixels, int width, int height, int stride, unsigned char threshold)
+        {
+            ApplyDilationSseEx(pixels, width, height, stride, 3);
+        }
 
-                for (int x = vectorizedWidth; x < width - 1; ++x) {
-                    if (x > 0) {
-                        unsigned char maxVal = 0;
-                        for (int j = -1; j <= 1; ++j) {
-                            for (int i = -1; i <= 1; ++i) {
-                                unsigned char neighborPixel = sourceBuffer[(y + j) * stride + (x + i)];
-                                if (neighborPixel > maxVal) {
-                                    maxVal = neighborPixel;
-                                }
-                            }
-                        }
-                        pixelData[y * stride + x] = maxVal;
-                    }
-                }
-            }
-            delete[] sourceBuffer;
+        void ApplyDilationSseEx(void* pixels, int width, int height, int stride, int kernelSize)
+        {
+            MorphologySimd<true>(static_cast<unsigned char*>(pixels), width, height, stride, OddKernelSize(kernelSize));
         }
 
         void ApplyErosionSse(void* pixels, int width, int height, int stride, unsigned char threshold)
         {
-            unsigned char* pixelData = static_cast<unsigned char*>(pixels);
-            unsigned char* sourceBuffer = new unsigned char[height * stride];
-            memcpy(sourceBuffer, pixelData, height * stride);
-
-            const int vectorSize = 16;
-            int vectorizedWidth = width - (width % vectorSize);
-
-            for (int y = 1; y < height - 1; ++y)
-            {
-                for (int x = 1; x < vectorizedWidth - 1; x += vectorSize)
-                {
-                    __m128i min_val = _mm_set1_epi8(-1); // Initialize with 255
-                    for (int j = -1; j <= 1; ++j) {
-                        for (int i = -1; i <= 1; ++i) {
-                            __m128i neighbor = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceBuffer + (y + j) * stride + (x + i)));
-                            min_val = _mm_min_epu8(min_val, neighbor);
-                        }
-                    }
-                    _mm_storeu_si128(reinterpret_cast<__m128i*>(pixelData + y * stride + x), min_val);
-                }
+            ApplyErosionSseEx(pixels, width, height, stride, 3);
+        }
 
-                for (int x = vectorizedWidth; x < width - 1; ++x) {
-                    if (x > 0) {
-                        unsigned char minVal = 255;
-                        for (int j = -1; j <= 1; ++j) {
-                            for (int i = -1; i <= 1; ++i) {
-                                unsigned char neighborPixel = sourceBuffer[(y + j) * stride + (x + i)];
-                                if (neighborPixel < minVal) {
-                                    minVal = neighborPixel;
-                                }
-                            }
-                        }
-                        pixelData[y * stride + x] = minVal;
-                    }
-                }
-            }
-            delete[] sourceBuffer;
+        void ApplyErosionSseEx(void* pixels, int width, int height, int stride, int kernelSize)
+        {
+            MorphologySimd<false>(static_cast<unsigned char*>(pixels), width, height, stride, OddKernelSize(kernelSize));
         }
     }
 }
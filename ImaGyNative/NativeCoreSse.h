@@ -19,5 +19,11 @@ namespace ImaGyNative
 
         extern "C" IMAGYNATIVE_API void ApplyDilationSse(void* pixels, int width, int height, int stride, unsigned char threshold);
         extern "C" IMAGYNATIVE_API void ApplyErosionSse(void* pixels, int width, int height, int stride, unsigned char threshold);
+
+        // Arbitrary odd kernel sizes, the entry points above are the 3x3 case
+        extern "C" IMAGYNATIVE_API void ApplySobelSseEx(void* pixels, int width, int height, int stride, int kernelSize);
+        extern "C" IMAGYNATIVE_API void ApplyLaplacianSseEx(void* pixels, int width, int height, int stride, int kernelSize);
+        extern "C" IMAGYNATIVE_API void ApplyDilationSseEx(void* pixels, int width, int height, int stride, int kernelSize);
+        extern "C" IMAGYNATIVE_API void ApplyErosionSseEx(void* pixels, int width, int height, int stride, int kernelSize);
     }
 }
@@ -0,0 +1,250 @@
+#include "pch.h"
+#include "NativeCore.h"
+#include "ImageProcessingUtils.h"
+#include "CPUImageProcessor.h"
+#include "BorderHandling.h"
+#include "TileScheduler.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <vector>
+#include <omp.h>
+
+namespace ImaGyNative
+{
+    namespace
+    {
+        // One recorded operator. Neighborhood stages have a tile filter, per-pixel stages a lookup table,
+        // Otsu binarization gets its table at Execute time
+        struct Stage {
+            int radius;
+            TileFilter filter;
+            std::vector<unsigned char> table;
+            bool isOtsu;
+        };
+
+        // A neighborhood filter followed by the per-pixel stages recorded after it, as one table.
+        // filter is empty when the chain starts with per-pixel stages (plain copy), table is empty
+        // when no per-pixel stage follows
+        struct Step {
+            int radius;
+            TileFilter filter;
+            std::vector<unsigned char> table;
+        };
+
+        std::vector<unsigned char> IdentityTable()
+        {
+            std::vector<unsigned char> table(256);
+            for (int i = 0; i < 256; ++i) table[i] = static_cast<unsigned char>(i);
+            return table;
+        }
+
+        void ApplyTable(const std::vector<unsigned char>& table, unsigned char* pixels, int width, int height, int stride)
+        {
+            for (int y = 0; y < height; ++y) {
+                unsigned char* row = pixels + (size_t)y * stride;
+                for (int x = 0; x < width; ++x) row[x] = table[row[x]];
+            }
+        }
+
+        // Re-applies the border policy to the part of an intermediate result that lies outside the image,
+        // so the next stage sees exactly what a separate call would have padded.
+        // The buffer holds image pixels [originX, originX + width) x [originY, originY + height)
+        void RestoreBorder(unsigned char* pixels, int stride, int originX, int originY, int width, int height,
+            int imageWidth, int imageHeight, BorderPolicy policy)
+        {
+            if (originX >= 0 && originY >= 0 && originX + width <= imageWidth && originY + height <= imageHeight) return;
+
+            for (int y = 0; y < height; ++y) {
+                int imageY = originY + y;
+                if (imageY < 0 || imageY >= imageHeight) continue;
+                unsigned char* row = pixels + (size_t)y * stride;
+                for (int x = 0; x < width; ++x) {
+                    int imageX = originX + x;
+                    if (imageX >= 0 && imageX < imageWidth) continue;
+                    int sourceX = BorderIndex(imageX, imageWidth, policy.mode);
+                    row[x] = (sourceX < 0) ? policy.constantValue : row[sourceX - originX];
+                }
+            }
+            for (int y = 0; y < height; ++y) {
+                int imageY = originY + y;
+                if (imageY >= 0 && imageY < imageHeight) continue;
+                int sourceY = BorderIndex(imageY, imageHeight, policy.mode);
+                unsigned char* row = pixels + (size_t)y * stride;
+                if (sourceY < 0) memset(row, policy.constantValue, width);
+                else memcpy(row, pixels + (size_t)(sourceY - originY) * stride, width);
+            }
+        }
+
+        // Runs stages without a histogram dependency as one tiled pass over the image
+        void ExecuteSegment(const std::vector<const Stage*>& stages, unsigned char* pixels, int width, int height, int stride)
+        {
+            std::vector<Step> steps;
+            for (const Stage* stage : stages) {
+                if (stage->filter) {
+                    steps.push_back({ stage->radius, stage->filter, {} });
+                    continue;
+                }
+                if (steps.empty()) steps.push_back({ 0, TileFilter(), {} });
+                std::vector<unsigned char>& table = steps.back().table;
+                if (table.empty()) table = IdentityTable();
+                for (int i = 0; i < 256; ++i) table[i] = stage->table[table[i]];
+            }
+            if (steps.empty()) return;
+
+            if (steps.size() == 1 && !steps[0].filter) {
+                #pragma omp parallel for
+                for (int y = 0; y < height; ++y) ApplyTable(steps[0].table, pixels + (size_t)y * stride, width, 1, stride);
+                return;
+            }
+
+            int totalRadius = 0;
+            for (const Step& step : steps) totalRadius += step.radius;
+            BorderPolicy policy = GetBorderPolicy();
+
+            // two intermediate tiles per thread, stage i writes straight into the padded input of stage i + 1
+            std::vector<std::array<PaddedImage, 2>> buffers(omp_get_max_threads());
+
+            ForEachTile(pixels, pixels, width, height, stride, 1, totalRadius, [&](PaddedImage& tile, unsigned char* tileDest) {
+                // tile origin in the image, for the border fix-up of intermediate results
+                size_t offset = tileDest - pixels;
+                int tileX = static_cast<int>(offset % stride);
+                int tileY = static_cast<int>(offset / stride);
+                std::array<PaddedImage, 2>& scratch = buffers[omp_get_thread_num()];
+
+                // extent: how far the current stage's output reaches past the tile on every side
+                int extent = totalRadius - steps[0].radius;
+                tile.Expand(extent);
+                PaddedImage* input = &tile;
+                for (size_t i = 0; i < steps.size(); ++i) {
+                    const Step& step = steps[i];
+                    int outputWidth = input->Width();
+                    int outputHeight = input->Height();
+                    unsigned char* dest = tileDest;
+                    int destStride = stride;
+                    PaddedImage* output = nullptr;
+                    if (i + 1 < steps.size()) {
+                        int nextRadius = steps[i + 1].radius;
+                        output = &scratch[i % 2];
+                        output->Resize(outputWidth - 2 * nextRadius, outputHeight - 2 * nextRadius, 1, nextRadius);
+                        dest = output->MutableRow(-nextRadius) - nextRadius;
+                        destStride = output->PaddedStride();
+                    }
+
+                    if (step.filter) {
+                        step.filter(*input, dest, destStride);
+                    }
+                    else {
+                        for (int y = 0; y < outputHeight; ++y) memcpy(dest + (size_t)y * destStride, input->Row(y), outputWidth);
+                    }
+                    if (!step.table.empty()) ApplyTable(step.table, dest, outputWidth, outputHeight, destStride);
+
+                    if (output != nullptr) {
+                        RestoreBorder(dest, destStride, tileX - extent, tileY - extent, outputWidth, outputHeight, width, height, policy);
+                        extent -= steps[i + 1].radius;
+                        input = output;
+                    }
+                }
+            });
+        }
+    }
+
+    struct Pipeline::Impl {
+        std::vector<Stage> stages;
+    };
+
+    Pipeline::Pipeline() : impl(new Impl())
+    {
+    }
+
+    Pipeline::~Pipeline()
+    {
+        delete impl;
+    }
+
+    void Pipeline::AddGaussianBlur(double sigma, int kernelSize, bool useCircularKernel)
+    {
+        if (kernelSize % 2 == 0) kernelSize++;
+        impl->stages.push_back({ kernelSize / 2, MakeGaussianBlurFilter(sigma, kernelSize, useCircularKernel), {}, false });
+    }
+
+    void Pipeline::AddAverageBlur(int kernelSize, bool useCircularKernel)
+    {
+        if (kernelSize % 2 == 0) kernelSize++;
+        impl->stages.push_back({ kernelSize / 2, MakeAverageBlurFilter(kernelSize, useCircularKernel), {}, false });
+    }
+
+    void Pipeline::AddDifferential()
+    {
+        impl->stages.push_back({ 1, MakeDifferentialFilter(), {}, false });
+    }
+
+    void Pipeline::AddSobel(int kernelSize)
+    {
+        if (kernelSize % 2 == 0) kernelSize++;
+        impl->stages.push_back({ kernelSize / 2, MakeSobelFilter(kernelSize), {}, false });
+    }
+
+    void Pipeline::AddLaplacian(int kernelSize)
+    {
+        if (kernelSize % 2 == 0) kernelSize++;
+        impl->stages.push_back({ kernelSize / 2, MakeLaplacianFilter(kernelSize), {}, false });
+    }
+
+    void Pipeline::AddDilation(int kernelSize, bool useCircularKernel)
+    {
+        if (kernelSize % 2 == 0) kernelSize++;
+        impl->stages.push_back({ kernelSize / 2, MakeDilationFilter(kernelSize, useCircularKernel), {}, false });
+    }
+
+    void Pipeline::AddErosion(int kernelSize, bool useCircularKernel)
+    {
+        if (kernelSize % 2 == 0) kernelSize++;
+        impl->stages.push_back({ kernelSize / 2, MakeErosionFilter(kernelSize, useCircularKernel), {}, false });
+    }
+
+    // Same rule as ApplyBinarization_CPU, threshold -1 picks Otsu on the stage input
+    void Pipeline::AddBinarization(int threshold)
+    {
+        std::vector<unsigned char> table(256);
+        for (int i = 0; i < 256; ++i) table[i] = (i > threshold) ? 255 : 0;
+        impl->stages.push_back({ 0, TileFilter(), table, threshold == -1 });
+    }
+
+    void Pipeline::AddAdjBrightness(int value)
+    {
+        std::vector<unsigned char> table(256);
+        for (int i = 0; i < 256; ++i) table[i] = static_cast<unsigned char>(std::max(0, std::min(255, i + value)));
+        impl->stages.push_back({ 0, TileFilter(), table, false });
+    }
+
+    void Pipeline::Clear()
+    {
+        impl->stages.clear();
+    }
+
+    int Pipeline::StageCount() const
+    {
+        return static_cast<int>(impl->stages.size());
+    }
+
+    void Pipeline::Execute(void* pixels, int width, int height, int stride) const
+    {
+        unsigned char* pixelData = static_cast<unsigned char*>(pixels);
+        std::vector<const Stage*> segment;
+        Stage otsu;
+        for (const Stage& stage : impl->stages) {
+            if (!stage.isOtsu) {
+                segment.push_back(&stage);
+                continue;
+            }
+            // the threshold depends on every stage before it
+            ExecuteSegment(segment, pixelData, width, height, stride);
+            int threshold = OtsuThreshold(pixelData, width, height, stride);
+            otsu = { 0, TileFilter(), std::vector<unsigned char>(256), false };
+            for (int i = 0; i < 256; ++i) otsu.table[i] = (i > threshold) ? 255 : 0;
+            segment.assign(1, &otsu);
+        }
+        ExecuteSegment(segment, pixelData, width, height, stride);
+    }
+}
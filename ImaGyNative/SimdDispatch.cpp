@@ -0,0 +1,160 @@
+#include "pch.h"
+#include "SimdDispatch.h"
+#include "SimdKernels.h"
+#include <intrin.h>
+
+namespace ImaGyNative
+{
+    static const SimdKernelTable* activeKernels = nullptr;
+
+    SimdLevel DetectSimdLevel()
+    {
+        int info[4] = { 0 };
+        __cpuid(info, 0);
+        int maxLeaf = info[0];
+
+        __cpuid(info, 1);
+        bool hasSse2 = (info[3] & (1 << 26)) != 0;
+        bool hasOsxsave = (info[2] & (1 << 27)) != 0;
+        bool hasAvx = (info[2] & (1 << 28)) != 0;
+        if (!hasSse2) return SimdLevel::Scalar;
+        if (!hasOsxsave || !hasAvx || maxLeaf < 7) return SimdLevel::Sse2;
+
+        // XCR0: bit 1 SSE, bit 2 AVX, bits 5-7 opmask / ZMM state
+        unsigned long long xcr0 = _xgetbv(0);
+        __cpuidex(info, 7, 0);
+        bool hasAvx2 = (info[1] & (1 << 5)) != 0;
+        bool hasAvx512 = (info[1] & (1 << 16)) != 0 && (info[1] & (1 << 30)) != 0;
+
+        if (hasAvx512 && (xcr0 & 0xE6) == 0xE6) return SimdLevel::Avx512;
+        if (hasAvx2 && (xcr0 & 0x06) == 0x06) return SimdLevel::Avx2;
+        return SimdLevel::Sse2;
+    }
+
+    static const SimdKernelTable& KernelsFor(SimdLevel level)
+    {
+        switch (level) {
+        case SimdLevel::Avx512: return Avx512Kernels();
+        case SimdLevel::Avx2: return Avx2Kernels();
+        case SimdLevel::Sse2: return Sse2Kernels();
+        default: return ScalarKernels();
+        }
+    }
+
+    void InitializeSimdDispatch()
+    {
+        activeKernels = &KernelsFor(DetectSimdLevel());
+    }
+
+    const SimdKernelTable& ActiveSimdKernels()
+    {
+        // DllMain normally got here first, this covers static linking
+        if (activeKernels == nullptr) InitializeSimdDispatch();
+        return *activeKernels;
+    }
+
+    SimdLevel SetSimdLevel(SimdLevel level)
+    {
+        SimdLevel supported = DetectSimdLevel();
+        if (level > supported) level = supported;
+        activeKernels = &KernelsFor(level);
+        return level;
+    }
+
+    static void ScalarConvolveRow(const PaddedImage& padded, int y, const QuantizedTapPair* pairs, int pairCount, int* rowOut)
+    {
+        ConvolveRowTail(padded, y, pairs, pairCount, 0, rowOut);
+    }
+
+    static void ScalarPackRow(const int* sums, int shift, int length, unsigned char* rowOut)
+    {
+        PackRowTail(sums, shift, 0, length, rowOut);
+    }
+
+    static void ScalarMaxRows(const unsigned char* const* sources, int count, int length, unsigned char* rowOut)
+    {
+        ExtremumRowsTail<true>(sources, count, 0, length, rowOut);
+    }
+
+    static void ScalarMinRows(const unsigned char* const* sources, int count, int length, unsigned char* rowOut)
+    {
+        ExtremumRowsTail<false>(sources, count, 0, length, rowOut);
+    }
+
+    static void ScalarDifferentialRow(const unsigned char* row, const unsigned char* nextRow, int length, unsigned char* rowOut)
+    {
+        DifferentialRowTail(row, nextRow, 0, length, rowOut);
+    }
+
+    static long long ScalarDotRow(const unsigned char* a, const unsigned char* b, int length)
+    {
+        return DotRowTail(a, b, 0, length);
+    }
+
+    static long long ScalarAbsDiffRow(const unsigned char* a, const unsigned char* b, int length)
+    {
+        return AbsDiffRowTail(a, b, 0, length);
+    }
+
+    static long long ScalarSquaredDiffRow(const unsigned char* a, const unsigned char* b, int length)
+    {
+        return SquaredDiffRowTail(a, b, 0, length);
+    }
+
+    static void ScalarNearestCentroids(const unsigned char* const* planes, int dimensions, int count, const float* centroids, int k,
+        unsigned char* labels, float* bestDistance, float* secondDistance)
+    {
+        NearestCentroidsTail(planes, dimensions, 0, count, centroids, k, labels, bestDistance, secondDistance);
+    }
+
+    namespace
+    {
+        // FFTBatchLanes floats in a plain array, the compiler may still vectorise the loops
+        struct ScalarFloat
+        {
+            struct Vector { float lane[FFTBatchLanes]; };
+
+            static Vector Load(const float* p)
+            {
+                Vector v;
+                for (int i = 0; i < FFTBatchLanes; ++i) v.lane[i] = p[i];
+                return v;
+            }
+            static void Store(float* p, const Vector& v)
+            {
+                for (int i = 0; i < FFTBatchLanes; ++i) p[i] = v.lane[i];
+            }
+            static Vector Broadcast(float value)
+            {
+                Vector v;
+                for (int i = 0; i < FFTBatchLanes; ++i) v.lane[i] = value;
+                return v;
+            }
+            static Vector Add(const Vector& a, const Vector& b)
+            {
+                Vector v;
+                for (int i = 0; i < FFTBatchLanes; ++i) v.lane[i] = a.lane[i] + b.lane[i];
+                return v;
+            }
+            static Vector Sub(const Vector& a, const Vector& b)
+            {
+                Vector v;
+                for (int i = 0; i < FFTBatchLanes; ++i) v.lane[i] = a.lane[i] - b.lane[i];
+                return v;
+            }
+            static Vector Mul(const Vector& a, const Vector& b)
+            {
+                Vector v;
+                for (int i = 0; i < FFTBatchLanes; ++i) v.lane[i] = a.lane[i] * b.lane[i];
+                return v;
+            }
+        };
+    }
+
+    const SimdKernelTable& ScalarKernels()
+    {
+        static const SimdKernelTable table = { SimdLevel::Scalar, ScalarConvolveRow, ScalarPackRow, ScalarMaxRows, ScalarMinRows, ScalarDifferentialRow,
+            ScalarDotRow, ScalarAbsDiffRow, ScalarSquaredDiffRow, FFTBatch<ScalarFloat>, ScalarNearestCentroids };
+        return table;
+    }
+}
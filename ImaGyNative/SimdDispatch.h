@@ -0,0 +1,60 @@
+#pragma once
+
+#include "BorderHandling.h"
+#include "ImageProcessingUtils.h"
+
+namespace ImaGyNative
+{
+    class FFTBatchPlan;
+
+    // Widest instruction set the SIMD filters may use
+    enum class SimdLevel {
+        Scalar,
+        Sse2,
+        Avx2,
+        Avx512  // AVX-512F + AVX-512BW
+    };
+
+    // Row kernels of one instruction set.
+    // Threading and per-image setup (padding, kernel quantization) stay with the caller
+    struct SimdKernelTable {
+        SimdLevel level;
+        // int32 sums of a quantized kernel for bytes [0, width * pixelBytes) of row y
+        void (*ConvolveRow)(const PaddedImage& padded, int y, const QuantizedTapPair* pairs, int pairCount, int* rowOut);
+        // rowOut[i] = clamp(sums[i] >> shift, 0, 255), the arithmetic shift floors
+        void (*PackRow)(const int* sums, int shift, int length, unsigned char* rowOut);
+        // rowOut[i] = max / min of sources[k][i] over k < count, for i < length
+        void (*MaxRows)(const unsigned char* const* sources, int count, int length, unsigned char* rowOut);
+        void (*MinRows)(const unsigned char* const* sources, int count, int length, unsigned char* rowOut);
+        // rowOut[i] = saturate(|row[i + 1] - row[i]| + |nextRow[i] - row[i]|)
+        void (*DifferentialRow)(const unsigned char* row, const unsigned char* nextRow, int length, unsigned char* rowOut);
+        // sum of a[i] * b[i] for i < length (template matching cross term), length below 128K
+        long long (*DotRow)(const unsigned char* a, const unsigned char* b, int length);
+        // sum of |a[i] - b[i]| and of (a[i] - b[i])^2 for i < length (SAD / SSD rows), length below 128K
+        long long (*AbsDiffRow)(const unsigned char* a, const unsigned char* b, int length);
+        long long (*SquaredDiffRow)(const unsigned char* a, const unsigned char* b, int length);
+        // FFTBatchPlan::Execute: FFTBatchLanes float transforms in place, split real / imaginary
+        void (*FFTBatch)(const FFTBatchPlan& plan, float* real, float* imag, float* scratch);
+        // k-means assignment of points [0, count) given as byte feature planes, feature d of point i at planes[d][i]
+        // (dimensions <= KMeansMaxDimensions): index of the nearest of k centroids (centroids[c * dimensions + d]),
+        // the squared distance to it and to the second nearest (FLT_MAX when k == 1). Ties go to the lower index
+        void (*NearestCentroids)(const unsigned char* const* planes, int dimensions, int count, const float* centroids, int k,
+            unsigned char* labels, float* bestDistance, float* secondDistance);
+    };
+
+    // CPUID + XGETBV, so a CPU with AVX2 under an OS that doesn't save YMM state still gets SSE2
+    SimdLevel DetectSimdLevel();
+
+    // Selects the backend once, called from DllMain on process attach
+    void InitializeSimdDispatch();
+    const SimdKernelTable& ActiveSimdKernels();
+
+    // Forces a narrower backend (benchmarks, A/B checks), clamped to what the CPU supports.
+    // Returns the level actually selected
+    SimdLevel SetSimdLevel(SimdLevel level);
+
+    const SimdKernelTable& ScalarKernels();
+    const SimdKernelTable& Sse2Kernels();   // NativeCoreSse.cpp
+    const SimdKernelTable& Avx2Kernels();   // NativeCoreAvx2.cpp
+    const SimdKernelTable& Avx512Kernels(); // NativeCoreAvx512.cpp
+}
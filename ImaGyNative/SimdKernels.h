@@ -0,0 +1,529 @@
+#pragma once
+
+// Row kernels shared by every SIMD backend, written once against an instruction-set
+// traits class (Sse2, Avx2, Avx512) that supplies Width, Load/Store, Max/Min,
+// AbsDiff/AddSaturate, the int16 multiply-add accumulator and the saturating int32 -> uint8 pack.
+// The batched FFT and the k-means assignment are written against a second, float traits class
+// (Sse2Float, Avx2Float, ...) whose Vector holds FFTBatchLanes (8) floats: Load/Store, LoadBytes
+// (8 bytes widened), Broadcast, Add/Sub/Mul, Min/Max, Less (a lane mask) and Blend.
+//
+// Only the backend translation units include this file. Everything lives in an
+// anonymous namespace so each backend gets private copies: the linker can never fold
+// an AVX2 instantiation into the SSE2 table and hand it to a CPU without AVX2.
+// MSVC emits AVX2/AVX-512 intrinsics without /arch, so the backends are built with the
+// project's default flags and only the intrinsic code uses the wider registers.
+
+#include "SimdDispatch.h"
+#include "FFTPlan.h"
+#include "KMeans.h"
+#include <immintrin.h>
+#include <algorithm>
+#include <cfloat>
+#include <cstdlib>
+
+namespace ImaGyNative
+{
+    namespace
+    {
+        // Scalar rows shorter than one vector, and the whole row for the scalar backend
+        inline void ConvolveRowTail(const PaddedImage& padded, int y, const QuantizedTapPair* pairs, int pairCount,
+            int xBegin, int* rowOut)
+        {
+            int rowBytes = padded.Width() * padded.PixelBytes();
+            for (int x = xBegin; x < rowBytes; ++x) {
+                int sum = 0;
+                for (int i = 0; i < pairCount; ++i) {
+                    const unsigned char* sourceRow = padded.Row(y + pairs[i].rowOffset) + x;
+                    sum += sourceRow[pairs[i].offset0] * static_cast<short>(pairs[i].weights & 0xFFFF)
+                        + sourceRow[pairs[i].offset1] * static_cast<short>(pairs[i].weights >> 16);
+                }
+                rowOut[x] = sum;
+            }
+        }
+
+        inline void PackRowTail(const int* sums, int shift, int xBegin, int length, unsigned char* rowOut)
+        {
+            for (int x = xBegin; x < length; ++x) {
+                int value = sums[x] >> shift;
+                rowOut[x] = static_cast<unsigned char>(value < 0 ? 0 : (value > 255 ? 255 : value));
+            }
+        }
+
+        template <bool isMax>
+        inline void ExtremumRowsTail(const unsigned char* const* sources, int count, int xBegin, int length, unsigned char* rowOut)
+        {
+            for (int x = xBegin; x < length; ++x) {
+                unsigned char value = sources[0][x];
+                for (int k = 1; k < count; ++k) {
+                    unsigned char candidate = sources[k][x];
+                    if (isMax ? candidate > value : candidate < value) value = candidate;
+                }
+                rowOut[x] = value;
+            }
+        }
+
+        inline void DifferentialRowTail(const unsigned char* row, const unsigned char* nextRow, int xBegin, int length, unsigned char* rowOut)
+        {
+            for (int x = xBegin; x < length; ++x) {
+                int value = abs(row[x + 1] - row[x]) + abs(nextRow[x] - row[x]);
+                rowOut[x] = static_cast<unsigned char>(value > 255 ? 255 : value);
+            }
+        }
+
+        inline long long DotRowTail(const unsigned char* a, const unsigned char* b, int xBegin, int length)
+        {
+            long long sum = 0;
+            for (int x = xBegin; x < length; ++x) sum += a[x] * b[x];
+            return sum;
+        }
+
+        inline long long AbsDiffRowTail(const unsigned char* a, const unsigned char* b, int xBegin, int length)
+        {
+            long long sum = 0;
+            for (int x = xBegin; x < length; ++x) sum += abs(a[x] - b[x]);
+            return sum;
+        }
+
+        inline long long SquaredDiffRowTail(const unsigned char* a, const unsigned char* b, int xBegin, int length)
+        {
+            long long sum = 0;
+            for (int x = xBegin; x < length; ++x) sum += (a[x] - b[x]) * (a[x] - b[x]);
+            return sum;
+        }
+
+        // 16-byte SSE2 steps shared by the reductions below for what is left after the wide vectors,
+        // SSE2 is on every x64 CPU. Each returns the new x
+        inline int DotRowSse2(const unsigned char* a, const unsigned char* b, int x, int length, long long& total)
+        {
+            const __m128i zero = _mm_setzero_si128();
+            __m128i sums = zero;
+            for (; x + 16 <= length; x += 16) {
+                __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + x));
+                __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + x));
+                sums = _mm_add_epi32(sums, _mm_madd_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero)));
+                sums = _mm_add_epi32(sums, _mm_madd_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero)));
+            }
+            alignas(16) int lanes[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(lanes), sums);
+            total += (long long)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+            return x;
+        }
+
+        inline int AbsDiffRowSse2(const unsigned char* a, const unsigned char* b, int x, int length, long long& total)
+        {
+            __m128i sums = _mm_setzero_si128();
+            for (; x + 16 <= length; x += 16) {
+                __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + x));
+                __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + x));
+                sums = _mm_add_epi64(sums, _mm_sad_epu8(va, vb));
+            }
+            alignas(16) long long lanes[2];
+            _mm_store_si128(reinterpret_cast<__m128i*>(lanes), sums);
+            total += lanes[0] + lanes[1];
+            return x;
+        }
+
+        inline int SquaredDiffRowSse2(const unsigned char* a, const unsigned char* b, int x, int length, long long& total)
+        {
+            const __m128i zero = _mm_setzero_si128();
+            __m128i sums = zero;
+            for (; x + 16 <= length; x += 16) {
+                __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + x));
+                __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + x));
+                __m128i lo = _mm_sub_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero));
+                __m128i hi = _mm_sub_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero));
+                sums = _mm_add_epi32(sums, _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi)));
+            }
+            alignas(16) int lanes[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(lanes), sums);
+            total += (long long)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+            return x;
+        }
+
+        // Isa::Width bytes per step, Isa::Accumulator holds Width int32 sums.
+        // The last step of every kernel below is moved back to end exactly at the row end and
+        // recomputes a few outputs, so narrow tiles don't pay for a scalar tail. That is safe
+        // because no kernel's output aliases its inputs
+        template <class Isa>
+        void ConvolveRow(const PaddedImage& padded, int y, const QuantizedTapPair* pairs, int pairCount, int* rowOut)
+        {
+            int rowBytes = padded.Width() * padded.PixelBytes();
+            if (rowBytes < Isa::Width) {
+                ConvolveRowTail(padded, y, pairs, pairCount, 0, rowOut);
+                return;
+            }
+            for (int x = 0; x < rowBytes; x += Isa::Width) {
+                x = std::min(x, rowBytes - Isa::Width);
+                typename Isa::Accumulator acc;
+                Isa::Clear(acc);
+                for (int i = 0; i < pairCount; ++i) {
+                    const unsigned char* sourceRow = padded.Row(y + pairs[i].rowOffset) + x;
+                    Isa::MultiplyAdd(acc, sourceRow + pairs[i].offset0, sourceRow + pairs[i].offset1, pairs[i].weights);
+                }
+                Isa::StoreSums(rowOut + x, acc);
+            }
+        }
+
+        template <class Isa>
+        void PackRow(const int* sums, int shift, int length, unsigned char* rowOut)
+        {
+            if (length < Isa::Width) {
+                PackRowTail(sums, shift, 0, length, rowOut);
+                return;
+            }
+            for (int x = 0; x < length; x += Isa::Width) {
+                x = std::min(x, length - Isa::Width);
+                Isa::PackSums(sums + x, shift, rowOut + x);
+            }
+        }
+
+        template <class Isa, bool isMax>
+        void ExtremumRows(const unsigned char* const* sources, int count, int length, unsigned char* rowOut)
+        {
+            if (length < Isa::Width) {
+                ExtremumRowsTail<isMax>(sources, count, 0, length, rowOut);
+                return;
+            }
+            for (int x = 0; x < length; x += Isa::Width) {
+                x = std::min(x, length - Isa::Width);
+                typename Isa::Vector value = Isa::Load(sources[0] + x);
+                for (int k = 1; k < count; ++k) {
+                    typename Isa::Vector candidate = Isa::Load(sources[k] + x);
+                    value = isMax ? Isa::Max(value, candidate) : Isa::Min(value, candidate);
+                }
+                Isa::Store(rowOut + x, value);
+            }
+        }
+
+        template <class Isa>
+        void DifferentialRow(const unsigned char* row, const unsigned char* nextRow, int length, unsigned char* rowOut)
+        {
+            if (length < Isa::Width) {
+                DifferentialRowTail(row, nextRow, 0, length, rowOut);
+                return;
+            }
+            for (int x = 0; x < length; x += Isa::Width) {
+                x = std::min(x, length - Isa::Width);
+                typename Isa::Vector center = Isa::Load(row + x);
+                typename Isa::Vector diffX = Isa::AbsDiff(Isa::Load(row + x + 1), center);
+                typename Isa::Vector diffY = Isa::AbsDiff(Isa::Load(nextRow + x), center);
+                Isa::Store(rowOut + x, Isa::AddSaturate(diffX, diffY));
+            }
+        }
+
+        // A reduction can't re-run its last step. After whole vectors, 16-byte SSE2 steps take the
+        // remainder so templates narrower than an AVX-512 vector still run vectorised, the last
+        // < 16 bytes are scalar. int32 lanes gain at most 4 * 255 * 255 per step
+        template <class Isa>
+        long long DotRow(const unsigned char* a, const unsigned char* b, int length)
+        {
+            typename Isa::Vector sums = Isa::Zero();
+            int x = 0;
+            for (; x + Isa::Width <= length; x += Isa::Width) sums = Isa::DotAccumulate(sums, Isa::Load(a + x), Isa::Load(b + x));
+            long long total = Isa::HorizontalSum(sums);
+            x = DotRowSse2(a, b, x, length, total);
+            return total + DotRowTail(a, b, x, length);
+        }
+
+        // psadbw: one 64-bit sum per 8 bytes
+        template <class Isa>
+        long long AbsDiffRow(const unsigned char* a, const unsigned char* b, int length)
+        {
+            typename Isa::Vector sums = Isa::Zero();
+            int x = 0;
+            for (; x + Isa::Width <= length; x += Isa::Width) sums = Isa::AbsDiffAccumulate(sums, Isa::Load(a + x), Isa::Load(b + x));
+            long long total = Isa::HorizontalSum64(sums);
+            x = AbsDiffRowSse2(a, b, x, length, total);
+            return total + AbsDiffRowTail(a, b, x, length);
+        }
+
+        template <class Isa>
+        long long SquaredDiffRow(const unsigned char* a, const unsigned char* b, int length)
+        {
+            typename Isa::Vector sums = Isa::Zero();
+            int x = 0;
+            for (; x + Isa::Width <= length; x += Isa::Width) sums = Isa::SquaredDiffAccumulate(sums, Isa::Load(a + x), Isa::Load(b + x));
+            long long total = Isa::HorizontalSum(sums);
+            x = SquaredDiffRowSse2(a, b, x, length, total);
+            return total + SquaredDiffRowTail(a, b, x, length);
+        }
+
+        // FFTBatchLanes complex values, one per sequence
+        template <class Lanes>
+        struct ComplexLanes {
+            typename Lanes::Vector real;
+            typename Lanes::Vector imag;
+        };
+
+        template <class Lanes>
+        inline ComplexLanes<Lanes> LoadLanes(const float* real, const float* imag, int index)
+        {
+            return { Lanes::Load(real + index * FFTBatchLanes), Lanes::Load(imag + index * FFTBatchLanes) };
+        }
+
+        template <class Lanes>
+        inline void StoreLanes(float* real, float* imag, int index, const ComplexLanes<Lanes>& value)
+        {
+            Lanes::Store(real + index * FFTBatchLanes, value.real);
+            Lanes::Store(imag + index * FFTBatchLanes, value.imag);
+        }
+
+        template <class Lanes>
+        inline ComplexLanes<Lanes> AddLanes(const ComplexLanes<Lanes>& a, const ComplexLanes<Lanes>& b)
+        {
+            return { Lanes::Add(a.real, b.real), Lanes::Add(a.imag, b.imag) };
+        }
+
+        template <class Lanes>
+        inline ComplexLanes<Lanes> SubLanes(const ComplexLanes<Lanes>& a, const ComplexLanes<Lanes>& b)
+        {
+            return { Lanes::Sub(a.real, b.real), Lanes::Sub(a.imag, b.imag) };
+        }
+
+        // every lane times the same complex w
+        template <class Lanes>
+        inline ComplexLanes<Lanes> MulLanes(const ComplexLanes<Lanes>& a, float wReal, float wImag)
+        {
+            typename Lanes::Vector wr = Lanes::Broadcast(wReal);
+            typename Lanes::Vector wi = Lanes::Broadcast(wImag);
+            return { Lanes::Sub(Lanes::Mul(a.real, wr), Lanes::Mul(a.imag, wi)),
+                Lanes::Add(Lanes::Mul(a.real, wi), Lanes::Mul(a.imag, wr)) };
+        }
+
+        // t + i d and t - i d, the +-i rotations of the radix-3 and radix-4 butterflies without multiplies
+        template <class Lanes>
+        inline void PlusMinusILanes(const ComplexLanes<Lanes>& t, const ComplexLanes<Lanes>& d,
+            ComplexLanes<Lanes>& plus, ComplexLanes<Lanes>& minus)
+        {
+            plus = { Lanes::Sub(t.real, d.imag), Lanes::Add(t.imag, d.real) };
+            minus = { Lanes::Add(t.real, d.imag), Lanes::Sub(t.imag, d.real) };
+        }
+
+        // FFTPlan::ExecuteRadix4 on FFTBatchLanes sequences
+        template <class Lanes>
+        void FFTBatchRadix4(const FFTBatchPlan& plan, float* real, float* imag)
+        {
+            typedef ComplexLanes<Lanes> C;
+            int length = plan.length;
+            for (size_t i = 0; i < plan.swaps.size(); i += 2) {
+                C a = LoadLanes<Lanes>(real, imag, plan.swaps[i]);
+                C b = LoadLanes<Lanes>(real, imag, plan.swaps[i + 1]);
+                StoreLanes<Lanes>(real, imag, plan.swaps[i], b);
+                StoreLanes<Lanes>(real, imag, plan.swaps[i + 1], a);
+            }
+
+            int m = 1;
+            if (plan.hasRadix2Stage) {
+                for (int i = 0; i < length; i += 2) {
+                    C u = LoadLanes<Lanes>(real, imag, i);
+                    C v = LoadLanes<Lanes>(real, imag, i + 1);
+                    StoreLanes<Lanes>(real, imag, i, AddLanes<Lanes>(u, v));
+                    StoreLanes<Lanes>(real, imag, i + 1, SubLanes<Lanes>(u, v));
+                }
+                m = 2;
+            }
+
+            size_t twiddle = 0;
+            for (; m < length; m *= 4) {
+                for (int base = 0; base < length; base += 4 * m) {
+                    for (int j = 0; j < m; ++j) {
+                        size_t w = twiddle + 2 * j;
+                        int i0 = base + j;
+                        C v1 = MulLanes<Lanes>(LoadLanes<Lanes>(real, imag, i0 + m), plan.twiddleReal[w], plan.twiddleImag[w]);
+                        C v3 = MulLanes<Lanes>(LoadLanes<Lanes>(real, imag, i0 + 3 * m), plan.twiddleReal[w], plan.twiddleImag[w]);
+                        C x0 = LoadLanes<Lanes>(real, imag, i0);
+                        C x2 = LoadLanes<Lanes>(real, imag, i0 + 2 * m);
+                        C b0 = AddLanes<Lanes>(x0, v1);
+                        C b1 = SubLanes<Lanes>(x0, v1);
+                        C c2 = MulLanes<Lanes>(AddLanes<Lanes>(x2, v3), plan.twiddleReal[w + 1], plan.twiddleImag[w + 1]);
+                        C c3 = MulLanes<Lanes>(SubLanes<Lanes>(x2, v3), plan.twiddleReal[w + 1], plan.twiddleImag[w + 1]);
+                        C plus, minus;
+                        PlusMinusILanes<Lanes>(b1, c3, plus, minus);
+                        StoreLanes<Lanes>(real, imag, i0, AddLanes<Lanes>(b0, c2));
+                        StoreLanes<Lanes>(real, imag, i0 + m, plan.isInverse ? plus : minus);
+                        StoreLanes<Lanes>(real, imag, i0 + 2 * m, SubLanes<Lanes>(b0, c2));
+                        StoreLanes<Lanes>(real, imag, i0 + 3 * m, plan.isInverse ? minus : plus);
+                    }
+                }
+                twiddle += 2 * m;
+            }
+        }
+
+        // FFTPlan::ExecuteMixedRadix on FFTBatchLanes sequences
+        template <class Lanes>
+        void FFTBatchMixedRadix(const FFTBatchPlan& plan, float* real, float* imag, float* scratch)
+        {
+            typedef ComplexLanes<Lanes> C;
+            int length = plan.length;
+            size_t block = (size_t)length * FFTBatchLanes;
+            const float* inReal = real;
+            const float* inImag = imag;
+            float* outReal = scratch;
+            float* outImag = scratch + block;
+            float* vReal = scratch + 2 * block;
+            float* vImag = vReal + (size_t)plan.maxRadix * FFTBatchLanes;
+            typename Lanes::Vector halfVector = Lanes::Broadcast(0.5f);
+            typename Lanes::Vector sin60 = Lanes::Broadcast(0.866025403784438647f);
+
+            for (const FFTBatchPlan::Stage& stage : plan.stages) {
+                int radix = stage.radix;
+                int span = stage.span;
+                int groups = length / radix;
+                for (int j = 0; j < groups; ++j) {
+                    int k = j % span;
+                    size_t w = stage.twiddleOffset + (size_t)k * (radix - 1);
+                    int y = (j / span) * span * radix + k;
+                    if (radix == 2) {
+                        C v0 = LoadLanes<Lanes>(inReal, inImag, j);
+                        C v1 = MulLanes<Lanes>(LoadLanes<Lanes>(inReal, inImag, j + groups), plan.twiddleReal[w], plan.twiddleImag[w]);
+                        StoreLanes<Lanes>(outReal, outImag, y, AddLanes<Lanes>(v0, v1));
+                        StoreLanes<Lanes>(outReal, outImag, y + span, SubLanes<Lanes>(v0, v1));
+                    }
+                    else if (radix == 3) {
+                        C v0 = LoadLanes<Lanes>(inReal, inImag, j);
+                        C v1 = MulLanes<Lanes>(LoadLanes<Lanes>(inReal, inImag, j + groups), plan.twiddleReal[w], plan.twiddleImag[w]);
+                        C v2 = MulLanes<Lanes>(LoadLanes<Lanes>(inReal, inImag, j + 2 * groups), plan.twiddleReal[w + 1], plan.twiddleImag[w + 1]);
+                        C t1 = AddLanes<Lanes>(v1, v2);
+                        C t2 = { Lanes::Sub(v0.real, Lanes::Mul(t1.real, halfVector)), Lanes::Sub(v0.imag, Lanes::Mul(t1.imag, halfVector)) };
+                        C d = SubLanes<Lanes>(v1, v2);
+                        d = { Lanes::Mul(d.real, sin60), Lanes::Mul(d.imag, sin60) };
+                        C plus, minus;
+                        PlusMinusILanes<Lanes>(t2, d, plus, minus);
+                        StoreLanes<Lanes>(outReal, outImag, y, AddLanes<Lanes>(v0, t1));
+                        StoreLanes<Lanes>(outReal, outImag, y + span, plan.isInverse ? plus : minus);
+                        StoreLanes<Lanes>(outReal, outImag, y + 2 * span, plan.isInverse ? minus : plus);
+                    }
+                    else if (radix == 4) {
+                        C v0 = LoadLanes<Lanes>(inReal, inImag, j);
+                        C v1 = MulLanes<Lanes>(LoadLanes<Lanes>(inReal, inImag, j + groups), plan.twiddleReal[w], plan.twiddleImag[w]);
+                        C v2 = MulLanes<Lanes>(LoadLanes<Lanes>(inReal, inImag, j + 2 * groups), plan.twiddleReal[w + 1], plan.twiddleImag[w + 1]);
+                        C v3 = MulLanes<Lanes>(LoadLanes<Lanes>(inReal, inImag, j + 3 * groups), plan.twiddleReal[w + 2], plan.twiddleImag[w + 2]);
+                        C t0 = AddLanes<Lanes>(v0, v2);
+                        C t1 = SubLanes<Lanes>(v0, v2);
+                        C t2 = AddLanes<Lanes>(v1, v3);
+                        C plus, minus;
+                        PlusMinusILanes<Lanes>(t1, SubLanes<Lanes>(v1, v3), plus, minus);
+                        StoreLanes<Lanes>(outReal, outImag, y, AddLanes<Lanes>(t0, t2));
+                        StoreLanes<Lanes>(outReal, outImag, y + span, plan.isInverse ? plus : minus);
+                        StoreLanes<Lanes>(outReal, outImag, y + 2 * span, SubLanes<Lanes>(t0, t2));
+                        StoreLanes<Lanes>(outReal, outImag, y + 3 * span, plan.isInverse ? minus : plus);
+                    }
+                    else {
+                        StoreLanes<Lanes>(vReal, vImag, 0, LoadLanes<Lanes>(inReal, inImag, j));
+                        for (int r = 1; r < radix; ++r) {
+                            C v = MulLanes<Lanes>(LoadLanes<Lanes>(inReal, inImag, j + r * groups), plan.twiddleReal[w + r - 1], plan.twiddleImag[w + r - 1]);
+                            StoreLanes<Lanes>(vReal, vImag, r, v);
+                        }
+                        for (int s = 0; s < radix; ++s) {
+                            C sum = LoadLanes<Lanes>(vReal, vImag, 0);
+                            for (int r = 1; r < radix; ++r) {
+                                size_t root = stage.rootOffset + (r * s) % radix;
+                                sum = AddLanes<Lanes>(sum, MulLanes<Lanes>(LoadLanes<Lanes>(vReal, vImag, r), plan.rootReal[root], plan.rootImag[root]));
+                            }
+                            StoreLanes<Lanes>(outReal, outImag, y + s * span, sum);
+                        }
+                    }
+                }
+                float* nextReal = (outReal == scratch) ? real : scratch;
+                float* nextImag = (outReal == scratch) ? imag : scratch + block;
+                inReal = outReal;
+                inImag = outImag;
+                outReal = nextReal;
+                outImag = nextImag;
+            }
+            if (inReal != real) {
+                std::copy(inReal, inReal + block, real);
+                std::copy(inImag, inImag + block, imag);
+            }
+        }
+
+        template <class Lanes>
+        void FFTBatch(const FFTBatchPlan& plan, float* real, float* imag, float* scratch)
+        {
+            if (plan.isRadix4) FFTBatchRadix4<Lanes>(plan, real, imag);
+            else FFTBatchMixedRadix<Lanes>(plan, real, imag, scratch);
+            if (plan.isInverse) {
+                typename Lanes::Vector scale = Lanes::Broadcast(1.0f / plan.length);
+                for (int i = 0; i < plan.length; ++i) {
+                    float* r = real + (size_t)i * FFTBatchLanes;
+                    float* m = imag + (size_t)i * FFTBatchLanes;
+                    Lanes::Store(r, Lanes::Mul(Lanes::Load(r), scale));
+                    Lanes::Store(m, Lanes::Mul(Lanes::Load(m), scale));
+                }
+            }
+        }
+
+        inline void NearestCentroidsTail(const unsigned char* const* planes, int dimensions, int begin, int count,
+            const float* centroids, int k, unsigned char* labels, float* bestDistance, float* secondDistance)
+        {
+            for (int i = begin; i < count; ++i) {
+                float best = FLT_MAX;
+                float second = FLT_MAX;
+                int index = 0;
+                for (int c = 0; c < k; ++c) {
+                    float distance = 0.0f;
+                    for (int d = 0; d < dimensions; ++d) {
+                        float diff = planes[d][i] - centroids[c * dimensions + d];
+                        distance += diff * diff;
+                    }
+                    if (distance < best) {
+                        second = best;
+                        best = distance;
+                        index = c;
+                    }
+                    else if (distance < second) {
+                        second = distance;
+                    }
+                }
+                labels[i] = static_cast<unsigned char>(index);
+                bestDistance[i] = best;
+                secondDistance[i] = second;
+            }
+        }
+
+        // FFTBatchLanes points per step, all k distances in registers. The last step is moved back
+        // to end at count like the row kernels above
+        template <class Lanes>
+        void NearestCentroids(const unsigned char* const* planes, int dimensions, int count, const float* centroids, int k,
+            unsigned char* labels, float* bestDistance, float* secondDistance)
+        {
+            typedef typename Lanes::Vector V;
+            if (count < FFTBatchLanes) {
+                NearestCentroidsTail(planes, dimensions, 0, count, centroids, k, labels, bestDistance, secondDistance);
+                return;
+            }
+            for (int i = 0; i < count; i += FFTBatchLanes) {
+                i = std::min(i, count - FFTBatchLanes);
+                V features[KMeansMaxDimensions];
+                for (int d = 0; d < dimensions; ++d) features[d] = Lanes::LoadBytes(planes[d] + i);
+
+                V best = Lanes::Broadcast(FLT_MAX);
+                V second = best;
+                V index = Lanes::Broadcast(0.0f);
+                for (int c = 0; c < k; ++c) {
+                    V distance = Lanes::Broadcast(0.0f);
+                    for (int d = 0; d < dimensions; ++d) {
+                        V diff = Lanes::Sub(features[d], Lanes::Broadcast(centroids[c * dimensions + d]));
+                        distance = Lanes::Add(distance, Lanes::Mul(diff, diff));
+                    }
+                    V isCloser = Lanes::Less(distance, best);
+                    second = Lanes::Min(second, Lanes::Max(best, distance));
+                    best = Lanes::Min(best, distance);
+                    index = Lanes::Blend(index, Lanes::Broadcast(static_cast<float>(c)), isCloser);
+                }
+                Lanes::Store(bestDistance + i, best);
+                Lanes::Store(secondDistance + i, second);
+                float indices[FFTBatchLanes];
+                Lanes::Store(indices, index);
+                for (int j = 0; j < FFTBatchLanes; ++j) labels[i + j] = static_cast<unsigned char>(indices[j]);
+            }
+        }
+
+        template <class Isa, class Lanes>
+        SimdKernelTable MakeKernelTable(SimdLevel level)
+        {
+            return { level, ConvolveRow<Isa>, PackRow<Isa>, ExtremumRows<Isa, true>, ExtremumRows<Isa, false>, DifferentialRow<Isa>,
+                DotRow<Isa>, AbsDiffRow<Isa>, SquaredDiffRow<Isa>, FFTBatch<Lanes>, NearestCentroids<Lanes> };
+        }
+    }
+}
@@ -0,0 +1,112 @@
+#include "pch.h"
+#include "SpectrumCache.h"
+#include <cstring>
+#include <list>
+#include <mutex>
+
+namespace ImaGyNative
+{
+    static const size_t SpectrumCacheBytes = 256u << 20;
+
+    static const unsigned long long HashPrime1 = 0x9E3779B185EBCA87ull;
+    static const unsigned long long HashPrime2 = 0xC2B2AE3D27D4EB4Full;
+
+    static unsigned long long RotateLeft(unsigned long long value, int bits)
+    {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    static unsigned long long MixWord(unsigned long long hash, unsigned long long word)
+    {
+        return RotateLeft(hash ^ (word * HashPrime2), 31) * HashPrime1;
+    }
+
+    // 8 bytes per step, the padding beyond width is not hashed
+    static unsigned long long HashRow(const unsigned char* row, int width)
+    {
+        unsigned long long hash = HashPrime2 ^ (unsigned long long)width;
+        int x = 0;
+        for (; x + 8 <= width; x += 8) {
+            unsigned long long word;
+            memcpy(&word, row + x, sizeof(word));
+            hash = MixWord(hash, word);
+        }
+        unsigned long long tail = 0;
+        for (int shift = 0; x < width; ++x, shift += 8) tail |= (unsigned long long)row[x] << shift;
+        return MixWord(hash, tail);
+    }
+
+    // Rows are hashed in parallel and folded in order, so the value doesn't depend on the thread count
+    static unsigned long long HashImage(const unsigned char* pixels, int width, int height, int stride)
+    {
+        std::vector<unsigned long long> rowHashes(height);
+#pragma omp parallel for
+        for (int y = 0; y < height; ++y) {
+            rowHashes[y] = HashRow(pixels + (size_t)y * stride, width);
+        }
+        unsigned long long hash = (unsigned long long)height * HashPrime1;
+        for (unsigned long long rowHash : rowHashes) hash = MixWord(hash, rowHash);
+        return hash ^ (hash >> 29);
+    }
+
+    struct SpectrumCacheEntry {
+        const unsigned char* pixels;
+        int width;
+        int height;
+        int stride;
+        unsigned long long hash;
+        std::shared_ptr<const std::vector<Complex>> spectrum;
+    };
+
+    static std::mutex cacheMutex;
+    static std::list<SpectrumCacheEntry> cacheEntries; // most recently used first
+
+    static bool IsSameImage(const SpectrumCacheEntry& entry, const unsigned char* pixels, int width, int height, int stride)
+    {
+        return entry.pixels == pixels && entry.width == width && entry.height == height && entry.stride == stride;
+    }
+
+    std::shared_ptr<const std::vector<Complex>> GetCachedHalfSpectrum(const unsigned char* pixels, int width, int height, int stride)
+    {
+        unsigned long long hash = HashImage(pixels, width, height, stride);
+        {
+            std::lock_guard<std::mutex> lock(cacheMutex);
+            for (auto entry = cacheEntries.begin(); entry != cacheEntries.end(); ++entry) {
+                if (!IsSameImage(*entry, pixels, width, height, stride)) continue;
+                if (entry->hash == hash) {
+                    cacheEntries.splice(cacheEntries.begin(), cacheEntries, entry);
+                    return entry->spectrum;
+                }
+                cacheEntries.erase(entry);
+                break;
+            }
+        }
+
+        // computed without the lock: a concurrent miss on the same image only duplicates the work
+        std::shared_ptr<std::vector<Complex>> spectrum = std::make_shared<std::vector<Complex>>((size_t)HalfSpectrumWidth(width) * height);
+        FFT2D_RealForward(pixels, width, height, stride, spectrum->data(), SpectrumLayout::Transposed);
+
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        for (auto entry = cacheEntries.begin(); entry != cacheEntries.end(); ++entry) {
+            if (IsSameImage(*entry, pixels, width, height, stride)) {
+                cacheEntries.erase(entry);
+                break;
+            }
+        }
+        cacheEntries.push_front({ pixels, width, height, stride, hash, spectrum });
+
+        size_t totalBytes = 0;
+        for (const SpectrumCacheEntry& entry : cacheEntries) totalBytes += entry.spectrum->size() * sizeof(Complex);
+        while (cacheEntries.size() > 1 && totalBytes > SpectrumCacheBytes) {
+            totalBytes -= cacheEntries.back().spectrum->size() * sizeof(Complex);
+            cacheEntries.pop_back();
+        }
+        return spectrum;
+    }
+
+    void ClearSpectrumCache()
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        cacheEntries.clear();
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "ImageProcessingUtils.h"
+#include <memory>
+#include <vector>
+
+namespace ImaGyNative
+{
+    // Forward half spectra of recently filtered images, so a frequency filter re-run on an unchanged
+    // image (slider scrubbing) only pays for the mask, the inverse transform and the quantisation.
+    // An entry belongs to one image buffer (pixel pointer, width, height, stride) and is valid while the
+    // 64-bit content hash of its pixels still matches: re-filtering a buffer that was overwritten in
+    // between, or refilled with another image, recomputes. Least recently used entries are dropped
+    // beyond 256 MB, the newest one is always kept
+    //
+    // The spectrum is FFT2D_RealForward's, transposed layout, HalfSpectrumWidth(width) x height.
+    // It is shared and read-only: callers write the masked copy into their own buffer
+    std::shared_ptr<const std::vector<Complex>> GetCachedHalfSpectrum(const unsigned char* pixels, int width, int height, int stride);
+
+    // Releases every cached spectrum
+    void ClearSpectrumCache();
+}
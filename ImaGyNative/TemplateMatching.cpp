@@ -0,0 +1,763 @@
+#include "pch.h"
+#include "TemplateMatching.h"
+#include "BorderHandling.h"
+#include "SimdDispatch.h"
+#include "ImageProcessingUtils.h"
+#include "FFTPlan.h"
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+#include <omp.h>
+
+namespace ImaGyNative
+{
+    // Blur + 2x decimation, the output keeps the odd last row / column: (width + 1) / 2
+    static GrayImage PyramidDown(const GrayImage& source, std::vector<unsigned char>& buffer)
+    {
+        int width = (source.width + 1) / 2;
+        int height = (source.height + 1) / 2;
+        buffer.resize((size_t)width * height);
+        PaddedImage padded(source.pixels, source.width, source.height, source.stride, 1, 2, { BorderMode::Reflect, 0 });
+        static const int taps[5] = { 1, 4, 6, 4, 1 };
+
+        #pragma omp parallel
+        {
+            std::vector<int> sums(width);
+            #pragma omp for
+            for (int y = 0; y < height; ++y) {
+                std::fill(sums.begin(), sums.end(), 0);
+                for (int ky = -2; ky <= 2; ++ky) {
+                    const unsigned char* row = padded.Row(2 * y + ky);
+                    int weight = taps[ky + 2];
+                    for (int x = 0; x < width; ++x) {
+                        const unsigned char* p = row + 2 * x;
+                        sums[x] += weight * (p[-2] + 4 * p[-1] + 6 * p[0] + 4 * p[1] + p[2]);
+                    }
+                }
+                unsigned char* destRow = &buffer[(size_t)y * width];
+                for (int x = 0; x < width; ++x) destRow[x] = static_cast<unsigned char>((sums[x] + 128) >> 8);
+            }
+        }
+        return { buffer.data(), width, height, width };
+    }
+
+    GrayPyramid::GrayPyramid(const GrayImage& image, int levelCount)
+        : buffers(std::max(levelCount - 1, 0))
+    {
+        levels.reserve(std::max(levelCount, 1));
+        levels.push_back(image);
+        for (int level = 1; level < levelCount; ++level) {
+            levels.push_back(PyramidDown(levels.back(), buffers[level - 1]));
+        }
+    }
+
+    TemplateStats ComputeTemplateStats(const GrayImage& templ)
+    {
+        TemplateStats stats = { 0, 0, (long long)templ.width * templ.height };
+        for (int y = 0; y < templ.height; ++y) {
+            const unsigned char* row = templ.pixels + (size_t)y * templ.stride;
+            for (int x = 0; x < templ.width; ++x) {
+                stats.sum += row[x];
+                stats.sumSq += row[x] * row[x];
+            }
+        }
+        return stats;
+    }
+
+    // n^2 * covariance / (n * sigmaI * n * sigmaT), from exact integer window sums
+    static double NccFromSums(long long sumI, long long sumSqI, long long cross, const TemplateStats& stats)
+    {
+        double n = static_cast<double>(stats.count);
+        double varianceI = n * sumSqI - (double)sumI * sumI;
+        double varianceT = n * stats.sumSq - (double)stats.sum * stats.sum;
+        double denominator = sqrt(varianceI * varianceT);
+        return (denominator > 0) ? (n * cross - (double)sumI * stats.sum) / denominator : 0.0;
+    }
+
+    double MatchScore(MatchMethod method, const GrayImage& source, int x, int y, const GrayImage& templ, const TemplateStats& stats)
+    {
+        if (method == MatchMethod::NCC) {
+            long long sumI = 0, sumSqI = 0, cross = 0;
+            const SimdKernelTable& simd = ActiveSimdKernels();
+            for (int ty = 0; ty < templ.height; ++ty) {
+                const unsigned char* imageRow = source.pixels + (size_t)(y + ty) * source.stride + x;
+                for (int tx = 0; tx < templ.width; ++tx) {
+                    sumI += imageRow[tx];
+                    sumSqI += imageRow[tx] * imageRow[tx];
+                }
+                cross += simd.DotRow(imageRow, templ.pixels + (size_t)ty * templ.stride, templ.width);
+            }
+            return NccFromSums(sumI, sumSqI, cross, stats);
+        }
+
+        long long error = 0;
+        for (int ty = 0; ty < templ.height; ++ty) {
+            const unsigned char* imageRow = source.pixels + (size_t)(y + ty) * source.stride + x;
+            const unsigned char* templateRow = templ.pixels + (size_t)ty * templ.stride;
+            for (int tx = 0; tx < templ.width; ++tx) {
+                int diff = imageRow[tx] - templateRow[tx];
+                error += (method == MatchMethod::SAD) ? std::abs(diff) : diff * diff;
+            }
+        }
+        return -static_cast<double>(error);
+    }
+
+    IntegralImage::IntegralImage(const GrayImage& image)
+        : columns(image.width + 1), sum((size_t)(image.width + 1) * (image.height + 1)), sumSq(sum.size())
+    {
+        // row prefix sums in parallel, then each row adds the one above
+        #pragma omp parallel for
+        for (int y = 0; y < image.height; ++y) {
+            const unsigned char* row = image.pixels + (size_t)y * image.stride;
+            unsigned int* sumRow = &sum[(size_t)(y + 1) * columns];
+            unsigned long long* sumSqRow = &sumSq[(size_t)(y + 1) * columns];
+            unsigned int runningSum = 0;
+            unsigned long long runningSumSq = 0;
+            for (int x = 0; x < image.width; ++x) {
+                runningSum += row[x];
+                runningSumSq += row[x] * row[x];
+                sumRow[x + 1] = runningSum;
+                sumSqRow[x + 1] = runningSumSq;
+            }
+        }
+        #pragma omp parallel
+        for (int y = 2; y <= image.height; ++y) {
+            unsigned int* sumRow = &sum[(size_t)y * columns];
+            unsigned long long* sumSqRow = &sumSq[(size_t)y * columns];
+            #pragma omp for
+            for (int x = 1; x < columns; ++x) {
+                sumRow[x] += sumRow[x - columns];
+                sumSqRow[x] += sumSqRow[x - columns];
+            }
+        }
+    }
+
+    unsigned int IntegralImage::Sum(int x, int y, int width, int height) const
+    {
+        const unsigned int* top = &sum[(size_t)y * columns + x];
+        const unsigned int* bottom = top + (size_t)height * columns;
+        return bottom[width] - bottom[0] - top[width] + top[0];
+    }
+
+    unsigned long long IntegralImage::SumSq(int x, int y, int width, int height) const
+    {
+        const unsigned long long* top = &sumSq[(size_t)y * columns + x];
+        const unsigned long long* bottom = top + (size_t)height * columns;
+        return bottom[width] - bottom[0] - top[width] + top[0];
+    }
+
+    NccEngine::NccEngine(const GrayImage& source)
+        : source(source), integral(source)
+    {
+    }
+
+    double NccEngine::Score(int x, int y, const GrayImage& templ, const TemplateStats& stats) const
+    {
+        const SimdKernelTable& simd = ActiveSimdKernels();
+        long long cross = 0;
+        for (int ty = 0; ty < templ.height; ++ty) {
+            cross += simd.DotRow(source.pixels + (size_t)(y + ty) * source.stride + x, templ.pixels + (size_t)ty * templ.stride, templ.width);
+        }
+        return NccFromSums(integral.Sum(x, y, templ.width, templ.height), (long long)integral.SumSq(x, y, templ.width, templ.height), cross, stats);
+    }
+
+    void NccEngine::ScoreMap(const GrayImage& templ, std::vector<double>& scores) const
+    {
+        int columns = source.width - templ.width + 1;
+        int rows = source.height - templ.height + 1;
+        if (columns <= 0 || rows <= 0) {
+            scores.clear();
+            return;
+        }
+        scores.resize((size_t)columns * rows);
+        TemplateStats stats = ComputeTemplateStats(templ);
+        #pragma omp parallel for schedule(dynamic, 4)
+        for (int y = 0; y < rows; ++y) {
+            for (int x = 0; x < columns; ++x) scores[(size_t)y * columns + x] = Score(x, y, templ, stats);
+        }
+    }
+
+    // Score from the cross term sum(I * T) and the integral tables, same value as MatchScore
+    static double ScoreFromCross(MatchMethod method, const IntegralImage& integral, int x, int y, const GrayImage& templ,
+        const TemplateStats& stats, long long cross)
+    {
+        long long sumSqI = (long long)integral.SumSq(x, y, templ.width, templ.height);
+        if (method == MatchMethod::SSD) {
+            // sum (I - T)^2 = sum I^2 - 2 sum I T + sum T^2
+            return -static_cast<double>(sumSqI - 2 * cross + stats.sumSq);
+        }
+        return NccFromSums(integral.Sum(x, y, templ.width, templ.height), sumSqI, cross, stats);
+    }
+
+    // Best of score(x, y) over all positions, the first in raster order on ties.
+    // Every row keeps its own best and the rows are merged serially: no shared state in the parallel loop
+    template <class ScoreFunction>
+    static MatchCandidate FindBest(int columns, int rows, const ScoreFunction& score)
+    {
+        std::vector<MatchCandidate> rowBest(rows);
+        #pragma omp parallel for schedule(dynamic, 4)
+        for (int y = 0; y < rows; ++y) {
+            MatchCandidate best = { 0, y, score(0, y) };
+            for (int x = 1; x < columns; ++x) {
+                double value = score(x, y);
+                if (value > best.score) best = { x, y, value };
+            }
+            rowBest[y] = best;
+        }
+        MatchCandidate best = rowBest[0];
+        for (const MatchCandidate& candidate : rowBest) {
+            if (candidate.score > best.score) best = candidate;
+        }
+        return best;
+    }
+
+    void NccEngine::Match(const GrayImage& templ, int* outCoords) const
+    {
+        outCoords[0] = 0;
+        outCoords[1] = 0;
+        int columns = source.width - templ.width + 1;
+        int rows = source.height - templ.height + 1;
+        if (columns <= 0 || rows <= 0) return;
+
+        if (PreferFrequencyMatching(source.width, source.height, templ.width, templ.height)) {
+            MatchTemplateFFT_CPU(source, integral, templ, MatchMethod::NCC, outCoords);
+            return;
+        }
+        TemplateStats stats = ComputeTemplateStats(templ);
+        MatchCandidate best = FindBest(columns, rows, [&](int x, int y) { return Score(x, y, templ, stats); });
+        outCoords[0] = best.x;
+        outCoords[1] = best.y;
+    }
+
+    void CrossCorrelateFFT(const GrayImage& source, const GrayImage& templ, std::vector<long long>& cross)
+    {
+        int columns = source.width - templ.width + 1;
+        int rows = source.height - templ.height + 1;
+        int fftWidth = ChooseFFTLength(source.width);
+        int fftHeight = ChooseFFTLength(source.height);
+        std::vector<Complex> spectrum((size_t)fftWidth * fftHeight, Complex{ 0.0, 0.0 });
+
+        #pragma omp parallel for
+        for (int y = 0; y < source.height; ++y) {
+            const unsigned char* sourceRow = source.pixels + (size_t)y * source.stride;
+            Complex* row = &spectrum[(size_t)y * fftWidth];
+            for (int x = 0; x < source.width; ++x) row[x].real = sourceRow[x];
+            if (y < templ.height) {
+                const unsigned char* templateRow = templ.pixels + (size_t)y * templ.stride;
+                for (int x = 0; x < templ.width; ++x) row[x].imag = templateRow[x];
+            }
+        }
+        FFT2D(spectrum.data(), fftWidth, fftHeight, false);
+
+        // Z = I + iT: I(k) = (Z(k) + conj Z(-k)) / 2, T(k) = (Z(k) - conj Z(-k)) / 2i.
+        // The product at -k is the conjugate of the product at k, both are written from the same pair
+        #pragma omp parallel for
+        for (int v = 0; v < fftHeight; ++v) {
+            int mirrorV = (fftHeight - v) % fftHeight;
+            if (mirrorV < v) continue;
+            for (int u = 0; u < fftWidth; ++u) {
+                int mirrorU = (fftWidth - u) % fftWidth;
+                if (mirrorV == v && mirrorU < u) continue;
+                Complex& z = spectrum[(size_t)v * fftWidth + u];
+                Complex& mirror = spectrum[(size_t)mirrorV * fftWidth + mirrorU];
+                Complex sum = { 0.5 * (z.real + mirror.real), 0.5 * (z.imag - mirror.imag) };
+                Complex difference = { 0.5 * (z.imag + mirror.imag), -0.5 * (z.real - mirror.real) };
+                Complex product = sum * Complex{ difference.real, -difference.imag };
+                z = product;
+                mirror = { product.real, -product.imag };
+            }
+        }
+        FFT2D(spectrum.data(), fftWidth, fftHeight, true);
+
+        cross.resize((size_t)columns * rows);
+        #pragma omp parallel for
+        for (int y = 0; y < rows; ++y) {
+            for (int x = 0; x < columns; ++x) {
+                cross[(size_t)y * columns + x] = llround(spectrum[(size_t)y * fftWidth + x].real);
+            }
+        }
+    }
+
+    bool PreferFrequencyMatching(int width, int height, int templateWidth, int templateHeight)
+    {
+        int fftWidth = ChooseFFTLength(width);
+        int fftHeight = ChooseFFTLength(height);
+        if ((double)fftWidth * fftHeight > (double)(1 << 24)) return false;
+
+        // unit: one spatial multiply-add. A point per butterfly stage of the scalar double FFT costs
+        // about as much as 12 of them once the column pass memory traffic is counted (measured on 1024^2),
+        // EstimateFFTCost counts 2 per point and radix-2 stage
+        double spatialCost = (double)(width - templateWidth + 1) * (height - templateHeight + 1) * templateWidth * templateHeight;
+        double frequencyCost = 2.0 * 6.0 * ((double)fftHeight * EstimateFFTCost(fftWidth) + (double)fftWidth * EstimateFFTCost(fftHeight));
+        return frequencyCost < spatialCost;
+    }
+
+    void MatchTemplateFFT_CPU(const GrayImage& source, const IntegralImage& integral, const GrayImage& templ,
+        MatchMethod method, int* outCoords)
+    {
+        outCoords[0] = 0;
+        outCoords[1] = 0;
+        int columns = source.width - templ.width + 1;
+        int rows = source.height - templ.height + 1;
+        if (columns <= 0 || rows <= 0) return;
+
+        std::vector<long long> cross;
+        CrossCorrelateFFT(source, templ, cross);
+        TemplateStats stats = ComputeTemplateStats(templ);
+        MatchCandidate best = FindBest(columns, rows, [&](int x, int y) {
+            return ScoreFromCross(method, integral, x, y, templ, stats, cross[(size_t)y * columns + x]);
+        });
+        outCoords[0] = best.x;
+        outCoords[1] = best.y;
+    }
+
+    // Early-terminating SAD / SSD search of one template, shared by MatchTemplateBounded_CPU and
+    // MatchTemplateBatch_CPU. Bands of rows may be scanned from any thread
+    class BoundedSearch
+    {
+    public:
+        BoundedSearch(const GrayImage& templ, MatchMethod method)
+            : templ(templ), method(method), stats(ComputeTemplateStats(templ)), rowOrder(templ.height), bound(LLONG_MAX)
+        {
+            const SimdKernelTable& simd = ActiveSimdKernels();
+            rowError = (method == MatchMethod::SAD) ? simd.AbsDiffRow : simd.SquaredDiffRow;
+
+            // template rows with the most variance first: they pile up error fastest on a mismatch
+            std::vector<double> rowVariance(templ.height);
+            for (int ty = 0; ty < templ.height; ++ty) {
+                const unsigned char* row = templ.pixels + (size_t)ty * templ.stride;
+                double sum = 0, sumSq = 0;
+                for (int x = 0; x < templ.width; ++x) {
+                    sum += row[x];
+                    sumSq += row[x] * row[x];
+                }
+                rowOrder[ty] = ty;
+                rowVariance[ty] = sumSq - sum * sum / templ.width;
+            }
+            std::stable_sort(rowOrder.begin(), rowOrder.end(), [&](int a, int b) { return rowVariance[a] > rowVariance[b]; });
+        }
+
+        // The bound starts at a real error, a pyramid guess is usually at or next to the best
+        void Seed(const GrayImage& source, int x, int y)
+        {
+            long long error = 0;
+            for (int ty = 0; ty < templ.height; ++ty) {
+                error += rowError(source.pixels + (size_t)(y + ty) * source.stride + x, templ.pixels + (size_t)ty * templ.stride, templ.width);
+            }
+            bound.store(error);
+        }
+
+        // Best window with its top-left corner in rows [yBegin, yEnd), the first in raster order on ties.
+        // Score -1e300 when every window was rejected
+        MatchCandidate ScanRows(const GrayImage& source, const IntegralImage& integral, int yBegin, int yEnd)
+        {
+            int columns = source.width - templ.width + 1;
+            MatchCandidate best = { 0, yBegin, -1e300 };
+            for (int y = yBegin; y < yEnd; ++y) {
+                for (int x = 0; x < columns; ++x) {
+                    long long currentBound = bound.load(std::memory_order_relaxed);
+
+                    // successive elimination: |sum I - sum T| <= SAD and (sum I - sum T)^2 / n <= SSD.
+                    // The SSD test keeps a margin of n for the rounding of the double products
+                    long long sumDifference = (long long)integral.Sum(x, y, templ.width, templ.height) - stats.sum;
+                    if (method == MatchMethod::SAD) {
+                        if (std::llabs(sumDifference) > currentBound) continue;
+                    }
+                    else if ((double)sumDifference * sumDifference > ((double)currentBound + 1.0) * stats.count) {
+                        continue;
+                    }
+
+                    long long error = 0;
+                    for (int i = 0; i < templ.height && error <= currentBound; ++i) {
+                        int ty = rowOrder[i];
+                        error += rowError(source.pixels + (size_t)(y + ty) * source.stride + x, templ.pixels + (size_t)ty * templ.stride, templ.width);
+                    }
+                    if (error > currentBound) continue;
+
+                    if (-(double)error > best.score) best = { x, y, -(double)error };
+                    while (error < currentBound && !bound.compare_exchange_weak(currentBound, error, std::memory_order_relaxed)) {
+                    }
+                }
+            }
+            return best;
+        }
+
+    private:
+        GrayImage templ;
+        MatchMethod method;
+        TemplateStats stats;
+        std::vector<int> rowOrder;
+        long long (*rowError)(const unsigned char* a, const unsigned char* b, int length);
+        std::atomic<long long> bound; // lowest error seen by any thread
+    };
+
+    void MatchTemplateBounded_CPU(const GrayImage& source, const GrayImage& templ, MatchMethod method, int* outCoords)
+    {
+        outCoords[0] = 0;
+        outCoords[1] = 0;
+        int columns = source.width - templ.width + 1;
+        int rows = source.height - templ.height + 1;
+        if (columns <= 0 || rows <= 0) return;
+
+        BoundedSearch search(templ, method);
+        int seed[2] = { 0, 0 };
+        if (ChoosePyramidLevels(templ.width, templ.height) > 0) MatchTemplatePyramid_CPU(source, templ, method, -1, 1, seed);
+        search.Seed(source, seed[0], seed[1]);
+
+        IntegralImage integral(source);
+        std::vector<MatchCandidate> rowBest(rows);
+        #pragma omp parallel for schedule(dynamic, 4)
+        for (int y = 0; y < rows; ++y) rowBest[y] = search.ScanRows(source, integral, y, y + 1);
+
+        // a window is only dropped once its error exceeds one reached elsewhere, so the rows still hold
+        // the minimum and its first position in raster order
+        MatchCandidate best = rowBest[0];
+        for (const MatchCandidate& candidate : rowBest) {
+            if (candidate.score > best.score) best = candidate;
+        }
+        outCoords[0] = best.x;
+        outCoords[1] = best.y;
+    }
+
+    void MatchTemplate_CPU(const GrayImage& source, const GrayImage& templ, MatchMethod method, int* outCoords)
+    {
+        outCoords[0] = 0;
+        outCoords[1] = 0;
+        int columns = source.width - templ.width + 1;
+        int rows = source.height - templ.height + 1;
+        if (columns <= 0 || rows <= 0) return;
+
+        if (method == MatchMethod::NCC) {
+            NccEngine(source).Match(templ, outCoords);
+            return;
+        }
+        if (method == MatchMethod::SSD && PreferFrequencyMatching(source.width, source.height, templ.width, templ.height)) {
+            MatchTemplateFFT_CPU(source, IntegralImage(source), templ, method, outCoords);
+            return;
+        }
+        MatchTemplateBounded_CPU(source, templ, method, outCoords);
+    }
+
+    void ComputeScoreMap(const GrayImage& source, const GrayImage& templ, MatchMethod method, std::vector<double>& scores)
+    {
+        int columns = source.width - templ.width + 1;
+        int rows = source.height - templ.height + 1;
+        scores.clear();
+        if (columns <= 0 || rows <= 0) return;
+
+        bool isFrequency = method != MatchMethod::SAD && PreferFrequencyMatching(source.width, source.height, templ.width, templ.height);
+        if (method == MatchMethod::NCC && !isFrequency) {
+            NccEngine(source).ScoreMap(templ, scores);
+            return;
+        }
+
+        TemplateStats stats = ComputeTemplateStats(templ);
+        scores.resize((size_t)columns * rows);
+        if (isFrequency) {
+            IntegralImage integral(source);
+            std::vector<long long> cross;
+            CrossCorrelateFFT(source, templ, cross);
+            #pragma omp parallel for
+            for (int y = 0; y < rows; ++y) {
+                for (int x = 0; x < columns; ++x) {
+                    size_t index = (size_t)y * columns + x;
+                    scores[index] = ScoreFromCross(method, integral, x, y, templ, stats, cross[index]);
+                }
+            }
+            return;
+        }
+        #pragma omp parallel for schedule(dynamic, 4)
+        for (int y = 0; y < rows; ++y) {
+            for (int x = 0; x < columns; ++x) scores[(size_t)y * columns + x] = MatchScore(method, source, x, y, templ, stats);
+        }
+    }
+
+    // Raster order breaks ties, so equal scores always come out in the same order
+    static bool IsBetter(const MatchCandidate& a, const MatchCandidate& b)
+    {
+        if (a.score != b.score) return a.score > b.score;
+        return (a.y != b.y) ? a.y < b.y : a.x < b.x;
+    }
+
+    // 3x3 local maximum; on a plateau only the first position in raster order qualifies
+    static bool IsLocalMaximum(const std::vector<double>& scores, int columns, int rows, int x, int y)
+    {
+        double center = scores[(size_t)y * columns + x];
+        for (int dy = -1; dy <= 1; ++dy) {
+            int ny = y + dy;
+            if (ny < 0 || ny >= rows) continue;
+            for (int dx = -1; dx <= 1; ++dx) {
+                int nx = x + dx;
+                if ((dx == 0 && dy == 0) || nx < 0 || nx >= columns) continue;
+                double neighbor = scores[(size_t)ny * columns + nx];
+                bool isEarlier = dy < 0 || (dy == 0 && dx < 0);
+                if (neighbor > center || (neighbor == center && isEarlier)) return false;
+            }
+        }
+        return true;
+    }
+
+    std::vector<MatchCandidate> SelectPeaks(const std::vector<double>& scores, int columns, int rows, int count, int radius)
+    {
+        std::vector<MatchCandidate> peaks;
+        if (count <= 0 || scores.empty()) return peaks;
+
+        // Every thread keeps its own bounded min-heap of local maxima, the heaps are merged after the
+        // parallel loop, so no lock or atomic is involved. Greedy suppression may discard more
+        // candidates than `count`: when a heap overflowed and too few peaks survive, retry deeper
+        for (int capacity = 4 * count + 16; ; capacity *= 4) {
+            std::vector<std::vector<MatchCandidate>> threadHeaps(omp_get_max_threads());
+            std::vector<char> threadTruncated(threadHeaps.size(), 0);
+            #pragma omp parallel
+            {
+                std::vector<MatchCandidate>& heap = threadHeaps[omp_get_thread_num()];
+                char& isHeapTruncated = threadTruncated[omp_get_thread_num()];
+                #pragma omp for schedule(static)
+                for (int y = 0; y < rows; ++y) {
+                    for (int x = 0; x < columns; ++x) {
+                        if (!IsLocalMaximum(scores, columns, rows, x, y)) continue;
+                        MatchCandidate candidate = { x, y, scores[(size_t)y * columns + x] };
+                        if ((int)heap.size() < capacity) {
+                            heap.push_back(candidate);
+                            std::push_heap(heap.begin(), heap.end(), IsBetter);
+                        }
+                        else {
+                            isHeapTruncated = 1;
+                            if (IsBetter(candidate, heap.front())) {
+                                std::pop_heap(heap.begin(), heap.end(), IsBetter);
+                                heap.back() = candidate;
+                                std::push_heap(heap.begin(), heap.end(), IsBetter);
+                            }
+                        }
+                    }
+                }
+            }
+            bool isTruncated = std::find(threadTruncated.begin(), threadTruncated.end(), 1) != threadTruncated.end();
+
+            std::vector<MatchCandidate> candidates;
+            for (const std::vector<MatchCandidate>& heap : threadHeaps) candidates.insert(candidates.end(), heap.begin(), heap.end());
+            std::sort(candidates.begin(), candidates.end(), IsBetter);
+
+            peaks.clear();
+            for (const MatchCandidate& candidate : candidates) {
+                if ((int)peaks.size() >= count) break;
+                bool isSuppressed = std::any_of(peaks.begin(), peaks.end(), [&](const MatchCandidate& peak) {
+                    return std::abs(peak.x - candidate.x) <= radius && std::abs(peak.y - candidate.y) <= radius;
+                });
+                if (!isSuppressed) peaks.push_back(candidate);
+            }
+            if ((int)peaks.size() >= count || !isTruncated) return peaks;
+        }
+    }
+
+    // Vertex of the parabola through (-1, left), (0, center), (1, right), within half a pixel
+    static double ParabolicOffset(double left, double center, double right)
+    {
+        double curvature = left - 2.0 * center + right;
+        if (curvature >= 0) return 0.0;
+        double offset = 0.5 * (left - right) / curvature;
+        return std::max(-0.5, std::min(0.5, offset));
+    }
+
+    std::vector<MatchPeak> FindMatchPeaks_CPU(const GrayImage& source, const GrayImage& templ, MatchMethod method,
+        int maxPeaks, int minDistance)
+    {
+        std::vector<MatchPeak> result;
+        std::vector<double> scores;
+        ComputeScoreMap(source, templ, method, scores);
+        if (scores.empty()) return result;
+
+        int columns = source.width - templ.width + 1;
+        int rows = source.height - templ.height + 1;
+        if (minDistance <= 0) minDistance = std::max(1, std::min(templ.width, templ.height) / 2);
+        std::vector<MatchCandidate> peaks = SelectPeaks(scores, columns, rows, maxPeaks, minDistance - 1);
+
+        for (const MatchCandidate& peak : peaks) {
+            const double* center = &scores[(size_t)peak.y * columns + peak.x];
+            double offsetX = (peak.x > 0 && peak.x < columns - 1) ? ParabolicOffset(center[-1], center[0], center[1]) : 0.0;
+            double offsetY = (peak.y > 0 && peak.y < rows - 1) ? ParabolicOffset(center[-columns], center[0], center[columns]) : 0.0;
+            // SAD / SSD report the error itself, not the negated score
+            double score = (method == MatchMethod::NCC) ? peak.score : -peak.score;
+            result.push_back({ peak.x + offsetX, peak.y + offsetY, score });
+        }
+        return result;
+    }
+
+    int ChoosePyramidLevels(int templateWidth, int templateHeight)
+    {
+        int shortSide = std::min(templateWidth, templateHeight);
+        int levels = 0;
+        while ((shortSide >> (levels + 1)) >= 8) levels++;
+        return levels;
+    }
+
+    // Body of MatchTemplatePyramid_CPU. The source pyramid may hold more than levels + 1 levels,
+    // so a batch builds it once for all its templates
+    static void MatchOnPyramids(const GrayPyramid& sourcePyramid, const GrayPyramid& templatePyramid, MatchMethod method,
+        int levels, int candidates, int* outCoords)
+    {
+        // exhaustive search at the coarsest level
+        const GrayImage& coarseSource = sourcePyramid.Level(levels);
+        const GrayImage& coarseTemplate = templatePyramid.Level(levels);
+        TemplateStats coarseStats = ComputeTemplateStats(coarseTemplate);
+        int columns = coarseSource.width - coarseTemplate.width + 1;
+        int rows = coarseSource.height - coarseTemplate.height + 1;
+        std::vector<double> scores;
+        if (method == MatchMethod::NCC) {
+            NccEngine(coarseSource).ScoreMap(coarseTemplate, scores);
+        }
+        else {
+            scores.resize((size_t)columns * rows);
+            #pragma omp parallel for
+            for (int y = 0; y < rows; ++y) {
+                for (int x = 0; x < columns; ++x) {
+                    scores[(size_t)y * columns + x] = MatchScore(method, coarseSource, x, y, coarseTemplate, coarseStats);
+                }
+            }
+        }
+        int radius = std::max(1, std::min(coarseTemplate.width, coarseTemplate.height) / 4);
+        std::vector<MatchCandidate> current = SelectPeaks(scores, columns, rows, candidates, radius);
+
+        // each candidate moves to the best position within +-2 of its upsampled location
+        for (int level = levels - 1; level >= 0; --level) {
+            const GrayImage& levelSource = sourcePyramid.Level(level);
+            const GrayImage& levelTemplate = templatePyramid.Level(level);
+            TemplateStats stats = ComputeTemplateStats(levelTemplate);
+            int maxX = levelSource.width - levelTemplate.width;
+            int maxY = levelSource.height - levelTemplate.height;
+
+            std::vector<MatchCandidate> refined(current.size());
+            #pragma omp parallel for
+            for (int i = 0; i < (int)current.size(); ++i) {
+                MatchCandidate best = { 0, 0, -1e300 };
+                for (int y = std::max(2 * current[i].y - 2, 0); y <= std::min(2 * current[i].y + 2, maxY); ++y) {
+                    for (int x = std::max(2 * current[i].x - 2, 0); x <= std::min(2 * current[i].x + 2, maxX); ++x) {
+                        double score = MatchScore(method, levelSource, x, y, levelTemplate, stats);
+                        if (score > best.score || (score == best.score && (y < best.y || (y == best.y && x < best.x)))) {
+                            best = { x, y, score };
+                        }
+                    }
+                }
+                refined[i] = best;
+            }
+
+            // candidates that converged onto the same position count once
+            std::stable_sort(refined.begin(), refined.end(), [](const MatchCandidate& a, const MatchCandidate& b) {
+                return a.score > b.score || (a.score == b.score && (a.y < b.y || (a.y == b.y && a.x < b.x)));
+            });
+            current.clear();
+            for (const MatchCandidate& candidate : refined) {
+                bool isDuplicate = std::any_of(current.begin(), current.end(),
+                    [&](const MatchCandidate& kept) { return kept.x == candidate.x && kept.y == candidate.y; });
+                if (!isDuplicate) current.push_back(candidate);
+            }
+        }
+
+        if (current.empty()) return;
+        outCoords[0] = current[0].x;
+        outCoords[1] = current[0].y;
+    }
+
+    void MatchTemplatePyramid_CPU(const GrayImage& source, const GrayImage& templ, MatchMethod method,
+        int levels, int candidates, int* outCoords)
+    {
+        outCoords[0] = 0;
+        outCoords[1] = 0;
+        if (templ.width > source.width || templ.height > source.height) return;
+
+        if (levels < 0) levels = ChoosePyramidLevels(templ.width, templ.height);
+        GrayPyramid sourcePyramid(source, levels + 1);
+        GrayPyramid templatePyramid(templ, levels + 1);
+        MatchOnPyramids(sourcePyramid, templatePyramid, method, levels, std::max(candidates, 1), outCoords);
+    }
+
+    void MatchTemplateBatch_CPU(const GrayImage& source, const std::vector<GrayImage>& templates, MatchMethod method, int* outCoords)
+    {
+        int count = static_cast<int>(templates.size());
+        std::fill(outCoords, outCoords + 2 * count, 0);
+
+        // source side, once for the batch: integral tables (NCC window statistics, the successive
+        // elimination bound, the FFT scores) and the pyramid seeding the SAD / SSD bounds
+        NccEngine engine(source);
+        const IntegralImage& integral = engine.Integral();
+        std::vector<int> spatial;
+        int pyramidLevels = 0;
+        for (int i = 0; i < count; ++i) {
+            const GrayImage& templ = templates[i];
+            if (templ.width > source.width || templ.height > source.height) continue;
+            if (method != MatchMethod::SAD && PreferFrequencyMatching(source.width, source.height, templ.width, templ.height)) {
+                MatchTemplateFFT_CPU(source, integral, templ, method, outCoords + 2 * i);
+                continue;
+            }
+            spatial.push_back(i);
+            if (method != MatchMethod::NCC) pyramidLevels = std::max(pyramidLevels, ChoosePyramidLevels(templ.width, templ.height));
+        }
+        if (spatial.empty()) return;
+
+        std::vector<std::unique_ptr<BoundedSearch>> searches(count);
+        std::vector<TemplateStats> stats(count);
+        if (method == MatchMethod::NCC) {
+            for (int i : spatial) stats[i] = ComputeTemplateStats(templates[i]);
+        }
+        else {
+            GrayPyramid sourcePyramid(source, pyramidLevels + 1);
+            for (int i : spatial) {
+                const GrayImage& templ = templates[i];
+                searches[i].reset(new BoundedSearch(templ, method));
+                int levels = ChoosePyramidLevels(templ.width, templ.height);
+                int seed[2] = { 0, 0 };
+                if (levels > 0) MatchOnPyramids(sourcePyramid, GrayPyramid(templ, levels + 1), method, levels, 1, seed);
+                searches[i]->Seed(source, seed[0], seed[1]);
+            }
+        }
+
+        // (template, band of 8 candidate rows) work items, one parallel loop for the whole batch.
+        // Items run template by template, so the threads tighten one SAD / SSD bound together
+        struct WorkItem {
+            int templateIndex;
+            int yBegin;
+            int yEnd;
+        };
+        const int bandHeight = 8;
+        std::vector<WorkItem> items;
+        for (int i : spatial) {
+            int rows = source.height - templates[i].height + 1;
+            for (int y = 0; y < rows; y += bandHeight) items.push_back({ i, y, std::min(y + bandHeight, rows) });
+        }
+
+        std::vector<MatchCandidate> itemBest(items.size());
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (int k = 0; k < (int)items.size(); ++k) {
+            const WorkItem& item = items[k];
+            const GrayImage& templ = templates[item.templateIndex];
+            if (searches[item.templateIndex]) {
+                itemBest[k] = searches[item.templateIndex]->ScanRows(source, integral, item.yBegin, item.yEnd);
+                continue;
+            }
+            int columns = source.width - templ.width + 1;
+            MatchCandidate best = { 0, item.yBegin, -1e300 };
+            for (int y = item.yBegin; y < item.yEnd; ++y) {
+                for (int x = 0; x < columns; ++x) {
+                    double score = engine.Score(x, y, templ, stats[item.templateIndex]);
+                    if (score > best.score) best = { x, y, score };
+                }
+            }
+            itemBest[k] = best;
+        }
+
+        // bands of a template are in raster order: strict comparison keeps the first of equal scores
+        std::vector<MatchCandidate> best(count, MatchCandidate{ 0, 0, -1e301 });
+        for (size_t k = 0; k < items.size(); ++k) {
+            MatchCandidate& templateBest = best[items[k].templateIndex];
+            if (itemBest[k].score > templateBest.score) templateBest = itemBest[k];
+        }
+        for (int i : spatial) {
+            outCoords[2 * i] = best[i].x;
+            outCoords[2 * i + 1] = best[i].y;
+        }
+    }
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <vector>
+
+namespace ImaGyNative
+{
+    // Codes used by the NativeCore matching entry points
+    enum class MatchMethod {
+        NCC = 0,
+        SAD = 1,
+        SSD = 2
+    };
+
+    // Read-only 8-bit grayscale image
+    struct GrayImage {
+        const unsigned char* pixels;
+        int width;
+        int height;
+        int stride;
+    };
+
+    // Gaussian pyramid: level 0 is the input (not copied), level l + 1 is level l blurred with the
+    // binomial [1 4 6 4 1] / 16 and subsampled by 2, reflecting at the border
+    class GrayPyramid
+    {
+    public:
+        GrayPyramid(const GrayImage& image, int levelCount);
+
+        int LevelCount() const { return static_cast<int>(levels.size()); }
+        const GrayImage& Level(int level) const { return levels[level]; }
+
+    private:
+        std::vector<GrayImage> levels;
+        std::vector<std::vector<unsigned char>> buffers; // levels 1..
+    };
+
+    // Template sums for MatchScore
+    struct TemplateStats {
+        long long sum;
+        long long sumSq;
+        long long count;
+    };
+    TemplateStats ComputeTemplateStats(const GrayImage& templ);
+
+    // Score of the template placed with its top-left corner at (x, y), higher is better for every method:
+    // NCC is the correlation coefficient in [-1, 1] (0 for flat windows), SAD and SSD are the negated error
+    double MatchScore(MatchMethod method, const GrayImage& source, int x, int y, const GrayImage& templ, const TemplateStats& stats);
+
+    // Summed-area tables of an image and of its squared pixels, with a zero row and column in front,
+    // so any window sum is four lookups. The tables wrap modulo 2^32 / 2^64, window sums are still
+    // exact while the true sum fits: windows up to 16.8M pixels
+    class IntegralImage
+    {
+    public:
+        explicit IntegralImage(const GrayImage& image);
+
+        unsigned int Sum(int x, int y, int width, int height) const;
+        unsigned long long SumSq(int x, int y, int width, int height) const;
+
+    private:
+        int columns; // image width + 1
+        std::vector<unsigned int> sum;
+        std::vector<unsigned long long> sumSq;
+    };
+
+    // NCC against one source image. The integral tables are built once per source, so the window
+    // mean and variance cost O(1) per position and only the cross term sum(I * T) is computed,
+    // one SIMD dot product (SimdKernelTable::DotRow) per template row.
+    // Keep the engine alive to match several templates against the same frame
+    class NccEngine
+    {
+    public:
+        explicit NccEngine(const GrayImage& source);
+
+        const GrayImage& Source() const { return source; }
+
+        // Same value as MatchScore(MatchMethod::NCC, ...)
+        double Score(int x, int y, const GrayImage& templ, const TemplateStats& stats) const;
+
+        // scores[y * (source width - template width + 1) + x] for every position
+        void ScoreMap(const GrayImage& templ, std::vector<double>& scores) const;
+
+        // Best position, the first in raster order on ties.
+        // Large templates go through the frequency domain (PreferFrequencyMatching)
+        void Match(const GrayImage& templ, int* outCoords) const;
+
+        const IntegralImage& Integral() const { return integral; }
+
+    private:
+        GrayImage source;
+        IntegralImage integral;
+    };
+
+    struct MatchCandidate {
+        int x;
+        int y;
+        double score;
+    };
+
+    // Cross term sum(I * T) of every position, cross[y * (W - Tw + 1) + x], through the frequency domain.
+    // Source (real part) and template (imaginary part) share one forward transform at a size covering
+    // the source (ChooseFFTLength), so the circular correlation never wraps into a valid position.
+    // The spectra are separated by Hermitian symmetry, multiplied as I * conj(T) and transformed back.
+    // Results are rounded to the exact integer sums
+    void CrossCorrelateFFT(const GrayImage& source, const GrayImage& templ, std::vector<long long>& cross);
+
+    // Crossover between the spatial loops (one multiply-add per template pixel and position)
+    // and CrossCorrelateFFT (two 2-D transforms). Large templates, from about 32x32, win in
+    // the frequency domain. Spectra above 16M points stay spatial to bound memory
+    bool PreferFrequencyMatching(int width, int height, int templateWidth, int templateHeight);
+
+    // NCC or SSD from CrossCorrelateFFT and the integral tables of the source, same scores as
+    // MatchScore. SAD has no correlation form and always runs spatially
+    void MatchTemplateFFT_CPU(const GrayImage& source, const IntegralImage& integral, const GrayImage& templ,
+        MatchMethod method, int* outCoords);
+
+    // SAD or SSD with early termination, same position as the exhaustive search. All threads share
+    // the lowest error found so far (seeded from a pyramid match). A window is rejected outright when
+    // its sum alone proves it worse (successive elimination), otherwise its error is accumulated one
+    // SIMD row at a time (AbsDiffRow / SquaredDiffRow), high-variance template rows first, and
+    // abandoned as soon as it passes the bound
+    void MatchTemplateBounded_CPU(const GrayImage& source, const GrayImage& templ, MatchMethod method, int* outCoords);
+
+    // Best position for any method, the first in raster order on ties: NCC through NccEngine,
+    // SSD through the FFT for large templates, otherwise MatchTemplateBounded_CPU
+    void MatchTemplate_CPU(const GrayImage& source, const GrayImage& templ, MatchMethod method, int* outCoords);
+
+    // MatchScore of every position, scores[y * (W - Tw + 1) + x], by the same paths as MatchTemplate_CPU
+    void ComputeScoreMap(const GrayImage& source, const GrayImage& templ, MatchMethod method, std::vector<double>& scores);
+
+    // Up to `count` 3x3 local maxima of a score map (scores[y * columns + x]), best first.
+    // A maximum is skipped when a better one already taken lies within `radius` in both axes
+    std::vector<MatchCandidate> SelectPeaks(const std::vector<double>& scores, int columns, int rows, int count, int radius);
+
+    struct MatchPeak {
+        double x;
+        double y;
+        double score; // NCC coefficient, or the SAD / SSD error
+    };
+
+    // Up to maxPeaks matches, best first, at least minDistance pixels apart in x or y
+    // (<= 0: half the template's short side). Each position is refined to sub-pixel by a parabola
+    // through the neighboring scores in x and in y
+    std::vector<MatchPeak> FindMatchPeaks_CPU(const GrayImage& source, const GrayImage& templ, MatchMethod method,
+        int maxPeaks, int minDistance);
+
+    // Levels below full resolution the pyramid matcher uses: the template keeps at least
+    // 8 pixels on its short side at the coarsest level
+    int ChoosePyramidLevels(int templateWidth, int templateHeight);
+
+    // Coarse-to-fine matching: exhaustive search at the coarsest level, then only the `candidates`
+    // best positions (non-maximum suppressed) are refined within +-2 pixels at each finer level.
+    // Returns the same position as full-resolution search whenever the true peak is among the
+    // coarse candidates, which holds for templates with structure at the coarse scale
+    void MatchTemplatePyramid_CPU(const GrayImage& source, const GrayImage& templ, MatchMethod method,
+        int levels, int candidates, int* outCoords);
+
+    // Best position of every template (outCoords[2 * i], outCoords[2 * i + 1]), the same as
+    // MatchTemplate_CPU for each. The source integral tables and pyramid are built once for the batch,
+    // (template, band of rows) work items share one parallel loop. Templates larger than the source get (0, 0)
+    void MatchTemplateBatch_CPU(const GrayImage& source, const std::vector<GrayImage>& templates, MatchMethod method, int* outCoords);
+}
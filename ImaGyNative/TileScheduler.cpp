@@ -0,0 +1,181 @@
+#include "pch.h"
+#include "TileScheduler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <omp.h>
+
+namespace ImaGyNative
+{
+    static size_t tileBudget = 256 * 1024;
+
+    void SetTileBudget(size_t bytes)
+    {
+        tileBudget = std::max<size_t>(bytes, 16 * 1024);
+    }
+
+    size_t GetTileBudget()
+    {
+        return tileBudget;
+    }
+
+    TileGrid ChooseTileGrid(int width, int height, int pixelBytes, int border)
+    {
+        int halo = 2 * border;
+        size_t imageBytes = (size_t)(width + halo) * (height + halo) * pixelBytes;
+        if (imageBytes <= tileBudget) return { width, height, 1, 1 };
+
+        // roughly square in pixels, never thinner than the halo so the copy overhead stays bounded.
+        // Widths are multiples of 64 pixels, a whole number of vectors for every SIMD backend
+        int side = static_cast<int>(std::sqrt(static_cast<double>(tileBudget) / pixelBytes));
+        int tileWidth = std::max(side - halo, halo);
+        tileWidth = std::min(width, std::max(64, tileWidth / 64 * 64));
+        int tileHeight = static_cast<int>(tileBudget / ((size_t)(tileWidth + halo) * pixelBytes)) - halo;
+        tileHeight = std::min(height, std::max(tileHeight, std::max(halo, 16)));
+
+        int columns = (width + tileWidth - 1) / tileWidth;
+        int rows = (height + tileHeight - 1) / tileHeight;
+        int threads = omp_get_max_threads();
+        if (columns * rows < threads) {
+            int wantedRows = (threads + columns - 1) / columns;
+            tileHeight = std::max(1, (height + wantedRows - 1) / wantedRows);
+            rows = (height + tileHeight - 1) / tileHeight;
+        }
+        return { tileWidth, tileHeight, columns, rows };
+    }
+
+    // Original pixels within `border` of every internal tile boundary, copied before any tile is written.
+    // Row boundary b (1 <= b < rows) sits at y = b * tileHeight and keeps full rows,
+    // column boundary b sits at x = b * tileWidth and keeps 2 * border pixels of every row
+    class HaloSnapshot
+    {
+    public:
+        HaloSnapshot(const unsigned char* pixels, int width, int height, int stride, int pixelBytes, int border, const TileGrid& grid)
+            : grid(grid), pixelBytes(pixelBytes), border(border), rowBytes(width * pixelBytes),
+            rowBands(grid.rows), columnBands(grid.columns)
+        {
+            #pragma omp parallel for
+            for (int b = 1; b < grid.rows; ++b) {
+                rowBands[b].resize((size_t)2 * border * rowBytes);
+                int first = b * grid.tileHeight - border;
+                for (int y = std::max(first, 0); y < std::min(first + 2 * border, height); ++y) {
+                    memcpy(&rowBands[b][(size_t)(y - first) * rowBytes], pixels + (size_t)y * stride, rowBytes);
+                }
+            }
+
+            int bandBytes = 2 * border * pixelBytes;
+            for (int b = 1; b < grid.columns; ++b) columnBands[b].resize((size_t)height * bandBytes);
+            #pragma omp parallel for
+            for (int y = 0; y < height; ++y) {
+                const unsigned char* sourceRow = pixels + (size_t)y * stride;
+                for (int b = 1; b < grid.columns; ++b) {
+                    int first = b * grid.tileWidth - border;
+                    int begin = std::max(first, 0);
+                    int end = std::min(first + 2 * border, width);
+                    memcpy(&columnBands[b][(size_t)y * bandBytes + (begin - first) * pixelBytes],
+                        sourceRow + begin * pixelBytes, (end - begin) * pixelBytes);
+                }
+            }
+        }
+
+        // Pixel x = 0 of image row y, for rows within border of row boundary b
+        const unsigned char* Row(int b, int y) const
+        {
+            return &rowBands[b][(size_t)(y - (b * grid.tileHeight - border)) * rowBytes];
+        }
+
+        // Image pixel (x, y), for columns within border of column boundary b
+        const unsigned char* Pixel(int b, int x, int y) const
+        {
+            return &columnBands[b][(size_t)y * 2 * border * pixelBytes + (x - (b * grid.tileWidth - border)) * pixelBytes];
+        }
+
+    private:
+        TileGrid grid;
+        int pixelBytes;
+        int border;
+        int rowBytes;
+        std::vector<std::vector<unsigned char>> rowBands;
+        std::vector<std::vector<unsigned char>> columnBands;
+    };
+
+    // Copies tile (column, row) and its halo into `tile`. Rows and columns the tile owns are read
+    // from the image, they are untouched until this tile's operator runs. Everything else is
+    // within border of a tile boundary and comes from the snapshot when processing in place
+    static void FillTile(PaddedImage& tile, const unsigned char* pixels, int width, int height, int stride,
+        int pixelBytes, int border, BorderPolicy policy, const TileGrid& grid, int column, int row, const HaloSnapshot* snapshot)
+    {
+        int x0 = column * grid.tileWidth;
+        int y0 = row * grid.tileHeight;
+        int tileWidth = std::min(grid.tileWidth, width - x0);
+        int tileHeight = std::min(grid.tileHeight, height - y0);
+        int x1 = x0 + tileWidth;
+        int y1 = y0 + tileHeight;
+        tile.Resize(tileWidth, tileHeight, pixelBytes, border);
+
+        for (int ty = -border; ty < tileHeight + border; ++ty) {
+            unsigned char* paddedRow = tile.MutableRow(ty);
+            int sourceY = BorderIndex(y0 + ty, height, policy.mode);
+            if (sourceY < 0) {
+                memset(paddedRow - border * pixelBytes, policy.constantValue, (tileWidth + 2 * border) * pixelBytes);
+                continue;
+            }
+
+            bool isOwnRow = sourceY >= y0 && sourceY < y1;
+            const unsigned char* sourceRow = pixels + (size_t)sourceY * stride;
+            if (snapshot != nullptr && !isOwnRow) sourceRow = snapshot->Row(sourceY < y0 ? row : row + 1, sourceY);
+            memcpy(paddedRow, sourceRow + x0 * pixelBytes, tileWidth * pixelBytes);
+
+            for (int i = 1; i <= border; ++i) {
+                int targets[2] = { -i, tileWidth - 1 + i };
+                for (int tx : targets) {
+                    unsigned char* target = paddedRow + tx * pixelBytes;
+                    int sourceX = BorderIndex(x0 + tx, width, policy.mode);
+                    if (sourceX < 0) {
+                        memset(target, policy.constantValue, pixelBytes);
+                    }
+                    else if (snapshot != nullptr && isOwnRow && (sourceX < x0 || sourceX >= x1)) {
+                        memcpy(target, snapshot->Pixel(sourceX < x0 ? column : column + 1, sourceX, sourceY), pixelBytes);
+                    }
+                    else {
+                        memcpy(target, sourceRow + sourceX * pixelBytes, pixelBytes);
+                    }
+                }
+            }
+        }
+    }
+
+    void ForEachTile(const unsigned char* sourcePixels, unsigned char* destPixels, int width, int height, int stride,
+        int pixelBytes, int border, const TileOperator& op)
+    {
+        BorderPolicy policy = GetBorderPolicy();
+        TileGrid grid = ChooseTileGrid(width, height, pixelBytes, border);
+        int tileCount = grid.columns * grid.rows;
+        if (tileCount == 1) {
+            // small image: one padded copy, the operator's own row loop does the threading
+            PaddedImage padded(sourcePixels, width, height, stride, pixelBytes, border, policy);
+            op(padded, destPixels);
+            return;
+        }
+
+        std::unique_ptr<HaloSnapshot> snapshot;
+        if (sourcePixels == destPixels) {
+            snapshot.reset(new HaloSnapshot(sourcePixels, width, height, stride, pixelBytes, border, grid));
+        }
+
+        // operators keep their own omp loops, nested inside this one they run on the calling thread
+        #pragma omp parallel
+        {
+            PaddedImage tile;
+            #pragma omp for schedule(dynamic)
+            for (int i = 0; i < tileCount; ++i) {
+                int column = i % grid.columns;
+                int row = i / grid.columns;
+                FillTile(tile, sourcePixels, width, height, stride, pixelBytes, border, policy, grid, column, row, snapshot.get());
+                op(tile, destPixels + (size_t)row * grid.tileHeight * stride + (size_t)column * grid.tileWidth * pixelBytes);
+            }
+        }
+    }
+}
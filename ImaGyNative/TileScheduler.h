@@ -0,0 +1,36 @@
+#pragma once
+
+#include "BorderHandling.h"
+#include <cstddef>
+#include <functional>
+
+namespace ImaGyNative
+{
+    // Padded input bytes one tile may occupy. Sized for a per-core L2 with room left
+    // for the operator's own row buffers
+    void SetTileBudget(size_t bytes);
+    size_t GetTileBudget();
+
+    struct TileGrid {
+        int tileWidth;
+        int tileHeight;
+        int columns;
+        int rows;
+    };
+
+    // Tiles of about GetTileBudget() bytes including a `border` halo, at least one tile per thread
+    // when the image is large enough. Images that fit the budget are a single tile
+    TileGrid ChooseTileGrid(int width, int height, int pixelBytes, int border);
+
+    // tile: the tile's pixels with `border` halo pixels on every side (original values, border policy
+    // outside the image). tileDest: pixel (0, 0) of the tile in the destination, rows are `stride` apart.
+    // The operator must write exactly the tile's Width() x Height() pixels through tileDest.
+    // The tile is scratch for the operator, which may Expand it (Pipeline runs its first stage that way)
+    using TileOperator = std::function<void(PaddedImage& tile, unsigned char* tileDest)>;
+
+    // Runs op on every tile, tiles in parallel.
+    // sourcePixels may be the same buffer as destPixels: then only the halo rows and columns along
+    // the tile boundaries are copied up front, instead of the whole image
+    void ForEachTile(const unsigned char* sourcePixels, unsigned char* destPixels, int width, int height, int stride,
+        int pixelBytes, int border, const TileOperator& op);
+}
@@ -3,6 +3,7 @@
 
 // Allows managed code to get a native pointer to the underlying buffer of a managed array.
 #include <vcclr.h>
+#include <vector>
 
 namespace ImaGy
 {
@@ -24,6 +25,18 @@ namespace ImaGy
             ImaGyNative::NativeCore::ApplyKMeansClustering(pixels.ToPointer(), width, height, stride, k, iteration, location);
 
         }
+        void NativeProcessor::ApplyKMeansClusteringHistogram(IntPtr pixels, int width, int height, int stride, int k, int iteration, int bitsPerChannel)
+        {
+            ImaGyNative::NativeCore::ApplyKMeansClusteringHistogram(pixels.ToPointer(), width, height, stride, k, iteration, bitsPerChannel);
+        }
+        void NativeProcessor::ApplyGmmSegmentation(IntPtr pixels, int width, int height, int stride, int numClusters)
+        {
+            ImaGyNative::NativeCore::ApplyGmmSegmentation(pixels.ToPointer(), width, height, stride, numClusters);
+        }
+        void NativeProcessor::ApplyGmmSegmentationColor(IntPtr pixels, int width, int height, int stride, int numClusters)
+        {
+            ImaGyNative::NativeCore::ApplyGmmSegmentationColor(pixels.ToPointer(), width, height, stride, numClusters);
+        }
         void NativeProcessor::ApplyEqualization(IntPtr pixels, int width, int height, int stride, Byte threshold)
         {
             ImaGyNative::NativeCore::ApplyEqualization(pixels.ToPointer(), width, height, stride, threshold);
@@ -68,6 +81,24 @@ namespace ImaGy
             ImaGyNative::NativeCore::ApplyAxialBandStopFilter(pixels.ToPointer(), width, height, stride, lowFreqRadius, bandThickness);
         }
 
+        void NativeProcessor::ApplyFrequencyMaskFilter(IntPtr pixels, int width, int height, int stride, int maskType, double cutoff, double bandwidth, int order)
+        {
+            ImaGyNative::NativeCore::ApplyFrequencyMaskFilter(pixels.ToPointer(), width, height, stride, maskType, cutoff, bandwidth, order);
+        }
+
+        void NativeProcessor::ApplyNotchFilter(IntPtr pixels, int width, int height, int stride, array<double>^ notchCenters, double radius, int order)
+        {
+            int count = notchCenters->Length / 2;
+            std::vector<double> centers(2 * count);
+            for (int i = 0; i < 2 * count; ++i) centers[i] = notchCenters[i];
+            ImaGyNative::NativeCore::ApplyNotchFilter(pixels.ToPointer(), width, height, stride, centers.data(), count, radius, order);
+        }
+
+        void NativeProcessor::ClearSpectrumCache()
+        {
+            ImaGyNative::NativeCore::ClearSpectrumCache();
+        }
+
         void NativeProcessor::ApplyFFTColor(IntPtr pixels, int width, int height, int stride, int kernelSize, bool isInverse, bool isCPU, bool isPhase)
         {
             ImaGyNative::NativeCore::ApplyFFTColor(pixels.ToPointer(), width, height, stride, kernelSize, isInverse, isCPU, isPhase);
@@ -112,6 +143,12 @@ namespace ImaGy
             ImaGyNative::NativeCore::ApplyErosionColor(pixels.ToPointer(), width, height, stride, kernelSize, useCircularKernel);
         }
 
+        // Border
+        void NativeProcessor::SetBorderMode(int borderMode, Byte constantValue)
+        {
+            ImaGyNative::NativeCore::SetBorderMode(borderMode, constantValue);
+        }
+
 
         // Image Matching
         void NativeProcessor::ApplyNCC(IntPtr pixels, int width, int height, int stride, IntPtr templatePixels, int templateWidth, int templateHeight, int templateStride, IntPtr outCoords)
@@ -126,6 +163,97 @@ namespace ImaGy
         {
             ImaGyNative::NativeCore::ApplySSD(pixels.ToPointer(), width, height, stride, templatePixels.ToPointer(), templateWidth, templateHeight, templateStride, (int*)outCoords.ToPointer());
         }
+        void NativeProcessor::ApplyPyramidMatch(IntPtr pixels, int width, int height, int stride, IntPtr templatePixels, int templateWidth, int templateHeight, int templateStride, int matchMethod, IntPtr outCoords)
+        {
+            ImaGyNative::NativeCore::ApplyPyramidMatch(pixels.ToPointer(), width, height, stride, templatePixels.ToPointer(), templateWidth, templateHeight, templateStride, matchMethod, (int*)outCoords.ToPointer());
+        }
+        int NativeProcessor::ApplyTemplateMatchPeaks(IntPtr pixels, int width, int height, int stride, IntPtr templatePixels, int templateWidth, int templateHeight, int templateStride,
+            int matchMethod, int maxPeaks, int minDistance, IntPtr outPeaks)
+        {
+            return ImaGyNative::NativeCore::ApplyTemplateMatchPeaks(pixels.ToPointer(), width, height, stride, templatePixels.ToPointer(), templateWidth, templateHeight, templateStride,
+                matchMethod, maxPeaks, minDistance, (double*)outPeaks.ToPointer());
+        }
+        void NativeProcessor::ApplyTemplateMatchBatch(IntPtr pixels, int width, int height, int stride,
+            array<IntPtr>^ templatePixels, array<int>^ templateWidths, array<int>^ templateHeights, array<int>^ templateStrides,
+            int matchMethod, IntPtr outCoords)
+        {
+            int count = templatePixels->Length;
+            std::vector<void*> nativePixels(count);
+            std::vector<int> widths(count), heights(count), strides(count);
+            for (int i = 0; i < count; ++i) {
+                nativePixels[i] = templatePixels[i].ToPointer();
+                widths[i] = templateWidths[i];
+                heights[i] = templateHeights[i];
+                strides[i] = templateStrides[i];
+            }
+            ImaGyNative::NativeCore::ApplyTemplateMatchBatch(pixels.ToPointer(), width, height, stride,
+                nativePixels.data(), widths.data(), heights.data(), strides.data(), count, matchMethod, (int*)outCoords.ToPointer());
+        }
+
+
+        // Pipeline
+        NativePipeline::NativePipeline() : pipeline(new ImaGyNative::Pipeline())
+        {
+        }
+        NativePipeline::~NativePipeline()
+        {
+            this->!NativePipeline();
+        }
+        NativePipeline::!NativePipeline()
+        {
+            delete pipeline;
+            pipeline = nullptr;
+        }
 
+        void NativePipeline::AddGaussianBlur(double sigma, int kernelSize, bool useCircularKernel)
+        {
+            pipeline->AddGaussianBlur(sigma, kernelSize, useCircularKernel);
+        }
+        void NativePipeline::AddAverageBlur(int kernelSize, bool useCircularKernel)
+        {
+            pipeline->AddAverageBlur(kernelSize, useCircularKernel);
+        }
+        void NativePipeline::AddDifferential()
+        {
+            pipeline->AddDifferential();
+        }
+        void NativePipeline::AddSobel(int kernelSize)
+        {
+            pipeline->AddSobel(kernelSize);
+        }
+        void NativePipeline::AddLaplacian(int kernelSize)
+        {
+            pipeline->AddLaplacian(kernelSize);
+        }
+        void NativePipeline::AddDilation(int kernelSize, bool useCircularKernel)
+        {
+            pipeline->AddDilation(kernelSize, useCircularKernel);
+        }
+        void NativePipeline::AddErosion(int kernelSize, bool useCircularKernel)
+        {
+            pipeline->AddErosion(kernelSize, useCircularKernel);
+        }
+        void NativePipeline::AddBinarization(int threshold)
+        {
+            pipeline->AddBinarization(threshold);
+        }
+        void NativePipeline::AddAdjBrightness(int value)
+        {
+            pipeline->AddAdjBrightness(value);
+        }
+
+        void NativePipeline::Clear()
+        {
+            pipeline->Clear();
+        }
+        int NativePipeline::StageCount::get()
+        {
+            return pipeline->StageCount();
+        }
+
+        void NativePipeline::Execute(IntPtr pixels, int width, int height, int stride)
+        {
+            pipeline->Execute(pixels.ToPointer(), width, height, stride);
+        }
     }
 }
\ No newline at end of file
@@ -28,6 +28,11 @@ namespace ImaGy
             static void ApplyEqualization(IntPtr pixels, int width, int height, int stride, Byte threshold);
             static void ApplyEqualizationColor(IntPtr pixels, int width, int height, int stride, Byte threshold);
             static void ApplyKMeansClustering(IntPtr pixels, int width, int height, int stride, int k, int iteration, bool location);
+            // colour-only k-means on a bitsPerChannel (4..7) colour histogram, for very large images
+            static void ApplyKMeansClusteringHistogram(IntPtr pixels, int width, int height, int stride, int k, int iteration, int bitsPerChannel);
+            // each pixel becomes the mean of its most probable Gaussian mixture component
+            static void ApplyGmmSegmentation(IntPtr pixels, int width, int height, int stride, int numClusters);
+            static void ApplyGmmSegmentationColor(IntPtr pixels, int width, int height, int stride, int numClusters);
 
             static void ApplyHistogram(IntPtr pixels, int width, int height, int stride, int* hist);
 
@@ -38,6 +43,12 @@ namespace ImaGy
             static void ApplyFFT(IntPtr pixels, int width, int height, int stride, int kernelSize, bool isInverse, bool isCPU, bool isPhase);
             static void ApplyFrequencyFilter(IntPtr pixels, int width, int height, int stride, int filterType, double radius);
             static void ApplyAxialBandStopFilter(IntPtr pixels, int width, int height, int stride, double lowFreqRadius, double bandThickness);
+            // maskType: 0 / 1 ideal, 2 / 3 Butterworth, 4 / 5 Gaussian low / high-pass, 6 band-pass, 7 band-stop
+            static void ApplyFrequencyMaskFilter(IntPtr pixels, int width, int height, int stride, int maskType, double cutoff, double bandwidth, int order);
+            // notchCenters: (du, dv) offsets from DC, two entries per notch
+            static void ApplyNotchFilter(IntPtr pixels, int width, int height, int stride, array<double>^ notchCenters, double radius, int order);
+            // releases the forward spectra and masks the frequency filters keep between calls
+            static void ClearSpectrumCache();
 
             static void ApplyFFTColor(IntPtr pixels, int width, int height, int stride, int kernelSize, bool isInverse, bool isCPU, bool isPhase);
 
@@ -55,6 +66,9 @@ namespace ImaGy
             static void ApplyErosion(IntPtr pixels, int width, int height, int stride, int kernelSize, bool useCircularKernel);
             static void ApplyErosionColor(IntPtr pixels, int width, int height, int stride, int kernelSize, bool useCircularKernel);
 
+            // Border handling (0: Replicate, 1: Reflect, 2: Constant)
+            static void SetBorderMode(int borderMode, Byte constantValue);
+
 
             // Image Matching
             static void ApplyNCC(System::IntPtr pixels, int width, int height, int stride, 
@@ -63,6 +77,44 @@ namespace ImaGy
                 System::IntPtr templatePixels, int templateWidth, int templateHeight, int templateStride, System::IntPtr outCoords);
             static void ApplySSD(System::IntPtr pixels, int width, int height, int stride, 
                 System::IntPtr templatePixels, int templateWidth, int templateHeight, int templateStride, System::IntPtr outCoords);
+            // matchMethod: 0 NCC, 1 SAD, 2 SSD
+            static void ApplyPyramidMatch(System::IntPtr pixels, int width, int height, int stride,
+                System::IntPtr templatePixels, int templateWidth, int templateHeight, int templateStride, int matchMethod, System::IntPtr outCoords);
+            // outPeaks: 3 * maxPeaks doubles (x, y, score), returns the number of peaks written
+            static int ApplyTemplateMatchPeaks(System::IntPtr pixels, int width, int height, int stride,
+                System::IntPtr templatePixels, int templateWidth, int templateHeight, int templateStride,
+                int matchMethod, int maxPeaks, int minDistance, System::IntPtr outPeaks);
+            // one entry per template in each array, outCoords: 2 * templatePixels->Length ints
+            static void ApplyTemplateMatchBatch(System::IntPtr pixels, int width, int height, int stride,
+                array<System::IntPtr>^ templatePixels, array<int>^ templateWidths, array<int>^ templateHeights, array<int>^ templateStrides,
+                int matchMethod, System::IntPtr outCoords);
+        };
+
+        // Grayscale operator chain run as one tiled pass, see ImaGyNative::Pipeline
+        public ref class NativePipeline
+        {
+        public:
+            NativePipeline();
+            ~NativePipeline();
+            !NativePipeline();
+
+            void AddGaussianBlur(double sigma, int kernelSize, bool useCircularKernel);
+            void AddAverageBlur(int kernelSize, bool useCircularKernel);
+            void AddDifferential();
+            void AddSobel(int kernelSize);
+            void AddLaplacian(int kernelSize);
+            void AddDilation(int kernelSize, bool useCircularKernel);
+            void AddErosion(int kernelSize, bool useCircularKernel);
+            void AddBinarization(int threshold);
+            void AddAdjBrightness(int value);
+
+            void Clear();
+            property int StageCount { int get(); }
+
+            void Execute(IntPtr pixels, int width, int height, int stride);
+
+        private:
+            ImaGyNative::Pipeline* pipeline;
         };
     }
 }